@@ -6,6 +6,9 @@
 #include <BLEServer.h>
 #include "BLE2902.h"
 #include "BLECharacteristic.h"
+#include "conn-params.h"
+
+class BleMouse;
 
 class BleConnectionStatus : public BLEServerCallbacks
 {
@@ -13,8 +16,13 @@ public:
   BleConnectionStatus(void);
   bool connected = false;
   void onConnect(BLEServer* pServer);
+  void onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param);
   void onDisconnect(BLEServer* pServer);
   BLECharacteristic* inputMouse;
+  BLECharacteristic* inputConsumer;
+  ConnParamPolicy* connParams;
+  BleMouse* mouse;
+  esp_bd_addr_t remoteAddress;
 };
 
 #endif // CONFIG_BT_ENABLED
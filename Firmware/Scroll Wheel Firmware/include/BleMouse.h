@@ -6,6 +6,12 @@
 #include "BleConnectionStatus.h"
 #include "BLEHIDDevice.h"
 #include "BLECharacteristic.h"
+#include "conn-params.h"
+#include "defaults.h"
+#include "hid-descriptor.h"
+#include "report-coalescer.h"
+
+#include <atomic>
 
 #define MOUSE_LEFT 1
 #define MOUSE_RIGHT 2
@@ -14,16 +20,48 @@
 #define MOUSE_FORWARD 16
 #define MOUSE_ALL (MOUSE_LEFT | MOUSE_RIGHT | MOUSE_MIDDLE) # For compatibility with the Mouse library
 
-class BleMouse {
+#define WHEEL_HIRES_MULTIPLIER 120 // Wheel units per notch once the host enables the Resolution Multiplier
+#define NOTIFY_CREDITS 4           // Input reports allowed in flight before waiting for the stack
+#define NOTIFY_CREDIT_TIMEOUT 50   // Time in ms after which missing confirmations are written off
+
+typedef MouseReport<(HidProfile)HID_PROFILE> WheelReport; // Input report and descriptor layout in use
+
+class BleMouse : public BleLinkControl, public ReportSink {
 private:
   uint8_t _buttons;
-  BleConnectionStatus* connectionStatus;
+  BleConnectionStatus connectionStatus;
   BLEHIDDevice* hid;
   BLECharacteristic* inputMouse;
+  BLECharacteristic* inputConsumer; // NULL without HID_CONSUMER
   BLECharacteristic* featureResolution;
   void buttons(uint8_t b);
   void rawAction(uint8_t msg[], char msgSize);
+  void report(int8_t x, int8_t y, int16_t wheel, int16_t pan);
+  void reportConsumer(uint16_t usage, int16_t pan);
+  void onReportSent(void);
   static void taskServer(void* pvParameter);
+  ConnParamPolicy connParams;
+  std::atomic<int> notifyCredits;
+  volatile bool congested;
+  volatile uint32_t lastNotify;
+  static void gattsHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gattsIf, esp_ble_gatts_cb_param_t* param);
+  BLEServer* server;
+  esp_bd_addr_t bondedAddress;
+  esp_ble_addr_type_t bondedAddressType;
+  bool hasBondedAddress;
+  volatile bool directedAdvertising;
+  volatile uint32_t directedStart;
+  volatile bool advertisingFailed;
+  uint8_t advertisingFailures;
+  volatile uint32_t disconnectTime;
+  volatile bool awaitingReconnect;
+  volatile bool reconnectDirected;
+  uint32_t reconnects;
+  uint32_t reconnectTime;
+  uint32_t maxReconnectTime;
+  uint32_t setupStackFree;
+  bool findBondedHost(void);
+  void startAdvertising(bool directed);
 public:
   BleMouse(std::string deviceName = "ESP32 Bluetooth Mouse", std::string deviceManufacturer = "Espressif", uint8_t batteryLevel = 100);
   void begin(void);
@@ -34,8 +72,29 @@ public:
   void release(uint8_t b = MOUSE_LEFT); // release LEFT by default
   bool isPressed(uint8_t b = MOUSE_LEFT); // check LEFT by default
   bool isConnected(void);
+  uint8_t getWheelMultiplier(void); // 1 or WHEEL_HIRES_MULTIPLIER, as negotiated by the host
   void setBatteryLevel(uint8_t level);
+  bool canSend(void);
+  bool isCongested(void) { return congested; }
+  bool hasReportsInFlight(void) { return notifyCredits < NOTIFY_CREDITS; } // Input reports the stack has not confirmed yet
+  void sendWheel(int16_t wheel);
+  void sendPan(int16_t pan); // AC Pan on the Consumer Control report, for jog and shuttle
+  void tapConsumer(uint16_t usage); // Press and release of one consumer key, two notifications
+  bool requestConnParams(const ConnParams &params);
+  void updateLink(void); // Call periodically for idle parameters and the advertising fallback
+  void onConnParamsUpdated(bool accepted, uint16_t interval, uint16_t latency, uint16_t timeout);
+  void onBonded(const esp_bd_addr_t address, esp_ble_addr_type_t addressType);
+  void onAdvertisingStarted(bool success);
+  void onDisconnected(void);
+  uint32_t getReconnects(void) { return reconnects; }
+  uint32_t getReconnectTime(void) { return reconnectTime; }    // Disconnect to the next connection in ms
+  uint32_t getMaxReconnectTime(void) { return maxReconnectTime; }
+  bool wasReconnectDirected(void) { return reconnectDirected; }
+  const ConnParamPolicy &getConnParams(void) { return connParams; }
+  void setHoldFast(bool hold) { connParams.setHoldFast(hold); } // Fast connection parameters even while idle
+  uint32_t getSetupStackFree(void) { return setupStackFree; } // Unused bytes of the BLE setup stack, 0 until setup finished
   uint8_t batteryLevel;
+  volatile uint8_t wheelMultiplier;
   std::string deviceManufacturer;
   std::string deviceName;
 protected:
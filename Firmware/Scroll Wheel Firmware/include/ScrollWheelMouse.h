@@ -0,0 +1,21 @@
+#ifndef SCROLL_WHEEL_MOUSE_H
+#define SCROLL_WHEEL_MOUSE_H
+
+#include "BleMouse.h"
+
+#define VENDOR_SERVICE_UUID "7e5c0001-2b8a-4f3d-9c61-5a0f3e9b2d10"   // Scroll Wheel vendor service
+#define VENDOR_STATS_UUID "7e5c0002-2b8a-4f3d-9c61-5a0f3e9b2d10"     // Instrumentation snapshot, read only
+#define VENDOR_CONFIG_UUID "7e5c0003-2b8a-4f3d-9c61-5a0f3e9b2d10"    // ScrollConfig, read and write
+#define VENDOR_TELEMETRY_UUID "7e5c0004-2b8a-4f3d-9c61-5a0f3e9b2d10" // telemetry.h stream, notify only
+
+// BleMouse with the Scroll Wheel vendor service next to the HID service
+class ScrollWheelMouse : public BleMouse
+{
+public:
+  using BleMouse::BleMouse;
+
+protected:
+  void onStarted(BLEServer *pServer);
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef ANGLE_TRACKER_H
+#define ANGLE_TRACKER_H
+
+#include <stdint.h>
+
+#include "scroll-math.h"
+
+// Multi-turn position of the wheel. Each new angle is unwrapped around the
+// position predicted from the last step instead of around the last sample,
+// so a fast spin that covers more than half a turn between two samples still
+// counts in the right direction. A sample further than half of maxRotation
+// off the prediction is unwrapped around the last position instead and
+// counted as aliased, so one outlier cannot leave a runaway speed behind.
+class AngleTracker
+{
+public:
+    AngleTracker();
+
+    void reset();
+
+    // Rescales the speed when the sampler changes its rate
+    void setSampleRate(uint32_t rate);
+
+    // Returns the absolute position for the angle, the first one after reset() is taken as is.
+    // Angles further than maxRotation from the prediction wrap around.
+    int64_t update(int16_t angle, int32_t maxRotation = MAX_ROTATION_COUNTS);
+
+    // Moves the position without a step, when the angles start to mean something else
+    void shift(int32_t counts) { _position += counts; }
+
+    bool isStarted() const { return _started; }
+    int64_t getPosition() const { return _position; }
+    int32_t getVelocity() const { return _velocity; }
+    uint32_t getUnwrapped() const { return _unwrapped; } // Samples beyond maxRotation, lost without prediction
+    uint32_t getAliased() const { return _aliased; }     // Samples too far off the prediction to be sure
+
+private:
+    int64_t _position; // Counts since the first angle, plus that angle
+    int32_t _velocity; // Counts per sample
+    uint32_t _sampleRate;
+    uint32_t _unwrapped;
+    uint32_t _aliased;
+    bool _started;
+};
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef BATTERY_TASK_H
+#define BATTERY_TASK_H
+
+#include "battery.h"
+#include "power-source.h"
+
+extern BatteryMonitor batteryMonitor;
+extern PowerSource powerSource;
+
+// Battery level every BATTERY_UPDATE_INTERVAL, USB and charger sense and the
+// power profile they select every POWER_SENSE_INTERVAL
+void startBatteryTask();
+
+#endif
@@ -1,6 +1,40 @@
 #ifndef BATTERY_H
 #define BATTERY_H
 
-int getBatteryLevel();
+#include <stdint.h>
+
+#include "hal.h"
+
+// Battery percentage for the BLE battery service. Pack voltage readings are
+// oversampled, low pass filtered and looked up in a NiMH discharge curve.
+// The level follows a falling voltage right away but only rises again by
+// BATTERY_HYSTERESIS percent, so recovery after load does not make it flicker.
+class BatteryMonitor
+{
+public:
+    BatteryMonitor(AdcInput &adc);
+
+    void reset();
+
+    // Takes BATTERY_OVERSAMPLE readings, returns true if the level changed
+    bool update();
+
+    // Feeds one pack voltage in mV, returns true if the level changed
+    bool addReading(uint32_t packMillivolts);
+
+    uint8_t getLevel() const { return _level; }
+    uint32_t getMillivolts() const { return (_filtered + (1 << (BATTERY_FILTER_BITS - 1))) >> BATTERY_FILTER_BITS; }
+
+    static constexpr int BATTERY_FILTER_BITS = 4;
+
+private:
+    AdcInput &_adc;
+    uint32_t _filtered; // Filtered pack voltage, mV in Q4
+    bool _hasReading;
+    uint8_t _level;
+};
+
+// Charge in percent for a resting pack voltage in mV
+uint8_t getBatteryLevel(uint32_t packMillivolts);
 
 #endif
@@ -0,0 +1,80 @@
+#ifndef BOOT_SEQUENCE_H
+#define BOOT_SEQUENCE_H
+
+#include <atomic>
+#include <stdint.h>
+
+#include "hal.h"
+
+// Cold boot bookkeeping. Every session after an auto power-off starts with a
+// cold boot, so the time to the first report is worth watching. BLE setup,
+// the sensor probe and the rest of setup() run side by side and each marks
+// the phases it reaches.
+// All times are in ms since the app started.
+
+enum BootPhase : uint8_t
+{
+    BOOT_SETUP = 0,    // setup() entered
+    BOOT_SENSOR,       // Encoder answered
+    BOOT_SAMPLING,     // Sampler running
+    BOOT_BLE_READY,    // HID and vendor services started
+    BOOT_ADVERTISING,  // Controller confirmed the first advertising start
+    BOOT_CONNECTED,    // First host connection
+    BOOT_FIRST_REPORT, // First input report handed to the stack
+    BOOT_PHASE_COUNT
+};
+
+// Written from several tasks, each phase keeps its first mark
+class BootTimeline
+{
+public:
+    static constexpr uint32_t NOT_REACHED = UINT32_MAX;
+
+    BootTimeline();
+
+    void reset();
+    void mark(BootPhase phase, uint32_t now);
+    uint32_t get(BootPhase phase) const { return _marks[phase].load(std::memory_order_relaxed); }
+    bool reached(BootPhase phase) const { return get(phase) != NOT_REACHED; }
+
+private:
+    std::atomic<uint32_t> _marks[BOOT_PHASE_COUNT];
+};
+
+extern BootTimeline bootTimeline;
+extern const char *const BOOT_PHASE_NAMES[BOOT_PHASE_COUNT];
+
+// Probes the encoder without blocking: one try per call at most every
+// SENSOR_RETRY_INTERVAL, so a missing or late sensor never holds up BLE or
+// the console. After SENSOR_GIVE_UP_TIME without an answer it gives up and
+// the caller powers off instead of draining the battery.
+class SensorProbe
+{
+public:
+    enum State : uint8_t
+    {
+        WAITING,
+        READY,
+        GAVE_UP
+    };
+
+    SensorProbe(AngleSensor &sensor, BootTimeline &timeline);
+
+    void reset(uint32_t now);
+
+    // Call from the main loop, returns READY from the call that found the sensor on
+    State poll(uint32_t now);
+
+    State getState() const { return _state; }
+    uint32_t getAttempts() const { return _attempts; }
+
+private:
+    AngleSensor &_sensor;
+    BootTimeline &_timeline;
+    State _state;
+    uint32_t _start;
+    uint32_t _lastAttempt;
+    uint32_t _attempts;
+};
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef CALIBRATION_SERVICE_H
+#define CALIBRATION_SERVICE_H
+
+#include "calibration.h"
+
+// Loads the stored linearity correction from NVS and publishes it, call before startSampler()
+void loadCalibration();
+
+// Starts recording, the wheel should then be spun at a steady speed for
+// CALIBRATION_REVOLUTIONS turns. Scrolling is paused until it finishes.
+void startCalibration();
+void cancelCalibration();
+bool isCalibrating();
+uint16_t getCalibrationRevolutions();
+
+// Sampler side, feeds the raw angle of one sample while recording
+void addCalibrationSample(int16_t rawAngle);
+
+// Loop side. Once enough turns were recorded, fits, publishes and stores the
+// table. Returns true when a recording ended, success tells how.
+bool finishCalibration(bool &success);
+
+// Publishes and stores the identity table
+bool clearCalibration();
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <stdint.h>
+
+#include "scroll-math.h"
+
+// Per-unit angle linearity correction. The magnets and the off-bearing sensor
+// mount make the raw angle run ahead and behind the real one over a turn. A
+// table of corrections at evenly spaced raw angles, linearly interpolated,
+// maps the raw angle back onto a uniform one.
+
+constexpr uint8_t CALIBRATION_VERSION = 1;
+constexpr int CALIBRATION_BITS = 6;                             // 64 knots per turn
+constexpr int CALIBRATION_POINTS = 1 << CALIBRATION_BITS;
+constexpr int CALIBRATION_SHIFT = 12 - CALIBRATION_BITS;        // Raw angle to knot index
+constexpr int32_t CALIBRATION_SPAN = ENCODER_COUNTS >> CALIBRATION_BITS; // Counts between knots
+constexpr int CALIBRATION_Q = 4;                                // Corrections are Q4 counts
+
+static_assert(ENCODER_COUNTS == 1 << 12, "Knot lookup assumes a 12-bit encoder");
+
+// Layout of the NVS blob
+struct __attribute__((packed)) CalibrationTable
+{
+    uint8_t version;
+    int16_t offset[CALIBRATION_POINTS]; // Q4 counts added to the raw angle at each knot
+};
+
+CalibrationTable identityCalibration();
+
+// Offsets in range and the corrected angle still rising with the raw one
+bool isValidCalibration(const CalibrationTable &table);
+
+// Hot path, one table lookup pair and a multiply. The last knot interpolates
+// towards the first one, the correction repeats every turn.
+inline int16_t correctAngle(const CalibrationTable &table, int16_t rawAngle)
+{
+    int index = rawAngle >> CALIBRATION_SHIFT;
+    int32_t fraction = rawAngle & (CALIBRATION_SPAN - 1);
+    int32_t start = table.offset[index];
+    int32_t end = table.offset[(index + 1) & (CALIBRATION_POINTS - 1)];
+    int32_t offset = start + (((end - start) * fraction) >> CALIBRATION_SHIFT);
+    return (rawAngle + ((offset + (1 << (CALIBRATION_Q - 1))) >> CALIBRATION_Q)) & (ENCODER_COUNTS - 1);
+}
+
+// Sampler only, the table stays valid until releaseCalibration()
+const CalibrationTable &acquireCalibration();
+void releaseCalibration();
+
+// Writers, serialized by the caller. publishCalibration() returns false for an
+// invalid table or while the sampler still holds the spare copy.
+const CalibrationTable &getCalibration();
+bool publishCalibration(const CalibrationTable &table);
+
+// Fits a table from raw angles sampled at a fixed rate while the wheel turns
+// at a steady speed. Each raw bin then collects samples in proportion to the
+// real angle it covers, so the running sample count over whole turns gives
+// the real angle at every knot. The knots are fitted with the first
+// CALIBRATION_HARMONICS harmonics of a turn, which leaves out most of the
+// count noise and speed wobble. Alternate turns are kept apart, the fit of
+// either half has to beat no correction on the other one.
+class CalibrationFitter
+{
+public:
+    CalibrationFitter();
+
+    void reset();
+    void addSample(int16_t rawAngle);
+
+    // Whole turns accepted so far, the first turn and turns off the running speed are dropped
+    uint16_t getRevolutions() const { return _revolutions; }
+    uint16_t getRejected() const { return _rejected; }
+
+    // Returns false until CALIBRATION_REVOLUTIONS turns were accepted, or if
+    // the fit does not make the recorded angle more uniform than it already is
+    bool fit(CalibrationTable &table) const;
+
+private:
+    void closeRevolution();
+
+    uint32_t _bins[2][CALIBRATION_POINTS]; // Samples per knot span over the even and odd accepted turns
+    uint32_t _pending[CALIBRATION_POINTS]; // Same for the turn in progress
+    uint32_t _pendingSamples;
+    uint32_t _lastSamples;  // Length of the previous turn in samples, 0 before the first one
+    int32_t _travel;        // Counts turned since the current turn started
+    int16_t _angleBefore;   // -1 until the first sample
+    uint16_t _revolutions;
+    uint16_t _rejected;
+};
+
+#endif
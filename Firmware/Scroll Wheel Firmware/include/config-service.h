@@ -0,0 +1,13 @@
+#ifndef CONFIG_SERVICE_H
+#define CONFIG_SERVICE_H
+
+#include "config.h"
+
+// Loads the stored config from NVS and publishes it, call before startSampler()
+void loadConfig();
+
+// Validates, publishes, applies and stores a new config. Safe to call from the
+// BLE stack and the console at the same time.
+bool updateConfig(const ScrollConfig &config);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Runtime tuning. Defaults come from defaults.h, the ESP32 build keeps edits
+// in NVS. The sampler pins one snapshot per sample through acquireConfig(),
+// so it never waits on a writer or sees half of an edit.
+
+constexpr uint8_t CONFIG_VERSION = 4;
+
+// Layout of the config characteristic and the NVS blob. New fields are only
+// ever appended and CONFIG_VERSION goes up, so every older layout is a prefix.
+// A field that changes its unit keeps its place and gets a conversion in migrateConfig().
+struct __attribute__((packed)) ScrollConfig
+{
+    uint8_t version;
+    uint16_t scrollGain;   // Report units per encoder count, Q12 (SCROLL_MULTIPLICATOR)
+    uint16_t maxRotation;  // Counts off the predicted angle beyond which a sample wraps around (MAX_ROTATION_PER_READ)
+    uint16_t noiseBandMin; // Q4 counts (NOISE_BAND_MIN)
+    uint16_t noiseBandMax; // Q4 counts (NOISE_BAND_MAX)
+    uint8_t noiseBandGain; // Dead band over noise floor (NOISE_BAND_GAIN)
+    uint8_t accelCurve;    // AccelCurve (ACCEL_CURVE)
+    uint32_t idleTimeout;  // ms (POWER_IDLE_TIMEOUT)
+    uint32_t offTimeout;   // ms, 0 never powers off (POWER_OFF_TIMEOUT)
+    uint16_t flywheelDecay;    // Coasting time constant in ms, 0 turns inertia off (FLYWHEEL_DECAY)
+    uint16_t flywheelMinSpeed; // Release speed that starts coasting (FLYWHEEL_MIN_SPEED)
+    uint8_t wheelMode;         // WheelMode (WHEEL_MODE)
+    uint16_t modeSteps;        // Jog, key or shuttle steps per turn, counts per step before version 4 (MODE_STEPS)
+    uint16_t keyUp;            // Consumer usage tapped per step up in key mode (MODE_KEY_UP)
+    uint16_t keyDown;          // Consumer usage tapped per step down in key mode (MODE_KEY_DOWN)
+};
+
+struct ConfigField
+{
+    const char *name;
+    uint8_t offset;
+    uint8_t size;
+};
+
+extern const ConfigField CONFIG_FIELDS[];
+extern const int CONFIG_FIELD_COUNT;
+
+ScrollConfig defaultConfig();
+bool isValidConfig(const ScrollConfig &config);
+
+// Takes a blob of this or any earlier layout, fields it did not have yet get
+// their defaults. Returns false for an unknown version, a length that does not
+// match it, or an invalid result.
+bool migrateConfig(const void *data, size_t length, ScrollConfig &config);
+
+// Sampler only, the snapshot stays valid until releaseConfig()
+const ScrollConfig &acquireConfig();
+void releaseConfig();
+
+// Writers, serialized by the caller. publishConfig() returns false for an
+// invalid config or while the sampler still holds the spare copy.
+const ScrollConfig &getConfig();
+bool publishConfig(const ScrollConfig &config);
+
+uint32_t getConfigField(const ScrollConfig &config, const ConfigField &field);
+bool setConfigField(ScrollConfig &config, const char *name, uint32_t value);
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef CONN_PARAMS_H
+#define CONN_PARAMS_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Connection parameters in BLE units: intervals in 1.25 ms, timeout in 10 ms
+struct ConnParams
+{
+    uint16_t minInterval;
+    uint16_t maxInterval;
+    uint16_t latency;
+    uint16_t timeout;
+};
+
+// What the policy needs from the BLE stack, so it can run against a fake
+class BleLinkControl
+{
+public:
+    virtual ~BleLinkControl() {}
+    virtual bool requestConnParams(const ConnParams &params) = 0;
+};
+
+// Asks for a short interval while the wheel moves and for a long interval
+// with slave latency once it has been idle for CONN_IDLE_TIMEOUT. Holding it
+// fast keeps the short interval while idle. A rejected request is sent again
+// after CONN_RETRY_DELAY, doubling up to CONN_RETRY_MAX.
+// onConnect, onDisconnect and onParamsUpdated come from the BLE stack task and
+// only post to atomics, the state machine runs in update and onMotion, which
+// have to be called from one task.
+// All times are in ms.
+class ConnParamPolicy
+{
+public:
+    enum State : uint8_t
+    {
+        DISCONNECTED,
+        CONNECTED, // Waiting for the host to finish its own setup
+        FAST,
+        IDLE
+    };
+
+    ConnParamPolicy(BleLinkControl &link);
+
+    // Stack task, applied with the next update
+    void onConnect(uint32_t now);
+    void onDisconnect();
+    void onParamsUpdated(bool accepted, uint16_t interval, uint16_t latency, uint16_t timeout);
+
+    // Call periodically to fall back to the idle parameters and to retry
+    void update(uint32_t now);
+    void onMotion(uint32_t now);
+
+    // Takes effect with the next update
+    void setHoldFast(bool hold) { _holdFast = hold; }
+
+    State getState() const { return _state; }
+    const ConnParams &getRequested() const { return _requested; }
+    uint16_t getInterval() const { return _current.load() >> 32; }
+    uint16_t getLatency() const { return _current.load() >> 16; }
+    uint16_t getTimeout() const { return _current.load(); }
+    uint32_t getRejected() const { return _rejected; }
+
+private:
+    enum LinkEvent : uint8_t
+    {
+        LINK_NONE,
+        LINK_UP,
+        LINK_DOWN
+    };
+
+    void request(State state, const ConnParams &params);
+    void send();
+
+    BleLinkControl &_link;
+    State _state;
+    uint32_t _lastMotion;
+    ConnParams _requested;
+    uint32_t _retryTime;  // When the rejected request goes out again
+    uint32_t _retryDelay; // Back-off for the next rejection
+    uint32_t _seenRejected;
+    bool _retrying;
+    std::atomic<uint8_t> _linkEvent;    // Last LinkEvent the stack posted
+    std::atomic<uint32_t> _connectTime;
+    std::atomic<uint64_t> _current;     // Parameters as reported by the stack: interval, latency, timeout
+    std::atomic<uint32_t> _rejected;
+    std::atomic<bool> _holdFast;        // Set from the power sense task
+};
+
+#endif
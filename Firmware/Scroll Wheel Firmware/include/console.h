@@ -0,0 +1,7 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+// Single character serial commands, call from loop()
+void handleConsole();
+
+#endif
@@ -3,22 +3,124 @@
 
 #define FIRMWARE_VERSION "0.2.0"
 #define BLE_DEVICE_NAME "Scroll Wheel" // Name of the BLE device
+#define HID_PROFILE 0                  // 0: classic 8-bit wheel, 1: 16-bit wheel and AC Pan, 2: scroll only, see hid-descriptor.h
+#define HID_CONSUMER 0                 // 1: add the Consumer Control report the jog, shuttle and key modes and a pan wheel need,
+                                       // the report map changes so bonded hosts have to pair again
 
-#define SCROLL_UPDATE_INTERVAL 100   // Interval for scroll value update in ms
-#define BATTERY_UPDATE_INTERVAL 5000 // Set battery update interval in s
-#define BATTERY_MAX_VOLTAGE 4.2      // Maximal Battery Voltage
-#define BATTERY_MIN_VOLTAGE 3.3      // Minimal Battery Voltage
-#define BATTERY_VALUE_CORRECTION 1   // Battery value correction
+#define BATTERY_UPDATE_INTERVAL 5000 // Set battery update interval in ms
+#define BATTERY_CELLS 3              // NiMH cells in series
+#define BATTERY_VALUE_CORRECTION 1   // Battery value correction, pack voltage over pin voltage
+#define BATTERY_OVERSAMPLE 64        // ADC readings averaged per update
+#define BATTERY_FILTER_SHIFT 4       // Low pass weight of a new update, 1/2^n
+#define BATTERY_HYSTERESIS 2         // Percent the level has to rise before it is reported
+#define BATTERY_TASK_PRIORITY 1      // Below everything on the scroll path, also runs the power sense
+#define BATTERY_TASK_STACK 2048      // Battery monitor stack size in bytes
 
 #define LOOP_SLEEP_TIME 5 // Sleep time in ms
 
+#define SAMPLE_RATE_HZ 1000         // Encoder sampling rate
+#define SAMPLE_QUEUE_SIZE 64        // Sampler to reporter queue length, power of two
+#define SAMPLER_TASK_CORE 1         // Core the sampler is pinned to, BLE runs on core 0
+#define SAMPLER_TASK_PRIORITY 10    // Above the Arduino loop and the BLE setup task
+#define SAMPLER_TASK_STACK 4096     // Sampler stack size in bytes
+#define REPORTER_TASK_CORE 0        // Core the reporter is pinned to
+#define REPORTER_TASK_PRIORITY 6    // Below the sampler so notify() never delays a read
+#define REPORTER_TASK_STACK 4096    // Reporter stack size in bytes
+#define BLE_SETUP_TASK_STACK 6144   // BLE setup stack size in bytes, freed again once advertising runs
+#define BLE_SETUP_TASK_CORE 0       // Core the BLE setup runs on, in parallel with setup() on the other one
+
+#define TELEMETRY_QUEUE_SIZE 256       // Sampler to telemetry queue length, power of two
+#define TELEMETRY_BUFFER_SIZE 1024     // Encoded telemetry waiting for the radio, in bytes
+#define TELEMETRY_INTERVAL 20          // Time in ms between telemetry notification rounds
+#define TELEMETRY_BURST 4              // Notifications per round at most, 80 bytes at the default MTU keep up with the stream
+#define TELEMETRY_STATUS_INTERVAL 1000 // Time in ms between battery and stats frames
+#define TELEMETRY_TASK_PRIORITY 2      // Below the reporter, above the battery monitor
+#define TELEMETRY_TASK_STACK 3072      // Telemetry stack size in bytes
+
+#define SENSOR_BACKEND 1            // 0: AS5600 library, 1: fast I2C, 2: OUT pin PWM capture, 3: OUT pin analog over ADC DMA
+#define SENSOR_OUT_PIN 34           // AS5600 OUT pin, only used by the PWM and analog backends
+#define I2C_CLOCK_HZ 1000000        // Fast I2C bus clock, drop to 400000 if the pull-ups are too weak
+#define I2C_TIMEOUT 2               // Time in ms before a stuck I2C transfer is given up
+#define SENSOR_STALE_TIME 5000      // Time in us without a PWM frame or ADC sample before reads fail
+#define ANALOG_SAMPLE_RATE_HZ 20000 // ADC DMA conversion rate for the analog backend
+#define ANALOG_RAW_MIN 370          // Raw ADC value at angle 0 (10 % of VDD)
+#define ANALOG_RAW_MAX 3700         // Raw ADC value at angle 4095 (90 % of VDD)
+#define SENSOR_CHANNELS 1           // Encoders read per sample, 2 adds a second wheel (fast I2C backend only)
+#define SENSOR_SECOND_AXIS 1        // Second wheel drives 0: the scroll wheel as well, 1: AC Pan
+#define SENSOR_CHANNEL_BUS 0        // Second encoder is 0: an AS5600L at its own address, 1: an AS5600 behind a TCA9548A
+#define SENSOR_AS5600L_ADDRESS 0x40 // I2C address of the AS5600L
+#define SENSOR_MUX_ADDRESS 0x70     // I2C address of the TCA9548A
+#define SENSOR_MUX_PORT_FIRST 0     // Mux port of the primary encoder
+#define SENSOR_MUX_PORT_SECOND 1    // Mux port of the second encoder
+#define SENSOR_RETRY_INTERVAL 250   // Time in ms between probes for a missing encoder
+#define SENSOR_GIVE_UP_TIME 60000   // Time in ms without an encoder before powering off, 0 to keep trying
+
+#define POWER_IDLE_TIMEOUT 2000    // Time in ms without motion before dropping to idle
+#define POWER_IDLE_RATE_HZ 50      // Encoder sampling rate while idle
+#define POWER_IDLE_CPU_MHZ 80      // CPU clock while idle, the radio needs at least 80
+#define POWER_ACTIVE_CPU_MHZ 240   // CPU clock while scrolling
+#define SENSOR_POWER_IDLE_MODE SENSOR_POWER_LOW2 // AS5600 mode while idle, polls every 20 ms
+#define POWER_OFF_TIMEOUT 1800000  // Time in ms without motion before powering off, 0 to disable
+#define POWER_USB_PROFILE 1        // 1: stay at full rate and fast connection parameters on USB, 0: battery profile everywhere
+#define POWER_SENSE_INTERVAL 100   // Time in ms between USB and charger sense reads
+#define POWER_SENSE_DEBOUNCE 300   // Time in ms a sense level has to hold before the profile follows
+
+#define TRACE_BLOCKS 32           // Trace ring size in blocks, per stream
+#define TRACE_BLOCK_SIZE 256      // Trace block size in bytes
+#define TRACE_IDLE_JITTER 100     // Timing jitter in us still recorded as a nominal resting sample
+
+#define CONN_SETUP_DELAY 2000      // Time in ms after connecting before parameters are requested
+#define CONN_IDLE_TIMEOUT 3000     // Time in ms without motion before switching to idle parameters
+#define CONN_UPDATE_INTERVAL 100   // Interval for checking the connection idle timeout in ms
+#define CONN_FAST_MIN_INTERVAL 6   // Active connection interval, 1.25 ms units (7.5 ms)
+#define CONN_FAST_MAX_INTERVAL 6   // Active connection interval, 1.25 ms units (7.5 ms)
+#define CONN_FAST_TIMEOUT 400      // Active supervision timeout, 10 ms units
+#define CONN_IDLE_MIN_INTERVAL 72  // Idle connection interval, 1.25 ms units (90 ms)
+#define CONN_IDLE_MAX_INTERVAL 80  // Idle connection interval, 1.25 ms units (100 ms)
+#define CONN_IDLE_LATENCY 4        // Connection events the device may skip while idle
+#define CONN_IDLE_SUPERVISION 600  // Idle supervision timeout, 10 ms units
+#define CONN_RETRY_DELAY 1000      // Time in ms before a rejected parameter request is sent again, doubles per rejection
+#define CONN_RETRY_MAX 16000       // Longest time in ms between retries of a rejected request
+#define RECONNECT_DIRECTED_TIME 1280 // Time in ms to advertise directly to the bonded host, 1.28 s is the spec limit
+#define RECONNECT_MAX_FAILURES 3     // Failed advertising starts in a row before falling back to a reboot
+
 #define PWR_SW_PIN 15             // Needs to be high for device to stay on
 #define BATTERY_SENSE_PIN 32      // ADC pin for battery voltage sensing
-#define POWER_SENSE_PIN 14        // ADC pin for sensing connected USB
-#define CHARGE_STATE_SENSE_PIN 13 // ADC pin for sensing charge state
+#define POWER_SENSE_PIN 14        // ADC pin for sensing connected USB, high with USB power
+#define CHARGE_STATE_SENSE_PIN 13 // ADC pin for sensing charge state, BQ25172 STAT pulls it low while charging
 
 #define SCROLL_MULTIPLICATOR 1    // Multiplier for scroll value
-#define JITTER_THRESHOLD 0.5      // Threshold for jitter in scroll angle
-#define MAX_ROTATION_PER_READ 180 // Maximal rotation per read in degrees
+#define FLYWHEEL_DECAY 0          // Coasting time constant in ms after a flick, 0 disables inertia (try 400)
+#define FLYWHEEL_MIN_SPEED 360    // Release speed that starts coasting, report units/s before the hi-res multiplier
+#define FLYWHEEL_RELEASE_TIME 20  // Time in ms without motion after which a flick counts as released
+#define FLYWHEEL_TAPER 75         // Percent of the flick speed the last quarter of it may keep, a grab stops at full speed
+#define JITTER_THRESHOLD 0.5      // Dead band in degrees until the noise floor has been learned
+#define MAX_ROTATION_PER_READ 180 // Maximal deviation from the predicted angle per read in degrees
+
+#define WHEEL_MODE 0              // 0: scroll, 1: jog, 2: shuttle, 3: consumer keys, see wheel-mode.h
+#define MODE_STEPS 24             // Jog steps, key taps or shuttle levels per turn
+#define MODE_KEY_UP 0xE9          // Consumer usage tapped per step up in key mode (Volume Increment)
+#define MODE_KEY_DOWN 0xEA        // Consumer usage tapped per step down in key mode (Volume Decrement)
+#define SHUTTLE_LEVELS 6          // Shuttle speeds either way of the stop position
+#define SHUTTLE_INTERVAL 20       // Time in ms between shuttle pan reports, each sends the level
+
+#define ACCEL_CURVE 0              // Acceleration curve after boot, see AccelCurve (0 = off)
+#define ACCEL_MAX_GAIN 8.0         // Scroll gain at and above ACCEL_MAX_SPEED
+#define ACCEL_MAX_SPEED 720        // Wheel speed in degrees per second where the gain saturates
+#define ACCEL_POWER_EXPONENT 2     // Exponent of the power curve
+#define ACCEL_SIGMOID_STEEPNESS 10 // Steepness of the sigmoid curve
+
+#define NOISE_BAND_MIN 0.1          // Smallest adaptive dead band in degrees
+#define NOISE_BAND_MAX 2.0          // Largest adaptive dead band in degrees
+#define NOISE_BAND_GAIN 3           // Dead band as multiple of the measured noise floor
+#define NOISE_REST_TIME 50          // Time in ms at rest before the noise floor is learned
+#define NOISE_MOVE_HOLD 20          // Time in ms without a new count before a turning wheel needs the full dead band again
+#define NOISE_QUALITY_INTERVAL 250  // Interval for AS5600 AGC/magnitude reads in ms
+#define NOISE_AGC_MARGIN 32         // Extra dead band at full AGC gain, 1/16 counts
+#define NOISE_MIN_MAGNITUDE 1000    // AS5600 magnitude below which the field counts as weak
+
+#define CALIBRATION_REVOLUTIONS 8      // Steady turns recorded for the linearity correction
+#define CALIBRATION_SPEED_TOLERANCE 10 // Percent a turn may take longer or shorter than the one before
+#define CALIBRATION_HARMONICS 8        // Harmonics per turn the correction is fitted with, covers the magnet pitch
 
 #endif
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef DOUBLE_BUFFER_H
+#define DOUBLE_BUFFER_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Two copies of a value, one published to the reader while the other is
+// written. Exactly one reader task pins the published copy for the length of
+// a read, writers must be serialized by the caller. The reader never waits,
+// a writer backs off while the reader still holds the spare copy.
+template <typename T>
+class DoubleBuffer
+{
+public:
+    DoubleBuffer(const T &value)
+    {
+        _buffers[0] = value;
+        _buffers[1] = value;
+    }
+
+    // Reader side, the returned copy stays valid until release()
+    const T &acquire()
+    {
+        uint8_t index;
+        do
+        {
+            index = _active.load();
+            _inUse.store(index);
+        } while (_active.load() != index); // A swap in between, the other copy may be mid-write
+        return _buffers[index];
+    }
+
+    void release() { _inUse.store(NONE); }
+
+    // Writer side, returns false if the reader still holds the spare copy
+    bool publish(const T &value)
+    {
+        uint8_t spare = _active.load() ^ 1;
+        if (_inUse.load() == spare)
+        {
+            return false;
+        }
+        _buffers[spare] = value;
+        _active.store(spare);
+        return true;
+    }
+
+    // Writer side view of the published copy
+    const T &current() const { return _buffers[_active.load()]; }
+
+private:
+    static constexpr uint8_t NONE = 2;
+
+    T _buffers[2];
+    std::atomic<uint8_t> _active{0};
+    std::atomic<uint8_t> _inUse{NONE};
+};
+
+#endif
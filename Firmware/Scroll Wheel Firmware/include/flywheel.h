@@ -0,0 +1,56 @@
+#ifndef FLYWHEEL_H
+#define FLYWHEEL_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+// Inertia after a flick. The scroll speed is averaged over the last
+// FLYWHEEL_WINDOW samples; once the wheel stops after turning faster than the
+// configured release speed, the flywheel keeps reporting at that speed and
+// lets it decay exponentially. A flick runs down before it stops, so the last
+// quarter of the window has to be slower than the whole by FLYWHEEL_TAPER; a
+// hand grabbing the wheel stops it at full speed and nothing coasts.
+// New motion or a touch inside the noise band stops it right away.
+// Speeds are Q12 report units per sample.
+class Flywheel
+{
+public:
+    static constexpr int FLYWHEEL_WINDOW = 32;
+    static constexpr int FLYWHEEL_TAIL = FLYWHEEL_WINDOW / 4;
+
+    Flywheel();
+
+    void reset();
+
+    // Release time, release speed and decay follow the sampler rate, a change drops the history
+    void setSampleRate(uint32_t rate);
+
+    // Feeds the report units of one sample, the same in Q12 units before the
+    // remainder and whether the wheel moved, returns what to report
+    int32_t update(int32_t value, int32_t amount, bool motion, uint8_t multiplier, const ScrollConfig &config);
+
+    // The wheel moved inside the noise band: a hand is on it, stop coasting and drop a pending release
+    void touch();
+
+    bool isCoasting() const { return _coasting; }
+    int32_t getVelocity() const;
+
+private:
+    void stop();
+
+    int32_t _history[FLYWHEEL_WINDOW]; // Q12 report units per sample, oldest overwritten first
+    int64_t _sum;                      // Sum over _history
+    int64_t _tailSum;                  // Sum over the newest FLYWHEEL_TAIL entries
+    uint8_t _index;
+    int32_t _releaseVelocity; // Window speed at the last motion, 0 if it did not taper off
+    uint16_t _quietSamples;   // Samples without motion since then
+    int64_t _velocity;        // Coasting speed with 16 more fraction bits
+    int32_t _remainder;       // Q12 report units not yet reported
+    uint8_t _multiplier;
+    bool _coasting;
+    uint16_t _releaseSamples; // FLYWHEEL_RELEASE_TIME in samples
+    uint32_t _sampleRate;
+};
+
+#endif
@@ -2,9 +2,29 @@
 #define GLOBALS_H
 
 #include <AS5600.h>
-#include "BleMouse.h"
+#include "ScrollWheelMouse.h"
+#include "defaults.h"
+#include "hal-esp32.h"
+#include "rotary-sensor.h"
+#include "sensor-channels.h"
 
 extern AS5600 encoder;
-extern BleMouse bleMouse;
+extern As5600Sensor libraryBackend;
+extern FastI2cSensor i2cBackend;
+extern PwmSensor pwmBackend;
+extern AnalogSensor analogBackend;
+extern AngleSensor &angleSensor; // One of the backends above, picked by SENSOR_BACKEND
+extern Esp32Adc batteryAdc;
+extern Esp32Clock systemClock;
+extern RotarySensor rotarySensor;
+#if SENSOR_CHANNELS > 1
+extern AngleSensor &secondAngleSensor;
+extern RotarySensor secondRotarySensor;
+#endif
+extern SensorChannels sensorChannels; // rotarySensor first, then the extra wheels
+extern ScrollWheelMouse bleMouse;
 
-#endif
\ No newline at end of file
+// Points the bus at the primary encoder, a no-op without the mux
+bool selectPrimaryEncoder();
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef HAL_ESP32_H
+#define HAL_ESP32_H
+
+#include <AS5600.h>
+#include <Wire.h>
+#include <driver/mcpwm.h>
+
+#include "hal.h"
+
+// AS5600 through the library at the default bus clock. The other backends
+// reuse it for configuration, signal quality and power modes.
+class As5600Sensor : public AngleSensor
+{
+public:
+    As5600Sensor(AS5600 &encoder) : _encoder(encoder) {}
+    bool begin();
+    int16_t readAngle();
+    SignalQuality readSignalQuality();
+    void setPowerMode(SensorPowerMode mode);
+
+protected:
+    AS5600 &_encoder;
+};
+
+// Raw Wire access at I2C_CLOCK_HZ. The AS5600 keeps its address pointer on
+// the angle register, so after the first read every sample is a single two
+// byte read without the register write.
+class FastI2cSensor : public As5600Sensor
+{
+public:
+    FastI2cSensor(AS5600 &encoder, TwoWire &wire) : As5600Sensor(encoder), _wire(wire), _pointerSet(false) {}
+    bool begin();
+    void end();
+    int16_t readAngle();
+    SignalQuality readSignalQuality();
+    void setPowerMode(SensorPowerMode mode);
+
+private:
+    TwoWire &_wire;
+    bool _pointerSet; // Address pointer still on the angle register
+};
+
+// OUT pin in PWM mode, both edges timestamped by the MCPWM capture unit. The
+// capture interrupt turns each frame into an angle, a read only copies it.
+// New angles arrive at the 920 Hz PWM frame rate.
+class PwmSensor : public As5600Sensor
+{
+public:
+    PwmSensor(AS5600 &encoder, uint8_t pin) : As5600Sensor(encoder), _pin(pin) {}
+    bool begin();
+    void end();
+    int16_t readAngle();
+
+private:
+    static bool onCapture(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel, const cap_event_data_t *event, void *arg);
+
+    uint8_t _pin;
+    uint32_t _rise;                 // Capture ticks of the last rising edge
+    uint32_t _fall;                 // Capture ticks of the last falling edge
+    bool _hasRise;                  // Rising edge seen since begin(), _rise is valid
+    bool _hasFall;                  // Falling edge seen since the last rising edge
+    volatile int16_t _angle;        // Angle of the last complete frame
+    volatile uint32_t _frameTime;   // Time of the last complete frame in us, low 32 bits of esp_timer_get_time()
+};
+
+// OUT pin in analog mode (10 % to 90 % of VDD), sampled by the ADC DMA
+// controller. A read averages what arrived since the previous one. ADC1 is
+// owned by the DMA controller meanwhile, one-shot reads on it are not possible.
+class AnalogSensor : public As5600Sensor
+{
+public:
+    AnalogSensor(AS5600 &encoder, uint8_t pin) : As5600Sensor(encoder), _pin(pin), _running(false) {}
+    bool begin();
+    void end();
+    int16_t readAngle();
+
+private:
+    uint8_t _pin;
+    bool _running;
+    int16_t _angle;      // Angle of the last read that found samples
+    uint32_t _angleTime; // Time of that read in us, low 32 bits of esp_timer_get_time()
+};
+
+// TCA9548A style I2C switch, for encoders that share one address. Remembers
+// the open port so channels read in a fixed order cost one write each.
+class I2cMux
+{
+public:
+    I2cMux(TwoWire &wire, uint8_t address) : _wire(wire), _address(address), _port(NO_PORT) {}
+    bool select(uint8_t port);
+
+private:
+    static constexpr uint8_t NO_PORT = 0xFF;
+
+    TwoWire &_wire;
+    uint8_t _address;
+    uint8_t _port; // Port left open by the last select, NO_PORT after a failed write
+};
+
+// Any I2C backend behind a mux port, the port is opened before every access
+class MuxedSensor : public AngleSensor
+{
+public:
+    MuxedSensor(AngleSensor &sensor, I2cMux &mux, uint8_t port) : _sensor(sensor), _mux(mux), _port(port) {}
+    bool begin();
+    void end();
+    int16_t readAngle();
+    SignalQuality readSignalQuality();
+    void setPowerMode(SensorPowerMode mode);
+
+private:
+    AngleSensor &_sensor;
+    I2cMux &_mux;
+    uint8_t _port;
+};
+
+class Esp32Adc : public AdcInput
+{
+public:
+    Esp32Adc(uint8_t pin) : _pin(pin) {}
+    uint32_t readMillivolts();
+
+private:
+    uint8_t _pin;
+};
+
+class Esp32Clock : public Clock
+{
+public:
+    uint32_t nowMs();
+    uint32_t nowUs();
+    uint32_t cycles();
+};
+
+#endif
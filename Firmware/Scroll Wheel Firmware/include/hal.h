@@ -0,0 +1,54 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+
+constexpr int16_t SENSOR_READ_ERROR = -1; // Returned by readAngle when the sensor did not answer in time
+
+// Thin hardware interfaces between the firmware core and the ESP32. The real
+// backends live in hal-esp32.cpp, the native build provides fakes.
+
+struct SignalQuality
+{
+    bool magnetDetected;
+    bool fieldOutOfRange; // Magnet too strong or too weak
+    uint8_t agc;
+    uint16_t magnitude;
+};
+
+enum SensorPowerMode : uint8_t
+{
+    SENSOR_POWER_NOMINAL,
+    SENSOR_POWER_LOW1, // AS5600 LPM1, 5 ms polling
+    SENSOR_POWER_LOW2, // AS5600 LPM2, 20 ms polling
+    SENSOR_POWER_LOW3  // AS5600 LPM3, 100 ms polling
+};
+
+class AngleSensor
+{
+public:
+    virtual ~AngleSensor() {}
+    virtual bool begin() = 0;
+    virtual void end() {} // Releases the bus or capture hardware for another backend
+    virtual int16_t readAngle() = 0; // Raw 12-bit angle, 0 to 4095, or SENSOR_READ_ERROR
+    virtual SignalQuality readSignalQuality() = 0;
+    virtual void setPowerMode(SensorPowerMode mode) = 0;
+};
+
+class AdcInput
+{
+public:
+    virtual ~AdcInput() {}
+    virtual uint32_t readMillivolts() = 0; // Voltage at the pin, before any divider correction
+};
+
+class Clock
+{
+public:
+    virtual ~Clock() {}
+    virtual uint32_t nowMs() = 0;
+    virtual uint32_t nowUs() = 0;
+    virtual uint32_t cycles() = 0; // Free running CPU cycle counter
+};
+
+#endif
@@ -0,0 +1,290 @@
+#ifndef HID_DESCRIPTOR_H
+#define HID_DESCRIPTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Mouse report descriptors built at compile time from a layout, together with
+// the packed input report each layout sends. The builder records where every
+// field ended up so the report structs can be checked against it. A Consumer
+// Control collection with its own report ID follows the mouse for the jog,
+// shuttle and key modes.
+
+enum HidProfile : uint8_t
+{
+    HID_CLASSIC = 0, // Buttons, X, Y and an 8-bit wheel
+    HID_HIRES,       // Buttons, X, Y, 16-bit wheel and 16-bit AC Pan
+    HID_SCROLL_ONLY  // Buttons, 16-bit wheel and 16-bit AC Pan, no pointer axes
+};
+
+struct MouseLayout
+{
+    uint8_t reportId;
+    bool pointer;      // X/Y bytes, unused by the wheel but expected by some hosts
+    uint8_t wheelBits; // 8 or 16
+    bool pan;          // AC Pan with the same size as the wheel
+};
+
+constexpr size_t HID_DESCRIPTOR_CAPACITY = 160;
+
+struct HidDescriptor
+{
+    uint8_t data[HID_DESCRIPTOR_CAPACITY];
+    size_t length;
+    uint16_t inputBits;   // Input report size without the report ID
+    uint16_t featureBits; // Feature report size without the report ID
+    uint16_t pointerBit;  // Bit offsets of the fields inside the input report
+    uint16_t wheelBit;
+    uint16_t panBit;
+
+    // Short items, the smallest size that holds the value but at least one byte
+    constexpr void item(uint8_t prefix, int32_t value, bool isSigned)
+    {
+        uint8_t size = 1;
+        if (isSigned ? (value < -128 || value > 127) : (value < 0 || value > 0xFF))
+        {
+            size = isSigned ? (value < -32768 || value > 32767 ? 4 : 2) : (value > 0xFFFF ? 4 : 2);
+        }
+        data[length++] = prefix | (size == 4 ? 3 : size);
+        for (uint8_t i = 0; i < size; i++)
+        {
+            data[length++] = (uint8_t)((uint32_t)value >> (8 * i));
+        }
+    }
+
+    constexpr void usagePage(uint16_t page) { item(0x04, page, false); }
+    constexpr void usage(uint16_t usage) { item(0x08, usage, false); }
+    constexpr void usageMinimum(uint16_t usage) { item(0x18, usage, false); }
+    constexpr void usageMaximum(uint16_t usage) { item(0x28, usage, false); }
+    constexpr void logicalMinimum(int32_t value) { item(0x14, value, true); }
+    constexpr void logicalMaximum(int32_t value) { item(0x24, value, true); }
+    constexpr void physicalMinimum(int32_t value) { item(0x34, value, true); }
+    constexpr void physicalMaximum(int32_t value) { item(0x44, value, true); }
+    constexpr void reportId(uint8_t id) { item(0x84, id, false); }
+    constexpr void reportSize(uint8_t bits) { item(0x74, bits, false); _size = bits; }
+    constexpr void reportCount(uint8_t count) { item(0x94, count, false); _count = count; }
+    constexpr void collection(uint8_t type) { item(0xA0, type, false); }
+    constexpr void endCollection() { data[length++] = 0xC0; }
+
+    constexpr void input(uint8_t flags)
+    {
+        item(0x80, flags, false);
+        inputBits += _size * _count;
+    }
+
+    constexpr void feature(uint8_t flags)
+    {
+        item(0xB0, flags, false);
+        featureBits += _size * _count;
+    }
+
+    uint8_t _size;
+    uint8_t _count;
+};
+
+// Input item flags
+constexpr uint8_t HID_DATA_ARRAY_ABS = 0x00;
+constexpr uint8_t HID_DATA_VAR_ABS = 0x02;
+constexpr uint8_t HID_CONST_VAR_ABS = 0x03;
+constexpr uint8_t HID_DATA_VAR_REL = 0x06;
+
+// Physical maximum of the Resolution Multiplier, the host scales wheel values by it
+constexpr int32_t HID_RESOLUTION_MULTIPLIER = 120;
+
+constexpr HidDescriptor makeMouseDescriptor(const MouseLayout &layout)
+{
+    HidDescriptor d{};
+    int32_t wheelMax = layout.wheelBits == 16 ? 32767 : 127;
+
+    d.usagePage(0x01); // Generic Desktop
+    d.usage(0x02);     // Mouse
+    d.collection(0x01); // Application
+    d.usagePage(0x01);
+    d.usage(0x02);
+    d.collection(0x02); // Logical, the Resolution Multiplier applies to everything in it
+    d.reportId(layout.reportId);
+    d.usage(0x01);      // Pointer
+    d.collection(0x00); // Physical
+
+    // Buttons 1 to 5 and three bits of padding
+    d.usagePage(0x09);
+    d.usageMinimum(0x01);
+    d.usageMaximum(0x05);
+    d.logicalMinimum(0);
+    d.logicalMaximum(1);
+    d.reportSize(1);
+    d.reportCount(5);
+    d.input(HID_DATA_VAR_ABS);
+    d.reportSize(3);
+    d.reportCount(1);
+    d.input(HID_CONST_VAR_ABS);
+
+    d.usagePage(0x01);
+    if (layout.pointer)
+    {
+        d.pointerBit = d.inputBits;
+        d.usage(0x30); // X
+        d.usage(0x31); // Y
+        d.logicalMinimum(-127);
+        d.logicalMaximum(127);
+        d.reportSize(8);
+        d.reportCount(2);
+        d.input(HID_DATA_VAR_REL);
+    }
+
+    d.wheelBit = d.inputBits;
+    d.usage(0x38); // Wheel
+    d.physicalMinimum(0);
+    d.physicalMaximum(0);
+    d.logicalMinimum(-wheelMax);
+    d.logicalMaximum(wheelMax);
+    d.reportSize(layout.wheelBits);
+    d.reportCount(1);
+    d.input(HID_DATA_VAR_REL);
+
+    if (layout.pan)
+    {
+        d.panBit = d.inputBits;
+        d.usagePage(0x0C); // Consumer
+        d.usage(0x0238);   // AC Pan
+        d.input(HID_DATA_VAR_REL);
+    }
+
+    d.usagePage(0x01);
+    d.usage(0x48); // Resolution Multiplier
+    d.logicalMinimum(0);
+    d.logicalMaximum(1);
+    d.physicalMinimum(1);
+    d.physicalMaximum(HID_RESOLUTION_MULTIPLIER);
+    d.reportSize(8);
+    d.reportCount(1);
+    d.feature(HID_DATA_VAR_ABS);
+
+    d.endCollection();
+    d.endCollection();
+    d.endCollection();
+    return d;
+}
+
+constexpr uint8_t CONSUMER_REPORT_ID = 2;
+constexpr uint16_t CONSUMER_USAGE_MAX = 0x3FF; // Highest usage the key array reports, covers the media and AC keys
+
+// One 16-bit usage array entry for the key held down and a 16-bit AC Pan
+constexpr HidDescriptor makeConsumerDescriptor(uint8_t reportId)
+{
+    HidDescriptor d{};
+    d.usagePage(0x0C); // Consumer
+    d.usage(0x01);     // Consumer Control
+    d.collection(0x01); // Application
+    d.reportId(reportId);
+
+    d.wheelBit = d.inputBits; // Key usage, 0 when released
+    d.usageMinimum(0);
+    d.usageMaximum(CONSUMER_USAGE_MAX);
+    d.logicalMinimum(0);
+    d.logicalMaximum(CONSUMER_USAGE_MAX);
+    d.reportSize(16);
+    d.reportCount(1);
+    d.input(HID_DATA_ARRAY_ABS);
+
+    d.panBit = d.inputBits;
+    d.usage(0x0238); // AC Pan
+    d.logicalMinimum(-32767);
+    d.logicalMaximum(32767);
+    d.input(HID_DATA_VAR_REL);
+
+    d.endCollection();
+    return d;
+}
+
+// Report map with the mouse first and the Consumer Control collection after it
+constexpr HidDescriptor makeCompositeDescriptor(const MouseLayout &layout, uint8_t consumerId)
+{
+    HidDescriptor d = makeMouseDescriptor(layout);
+    HidDescriptor consumer = makeConsumerDescriptor(consumerId);
+    for (size_t i = 0; i < consumer.length; i++)
+    {
+        d.data[d.length++] = consumer.data[i];
+    }
+    return d;
+}
+
+struct __attribute__((packed)) ConsumerReport
+{
+    static constexpr int32_t PAN_MAX = 32767;
+
+    uint16_t usage;
+    int16_t pan;
+};
+
+template <HidProfile Profile>
+struct MouseReport;
+
+template <>
+struct __attribute__((packed)) MouseReport<HID_CLASSIC>
+{
+    static constexpr MouseLayout layout = {1, true, 8, false};
+    static constexpr int32_t WHEEL_MAX = 127;
+
+    uint8_t buttons;
+    int8_t x;
+    int8_t y;
+    int8_t wheel;
+
+    void set(uint8_t b, int8_t dx, int8_t dy, int16_t w, int16_t) { buttons = b; x = dx; y = dy; wheel = w; }
+};
+
+template <>
+struct __attribute__((packed)) MouseReport<HID_HIRES>
+{
+    static constexpr MouseLayout layout = {1, true, 16, true};
+    static constexpr int32_t WHEEL_MAX = 32767;
+
+    uint8_t buttons;
+    int8_t x;
+    int8_t y;
+    int16_t wheel;
+    int16_t pan;
+
+    void set(uint8_t b, int8_t dx, int8_t dy, int16_t w, int16_t p) { buttons = b; x = dx; y = dy; wheel = w; pan = p; }
+};
+
+template <>
+struct __attribute__((packed)) MouseReport<HID_SCROLL_ONLY>
+{
+    static constexpr MouseLayout layout = {1, false, 16, true};
+    static constexpr int32_t WHEEL_MAX = 32767;
+
+    uint8_t buttons;
+    int16_t wheel;
+    int16_t pan;
+
+    void set(uint8_t b, int8_t, int8_t, int16_t w, int16_t p) { buttons = b; wheel = w; pan = p; }
+};
+
+// Checks one report struct against the descriptor of its layout
+template <HidProfile Profile>
+constexpr bool reportMatches()
+{
+    typedef MouseReport<Profile> Report;
+    constexpr HidDescriptor d = makeMouseDescriptor(Report::layout);
+    return d.length <= HID_DESCRIPTOR_CAPACITY
+        && d.inputBits == sizeof(Report) * 8
+        && d.featureBits == 8
+        && d.wheelBit == offsetof(Report, wheel) * 8
+        && sizeof(Report::wheel) * 8 == Report::layout.wheelBits;
+}
+
+static_assert(reportMatches<HID_CLASSIC>(), "Classic report does not match its descriptor");
+static_assert(reportMatches<HID_HIRES>(), "Hi-res report does not match its descriptor");
+static_assert(reportMatches<HID_SCROLL_ONLY>(), "Scroll-only report does not match its descriptor");
+static_assert(makeConsumerDescriptor(CONSUMER_REPORT_ID).inputBits == sizeof(ConsumerReport) * 8
+              && makeConsumerDescriptor(CONSUMER_REPORT_ID).wheelBit == offsetof(ConsumerReport, usage) * 8
+              && makeConsumerDescriptor(CONSUMER_REPORT_ID).panBit == offsetof(ConsumerReport, pan) * 8,
+              "Consumer report does not match its descriptor");
+static_assert(makeMouseDescriptor(MouseReport<HID_HIRES>::layout).panBit == offsetof(MouseReport<HID_HIRES>, pan) * 8,
+              "Hi-res pan offset does not match its descriptor");
+static_assert(makeMouseDescriptor(MouseReport<HID_SCROLL_ONLY>::layout).panBit == offsetof(MouseReport<HID_SCROLL_ONLY>, pan) * 8,
+              "Scroll-only pan offset does not match its descriptor");
+
+#endif
@@ -1,6 +0,0 @@
-#ifndef MAIN_H
-#define MAIN_H
-
-int getScrollValue();
-
-#endif
@@ -0,0 +1,64 @@
+#ifndef NOISE_FILTER_H
+#define NOISE_FILTER_H
+
+#include <stdint.h>
+
+#include "scroll-math.h"
+
+// Adaptive dead band for the encoder. An alpha-beta tracker follows the raw
+// samples, the tracking residual while the wheel rests gives an online noise
+// floor, and the AS5600 AGC/magnitude readings widen the band when the field
+// gets weak. While the wheel is turning one more count the same way is motion,
+// so slow, precise turns are not delayed, but turning back has to clear the
+// dead band again. That keeps a wheel that just stopped from creeping on jitter.
+// Without a new count for NOISE_MOVE_HOLD the full band returns.
+// All values are Q4 encoder counts.
+class NoiseFilter
+{
+public:
+    static constexpr int Q = 4;
+
+    NoiseFilter();
+
+    void reset();
+
+    // Dead band limits in Q4 counts and the gain over the noise floor, kept across reset().
+    // Until the noise floor has been learned the band starts at JITTER_THRESHOLD for any gain.
+    void setBand(int32_t min, int32_t max, uint8_t gain);
+
+    // Rest and hold times follow the sampler rate, the speed estimate is rescaled
+    void setSampleRate(uint32_t rate);
+
+    // Feed the wrapped difference between two consecutive raw samples
+    void track(int16_t sampleDiff);
+
+    // Update the field quality from the AS5600 status, AGC and magnitude registers
+    void setSignalQuality(bool magnetDetected, bool fieldOutOfRange, uint8_t agc, uint16_t magnitude);
+
+    // True if countDiff (against the last accepted angle) is real motion
+    bool isMotion(int16_t countDiff);
+
+    int32_t deadBand() const;
+    int32_t noiseFloor() const;
+    int32_t velocity() const { return _velocity; }
+    bool isMoving() const { return _moving; }
+
+private:
+    int32_t _offset;   // Measured minus estimated position
+    int32_t _velocity; // Estimated counts per sample
+    int32_t _noiseSum; // Mean absolute tracking residual at rest, times 2^NOISE_SHIFT
+    int32_t _qualityMargin;
+    uint16_t _restSamples;
+    uint16_t _holdSamples; // Samples since the last accepted count
+    int8_t _direction;     // Sign of the last accepted step
+    bool _moving;
+    bool _noiseLearned;    // _noiseSum has moved off its seed since reset()
+    uint16_t _restLimit;   // NOISE_REST_TIME in samples
+    uint16_t _holdLimit;   // NOISE_MOVE_HOLD in samples
+    uint32_t _sampleRate;
+    int32_t _bandMin;
+    int32_t _bandMax;
+    uint8_t _bandGain;
+};
+
+#endif
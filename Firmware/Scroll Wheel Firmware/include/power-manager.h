@@ -0,0 +1,54 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <stdint.h>
+
+// Motion driven power states. Active samples at full rate, idle polls slowly
+// with the sensor in a low power mode, off releases PWR_SW_PIN. Holding it
+// active, as the USB profile does, skips both timeouts.
+// All times are in ms.
+class PowerManager
+{
+public:
+    enum State : uint8_t
+    {
+        ACTIVE,
+        IDLE,
+        OFF
+    };
+
+    PowerManager();
+
+    void reset(uint32_t now);
+
+    // Call once per sample, returns true if the state changed
+    bool update(uint32_t now, bool moving);
+
+    // Call when a sample produced a value for the host, ends the wake latency
+    void onReport(uint32_t now);
+
+    void setIdleTimeout(uint32_t timeout) { _idleTimeout = timeout; }
+    void setOffTimeout(uint32_t timeout) { _offTimeout = timeout; } // 0 never powers off
+    void setHoldActive(bool hold) { _holdActive = hold; } // Takes effect with the next update
+    bool isHeldActive() const { return _holdActive; }
+
+    State getState() const { return _state; }
+    uint32_t getWakeups() const { return _wakeups; }
+    uint32_t getWakeLatency() const { return _wakeLatency; } // Moving idle poll to the first report at the full rate
+    uint32_t getMaxWakeLatency() const { return _maxWakeLatency; }
+
+private:
+    State _state;
+    uint32_t _lastMotion;
+    uint32_t _idleTimeout;
+    uint32_t _offTimeout;
+    volatile bool _holdActive; // Set from the power sense task
+    uint32_t _wakeups;
+    uint32_t _wakeStart;   // Idle poll that saw the motion
+    uint32_t _wakeSamples; // Samples at the full rate since then
+    bool _waking;          // Wake-up not reported yet
+    uint32_t _wakeLatency;
+    uint32_t _maxWakeLatency;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef POWER_SOURCE_H
+#define POWER_SOURCE_H
+
+#include <stdint.h>
+
+enum PowerProfile : uint8_t
+{
+    POWER_PROFILE_BATTERY = 0, // Idle downshift, idle connection parameters and power off, as configured
+    POWER_PROFILE_USB          // Full sample rate and fast connection parameters all the time, traces running
+};
+
+// Debounced USB and charger sense inputs and the power profile they select.
+// A level has to hold for POWER_SENSE_DEBOUNCE before it counts, so plugging
+// in or a bouncing connector switches once. The charger status only means
+// something while USB is present, it floats on battery.
+// All times are in ms.
+class PowerSource
+{
+public:
+    PowerSource();
+
+    // Takes the levels at boot as settled, the profile applies right away
+    void reset(uint32_t now, bool usbPresent, bool chargeActive);
+
+    // Call periodically with the pin levels, returns true if the profile changed
+    bool update(uint32_t now, bool usbPresent, bool chargeActive);
+
+    PowerProfile getProfile() const { return _usb ? POWER_PROFILE_USB : POWER_PROFILE_BATTERY; }
+    bool isUsbPowered() const { return _usb; }
+    bool isCharging() const { return _usb && _charging; }
+    uint32_t getSwitches() const { return _switches; } // Profile changes since boot
+
+private:
+    bool _usb;            // Debounced levels
+    bool _charging;
+    bool _usbLevel;       // Last raw levels and when they last changed
+    bool _chargeLevel;
+    uint32_t _usbChanged;
+    uint32_t _chargeChanged;
+    uint32_t _switches;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef REPORT_COALESCER_H
+#define REPORT_COALESCER_H
+
+#include <stdint.h>
+
+// Where wheel reports end up, implemented by BleMouse and by fakes
+class ReportSink
+{
+public:
+    virtual ~ReportSink() {}
+    virtual bool canSend() = 0; // False while the stack is congested or out of credits
+    virtual void sendWheel(int16_t wheel) = 0;
+};
+
+// Collects wheel deltas and sends them as few reports as the link allows.
+// Deltas that arrive while the sink cannot take a report are merged into the
+// pending value instead of queueing stale packets, and values beyond the
+// report field (maxStep) are split across successive reports.
+class ReportCoalescer
+{
+public:
+    ReportCoalescer(ReportSink &sink, int32_t maxStep = 127);
+
+    void add(int32_t wheel);
+
+    // Sends as much of the pending value as the sink accepts, returns true once nothing is left
+    bool flush();
+
+    void clear();
+
+    int32_t getPending() const { return _pending; }
+    uint32_t getReports() const { return _reports; }
+    uint32_t getCoalesced() const { return _coalesced; }
+    uint32_t getSplit() const { return _split; }
+
+private:
+    ReportSink &_sink;
+    int32_t _maxStep;
+    int32_t _pending;
+    uint32_t _reports;   // Reports handed to the sink
+    uint32_t _coalesced; // Deltas merged into a value that was still pending
+    uint32_t _split;     // Reports needed beyond one per flushed value
+};
+
+#endif
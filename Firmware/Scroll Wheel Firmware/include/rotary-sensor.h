@@ -1,6 +1,88 @@
-#ifndef BATTERY_H
-#define BATTERY_H
+#ifndef ROTARY_SENSOR_H
+#define ROTARY_SENSOR_H
 
-int getScrollValue();
+#include <stdint.h>
+
+#include "angle-tracker.h"
+#include "calibration.h"
+#include "config.h"
+#include "flywheel.h"
+#include "hal.h"
+#include "noise-filter.h"
+#include "wheel-mode.h"
+
+// Turns raw encoder samples into scroll report units: linearity correction,
+// noise band, wrap-around, acceleration, the fixed-point remainder and inertia.
+// In the consumer modes the values are jog steps, key steps or shuttle pan instead.
+class RotarySensor
+{
+public:
+    RotarySensor(AngleSensor &sensor);
+
+    void reset();
+
+    // Reads one sample, returns whole report units and keeps the fraction for later,
+    // or the consumer value of the mode getMode() returns.
+    // multiplier is 1 or WHEEL_HIRES_MULTIPLIER, as negotiated by the host.
+    // Reads the AGC/magnitude first when they are due.
+    int32_t getScrollValue(uint8_t multiplier);
+
+    // The two halves of getScrollValue() for callers that schedule the
+    // AGC/magnitude reads themselves: the angle read and the pipeline, and the
+    // quality read, which returns false without touching the bus until
+    // NOISE_QUALITY_INTERVAL worth of samples went by
+    int32_t readScrollValue(uint8_t multiplier);
+    bool pollSignalQuality();
+
+    // Runs an angle that was already read and linearity corrected through the pipeline
+    int32_t processAngle(int16_t rawAngle, uint8_t multiplier);
+    int32_t processAngle(int16_t rawAngle, uint8_t multiplier, const ScrollConfig &config);
+
+    // Extra wheels always scroll, only the primary one follows the consumer modes
+    void setFollowsMode(bool follows) { _followsMode = follows; }
+
+    // The linearity table is measured on the primary wheel, extra encoders take their raw angle
+    void setUsesCalibration(bool uses) { _usesCalibration = uses; }
+
+    // Keeps the speed estimates and every per-sample time of the stages in step with the sampler
+    void setSampleRate(uint32_t rate);
+
+    int16_t getLastAngle() const { return _sampleBefore; } // Corrected, as the pipeline saw it
+    int16_t getRawAngle() const { return _rawAngle; }      // Before the linearity correction
+    bool isReadOk() const { return _readOk; }             // The last read returned an angle
+    uint32_t getReadErrors() const { return _readErrors; }
+    const NoiseFilter &getNoiseFilter() const { return _filter; }
+    const Flywheel &getFlywheel() const { return _flywheel; }
+    const AngleTracker &getTracker() const { return _tracker; }
+    const WheelModeEngine &getModes() const { return _modes; }
+    uint8_t getMode() const { return _modes.getMode(); } // WheelMode the last value was produced in
+
+    // Wheel turning, still coasting after a flick or the shuttle running
+    bool isMoving() const { return _filter.isMoving() || _flywheel.isCoasting() || _modes.isActive(); }
+
+private:
+    void readSignalQuality();
+    void applyCalibration(const CalibrationTable &table);
+
+    AngleSensor &_sensor;
+    AngleTracker _tracker;
+    NoiseFilter _filter;
+    Flywheel _flywheel;
+    WheelModeEngine _modes;
+    int64_t _acceptedPosition; // Unwrapped position of the last accepted angle
+    int64_t _positionBefore;   // Unwrapped position of the previous sample
+    int16_t _sampleBefore;     // Raw angle of the previous sample
+    int64_t _remainder;        // Q12 report units not yet reported, carried between reads
+    uint8_t _multiplier;       // Wheel multiplier the remainder was accumulated with
+    uint32_t _qualitySamples;  // Samples since the last AGC/magnitude read
+    uint32_t _qualityInterval; // NOISE_QUALITY_INTERVAL in samples
+    uint32_t _sampleRate;
+    uint32_t _readErrors;      // Reads the backend gave up on
+    int16_t _rawAngle;         // Last angle read, before the linearity correction
+    const CalibrationTable *_calibration; // Table the positions were corrected with, nullptr after reset()
+    bool _readOk;
+    bool _followsMode;         // Runs the consumer modes of the config, or always scrolls
+    bool _usesCalibration;     // Corrects the angle with the published linearity table
+};
 
 #endif
@@ -0,0 +1,27 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdint.h>
+
+#include "power-manager.h"
+#include "trace.h"
+
+struct ScrollSample
+{
+    uint32_t timestamp; // Sample time in us
+    int32_t delta;      // Scroll units produced by this sample, or steps and pan in the consumer modes
+    int32_t pan;        // AC Pan notches from the extra wheels
+    uint8_t mode;       // WheelMode the delta belongs to
+};
+
+extern TraceBuffer sampleTrace;
+extern TraceBuffer reportTrace;
+extern PowerManager powerManager;
+
+void startReporter(); // Link upkeep and reports, runs from boot on
+void startSampler(); // Once the encoder answers, needs the reporter
+void pauseSampler(bool paused); // Stops the sample timer so the sensor can be used elsewhere
+uint32_t getSamplerOverruns();
+void powerOff(); // Releases PWR_SW_PIN, sleeps if USB keeps the board running
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef SCROLL_ACCEL_H
+#define SCROLL_ACCEL_H
+
+#include <stdint.h>
+
+enum AccelCurve : uint8_t
+{
+    ACCEL_OFF = 0, // Constant gain of 1
+    ACCEL_LINEAR,  // Gain rises linearly with speed
+    ACCEL_POWER,   // Gain rises with speed^ACCEL_POWER_EXPONENT
+    ACCEL_SIGMOID, // Flat at both ends, steep around half of ACCEL_MAX_SPEED
+    ACCEL_CUSTOM,  // Piecewise linear curve from scroll-accel.cpp
+    ACCEL_CURVE_COUNT
+};
+
+constexpr int ACCEL_GAIN_BITS = 8; // Gains are Q8, 256 is a gain of 1
+
+// Gain for a velocity in Q4 encoder counts per sample at SAMPLE_RATE_HZ, curve must be below ACCEL_CURVE_COUNT
+uint16_t getAccelGain(int32_t velocity, uint8_t curve);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef SCROLL_MATH_H
+#define SCROLL_MATH_H
+
+#include <stdint.h>
+
+#include "defaults.h"
+
+// Integer constants for the scroll pipeline, derived from the degree based
+// settings in defaults.h so the hot path only ever sees raw encoder counts.
+
+constexpr int32_t ENCODER_COUNTS = 4096; // Counts per revolution (12-bit)
+constexpr int SCROLL_FRACTION_BITS = 12; // Scroll remainder is kept in Q12 report units
+constexpr int32_t SCROLL_ONE = 1 << SCROLL_FRACTION_BITS;
+
+constexpr double degreesToCounts(double degrees)
+{
+    return degrees * ENCODER_COUNTS / 360.0;
+}
+
+constexpr int32_t ceilCounts(double counts)
+{
+    return (int32_t)counts < counts ? (int32_t)counts + 1 : (int32_t)counts;
+}
+
+constexpr int32_t roundCounts(double counts)
+{
+    return counts < 0 ? (int32_t)(counts - 0.5) : (int32_t)(counts + 0.5);
+}
+
+// |diff| < JITTER_THRESHOLD degrees  <=>  |counts| < JITTER_COUNTS
+constexpr int32_t JITTER_COUNTS = ceilCounts(degreesToCounts(JITTER_THRESHOLD));
+
+// diff > MAX_ROTATION_PER_READ degrees  <=>  counts > MAX_ROTATION_COUNTS
+constexpr int32_t MAX_ROTATION_COUNTS = (int32_t)degreesToCounts(MAX_ROTATION_PER_READ);
+
+// Report units per encoder count in Q12, before the host wheel multiplier
+constexpr int32_t SCROLL_GAIN_Q12 = roundCounts(SCROLL_MULTIPLICATOR * 360.0 * SCROLL_ONE / ENCODER_COUNTS);
+
+// Samples in a time at a sample rate, at least one so a timeout always ends
+constexpr uint32_t samplesFor(uint32_t rate, uint32_t ms)
+{
+    return (uint64_t)rate * ms / 1000 > 0 ? (uint32_t)((uint64_t)rate * ms / 1000) : 1;
+}
+
+// Divide by 2^bits rounding half away from zero, so both directions lose the same
+inline int64_t roundShift(int64_t value, int bits)
+{
+    int64_t half = (int64_t)1 << (bits - 1);
+    return value < 0 ? -((-value + half) >> bits) : (value + half) >> bits;
+}
+
+// Map a raw count difference onto the shortest rotation
+inline int16_t wrapCounts(int16_t countDiff, int32_t maxRotation = MAX_ROTATION_COUNTS)
+{
+    if (countDiff > maxRotation)
+    {
+        return countDiff - ENCODER_COUNTS;
+    }
+    if (countDiff < -maxRotation)
+    {
+        return countDiff + ENCODER_COUNTS;
+    }
+    return countDiff;
+}
+
+static_assert(JITTER_COUNTS >= 0 && JITTER_COUNTS < ENCODER_COUNTS / 2, "JITTER_THRESHOLD out of range");
+static_assert(MAX_ROTATION_COUNTS > 0 && MAX_ROTATION_COUNTS < ENCODER_COUNTS, "MAX_ROTATION_PER_READ out of range");
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef SENSOR_CHANNELS_H
+#define SENSOR_CHANNELS_H
+
+#include <stdint.h>
+
+#include "hal.h"
+#include "rotary-sensor.h"
+
+constexpr uint8_t MAX_SENSOR_CHANNELS = 4;
+
+enum ChannelAxis : uint8_t
+{
+    CHANNEL_WHEEL = 0, // Mouse wheel, or the consumer mode of the primary channel
+    CHANNEL_PAN        // AC Pan on the consumer report
+};
+
+// Several encoders, each with its own RotarySensor pipeline, read back to
+// back in a fixed order within one sampler tick. The fixed order keeps every
+// channel at the same offset into the tick, so adding a channel moves none of
+// the sample times around as long as all reads fit the sample period. The
+// AGC/magnitude reads come after all angles, one channel per tick at most.
+// Channel 0 is the primary wheel: it alone follows the consumer modes, uses
+// the linearity table, feeds the calibration, telemetry and trace. Extra
+// wheel channels only add to it while it scrolls.
+class SensorChannels
+{
+public:
+    SensorChannels(Clock &clock);
+
+    // Returns false once full, the first channel has to be a wheel
+    bool add(RotarySensor &sensor, ChannelAxis axis);
+
+    // One tick. Wheel channels use the host's multiplier, the consumer report
+    // has no Resolution Multiplier so pan is always in notches.
+    void sample(uint8_t multiplier, int32_t &wheel, int32_t &pan);
+
+    bool isMoving() const;
+
+    uint8_t getCount() const { return _count; }
+    RotarySensor &getSensor(uint8_t channel) const { return *_sensors[channel]; }
+    ChannelAxis getAxis(uint8_t channel) const { return _axes[channel]; }
+
+    // Timing in us since resetTiming(): the longest tick from the first read
+    // to the end of the last, and how far the start of a channel's read moved
+    // within the tick, 0 before the first tick
+    void resetTiming();
+    uint32_t getMaxTickTime() const { return _maxTickTime; }
+    uint32_t getOffsetJitter(uint8_t channel) const
+    {
+        return _maxOffset[channel] >= _minOffset[channel] ? _maxOffset[channel] - _minOffset[channel] : 0;
+    }
+
+private:
+    Clock &_clock;
+    RotarySensor *_sensors[MAX_SENSOR_CHANNELS];
+    ChannelAxis _axes[MAX_SENSOR_CHANNELS];
+    uint8_t _count;
+    uint8_t _qualityNext; // Channel the next AGC/magnitude read looks at first
+    uint32_t _maxTickTime;
+    uint32_t _minOffset[MAX_SENSOR_CHANNELS];
+    uint32_t _maxOffset[MAX_SENSOR_CHANNELS];
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+
+// Lock-free ring buffer for exactly one producer and one consumer task.
+// One slot is kept free to tell a full queue from an empty one.
+template <typename T, size_t Size>
+class SpscQueue
+{
+    static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "Queue size must be a power of two");
+
+public:
+    // Producer side, returns false if the queue is full
+    bool push(const T &item)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t next = (head + 1) & (Size - 1);
+        if (next == _tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        _items[head] = item;
+        _head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, returns false if the queue is empty
+    bool pop(T &item)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = _items[tail];
+        _tail.store((tail + 1) & (Size - 1), std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return _tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return Size - 1; }
+
+private:
+    T _items[Size];
+    std::atomic<size_t> _head{0};
+    std::atomic<size_t> _tail{0};
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+// Hot path instrumentation. Everything below the snapshot layout compiles
+// to nothing unless the build defines SCROLL_STATS.
+
+enum StatId : uint8_t
+{
+    STAT_I2C_READ, // Encoder read, CPU cycles at the snapshot's cyclesPerUs
+    STAT_COMPUTE,  // Scroll pipeline after the read, same
+    STAT_NOTIFY,   // Handing a report to the BLE stack, same
+    STAT_LATENCY,  // Sample to notify, us
+    STAT_ID_COUNT
+};
+
+enum CounterId : uint8_t
+{
+    COUNTER_REPORTS,     // Reports sent
+    COUNTER_COALESCED,   // Deltas merged into a pending report
+    COUNTER_DROPPED,     // Samples lost on a full queue
+    COUNTER_OVERRUNS,    // Sampler slots missed
+    COUNTER_READ_ERRORS, // Encoder reads that failed or timed out
+    COUNTER_ID_COUNT
+};
+
+constexpr int STAT_BUCKETS = 16; // Bucket n counts values below 2^n, the last one everything above
+constexpr uint8_t STATS_VERSION = 2;
+
+struct __attribute__((packed)) StatSnapshot
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t avg;
+    uint16_t buckets[STAT_BUCKETS]; // Saturating
+};
+
+// Layout of the stats characteristic
+struct __attribute__((packed)) StatsSnapshot
+{
+    uint8_t version;
+    uint16_t cyclesPerUs; // POWER_ACTIVE_CPU_MHZ, cycles taken at the idle clock are scaled up to it
+    StatSnapshot stats[STAT_ID_COUNT];
+    uint32_t counters[COUNTER_ID_COUNT];
+};
+
+#ifdef SCROLL_STATS
+
+static inline uint32_t statCycles()
+{
+#if defined(__XTENSA__)
+    uint32_t cycles;
+    asm volatile("rsr %0, ccount" : "=a"(cycles));
+    return cycles;
+#elif defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+void recordStat(StatId id, uint32_t value);
+void recordCycles(StatId id, uint32_t cycles); // Scales from the clock running now
+void countStat(CounterId id, uint32_t amount);
+void resetStats();
+void getStats(StatsSnapshot &snapshot);
+
+#define STAT_START(timer) uint32_t timer = statCycles()
+#define STAT_STOP(id, timer) recordCycles(id, statCycles() - (timer))
+#define STAT_RECORD(id, value) recordStat(id, value)
+#define STAT_COUNT(id, amount) countStat(id, amount)
+
+#else
+
+#define STAT_START(timer)
+#define STAT_STOP(id, timer)
+#define STAT_RECORD(id, value)
+#define STAT_COUNT(id, amount)
+
+#endif
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef TELEMETRY_SERVICE_H
+#define TELEMETRY_SERVICE_H
+
+#include <stdint.h>
+
+class BLECharacteristic;
+class BLEServer;
+
+// Streams raw samples, battery and stats in the telemetry.h format while a
+// client has notifications enabled on the characteristic
+void startTelemetry(BLEServer *server, BLECharacteristic *characteristic);
+
+// Sampler side, queues one sample while a client listens
+void addTelemetrySample(uint32_t timestamp, int16_t rawAngle);
+
+#endif
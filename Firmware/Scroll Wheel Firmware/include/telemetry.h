@@ -0,0 +1,577 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Binary telemetry stream of the vendor telemetry characteristic. Header only
+// and free of firmware dependencies so host tools can take it as is.
+//
+// The stream is a sequence of frames, cut into notifications without regard
+// for frame boundaries. One notification may carry several frames, the end
+// of one and the start of the next, or a piece out of the middle of one.
+//   sync     0xA0 | TELEMETRY_VERSION
+//   type     TelemetryType
+//   length   payload bytes
+//   payload
+//   crc      CRC-8, polynomial 0x07, over type, length and payload
+// Payloads are little endian, varints are LEB128 as in the trace format:
+//   SAMPLES  u32 timestamp (us), u16 raw angle, u16 nominal period (us),
+//            then per further sample zigzag varint dt - period (us) and
+//            zigzag varint angle delta (counts), two bytes for most samples
+//   BATTERY  u8 level (%), u16 pack voltage (mV), u8 TelemetryPower flags
+//   STATS    one varint per TelemetryStat, newer firmware may append more
+// Frame types a decoder does not know are skipped.
+
+constexpr uint8_t TELEMETRY_VERSION = 1;
+constexpr uint8_t TELEMETRY_SYNC = 0xA0 | TELEMETRY_VERSION;
+constexpr size_t TELEMETRY_HEADER_SIZE = 3;
+constexpr size_t TELEMETRY_MAX_PAYLOAD = 255;
+constexpr size_t TELEMETRY_MAX_FRAME = TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_PAYLOAD + 1;
+constexpr size_t TELEMETRY_SAMPLES_BASE = 8; // First sample and the nominal period
+constexpr size_t TELEMETRY_STAT_CAPACITY = 16; // Stats a decoder keeps per frame
+
+enum TelemetryType : uint8_t
+{
+    TELEMETRY_SAMPLES = 1,
+    TELEMETRY_BATTERY = 2,
+    TELEMETRY_STATS = 3
+};
+
+enum TelemetryPower : uint8_t
+{
+    TELEMETRY_POWER_USB = 0x01,     // USB power present
+    TELEMETRY_POWER_CHARGING = 0x02 // Charger reports a charge in progress
+};
+
+enum TelemetryStat : uint8_t
+{
+    TELEMETRY_STAT_OVERRUNS,    // Sampler slots missed or dropped
+    TELEMETRY_STAT_READ_ERRORS, // Encoder reads that failed
+    TELEMETRY_STAT_RECONNECTS,  // Reconnects since boot
+    TELEMETRY_STAT_DROPPED,     // Telemetry samples lost to a slow link
+    TELEMETRY_STAT_ALIASED,     // Samples too far off the predicted angle, see AngleTracker
+    TELEMETRY_STAT_COUNT
+};
+
+struct TelemetryCrcTable
+{
+    uint8_t values[256];
+};
+
+constexpr TelemetryCrcTable makeTelemetryCrcTable()
+{
+    TelemetryCrcTable table{};
+    for (int i = 0; i < 256; i++)
+    {
+        uint8_t crc = i;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 0x80 ? (uint8_t)(crc << 1) ^ 0x07 : (uint8_t)(crc << 1);
+        }
+        table.values[i] = crc;
+    }
+    return table;
+}
+
+inline constexpr TelemetryCrcTable TELEMETRY_CRC_TABLE = makeTelemetryCrcTable();
+
+inline uint8_t telemetryCrc(const uint8_t *data, size_t length)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = TELEMETRY_CRC_TABLE.values[crc ^ data[i]];
+    }
+    return crc;
+}
+
+// Angle difference on the shortest way round a 12-bit turn
+inline int16_t telemetryAngleDelta(int16_t angle, int16_t before)
+{
+    return ((angle - before + 2048) & 4095) - 2048;
+}
+
+// Builds the stream into a fixed buffer. Samples are appended to an open
+// frame until it is full or flush() closes it, only closed frames are ready
+// to be sent.
+class TelemetryEncoder
+{
+public:
+    TelemetryEncoder(uint8_t *buffer, size_t capacity, uint16_t samplePeriod)
+        : _buffer(buffer), _capacity(capacity), _samplePeriod(samplePeriod)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        _length = 0;
+        _ready = 0;
+        _frameOpen = false;
+    }
+
+    const uint8_t *data() const { return _buffer; }
+    size_t ready() const { return _ready; }
+
+    // Drops bytes from the front once they were sent
+    void consume(size_t length)
+    {
+        if (length > _ready)
+        {
+            length = _ready;
+        }
+        memmove(_buffer, _buffer + length, _length - length);
+        _length -= length;
+        _ready -= length;
+        _frameStart -= length;
+    }
+
+    // Returns false if the buffer is full, the sample is then lost
+    bool addSample(uint32_t timestamp, int16_t angle)
+    {
+        if (_frameOpen)
+        {
+            uint8_t record[10];
+            size_t size = putVarint(record, zigzag(timestamp - _time - _samplePeriod));
+            size += putVarint(record + size, zigzag(telemetryAngleDelta(angle, _angle)));
+            if (payloadLength() + size <= TELEMETRY_MAX_PAYLOAD && _length + size + 1 <= _capacity)
+            {
+                memcpy(_buffer + _length, record, size);
+                _length += size;
+                _time = timestamp;
+                _angle = angle;
+                return true;
+            }
+            close();
+        }
+
+        if (!open(TELEMETRY_SAMPLES, TELEMETRY_SAMPLES_BASE))
+        {
+            return false;
+        }
+        putU32(timestamp);
+        putU16(angle);
+        putU16(_samplePeriod);
+        _time = timestamp;
+        _angle = angle;
+        return true;
+    }
+
+    bool addBattery(uint8_t level, uint16_t millivolts, uint8_t power)
+    {
+        flush();
+        if (!open(TELEMETRY_BATTERY, 4))
+        {
+            return false;
+        }
+        _buffer[_length++] = level;
+        putU16(millivolts);
+        _buffer[_length++] = power;
+        close();
+        return true;
+    }
+
+    bool addStats(const uint32_t *values, uint8_t count)
+    {
+        flush();
+        uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+        size_t size = 0;
+        for (uint8_t i = 0; i < count && size + 5 <= sizeof(payload); i++)
+        {
+            size += putVarint(payload + size, values[i]);
+        }
+        if (!open(TELEMETRY_STATS, size))
+        {
+            return false;
+        }
+        memcpy(_buffer + _length, payload, size);
+        _length += size;
+        close();
+        return true;
+    }
+
+    // Closes the open samples frame so it can be sent
+    void flush()
+    {
+        if (_frameOpen)
+        {
+            close();
+        }
+    }
+
+private:
+    size_t payloadLength() const { return _length - _frameStart - TELEMETRY_HEADER_SIZE; }
+
+    bool open(uint8_t type, size_t payload)
+    {
+        if (_length + TELEMETRY_HEADER_SIZE + payload + 1 > _capacity)
+        {
+            return false;
+        }
+        _frameStart = _length;
+        _buffer[_length++] = TELEMETRY_SYNC;
+        _buffer[_length++] = type;
+        _buffer[_length++] = 0; // Length, filled in by close()
+        _frameOpen = true;
+        return true;
+    }
+
+    void close()
+    {
+        _buffer[_frameStart + 2] = payloadLength();
+        _buffer[_length] = telemetryCrc(_buffer + _frameStart + 1, _length - _frameStart - 1);
+        _length++;
+        _ready = _length;
+        _frameOpen = false;
+    }
+
+    void putU16(uint16_t value)
+    {
+        _buffer[_length++] = value;
+        _buffer[_length++] = value >> 8;
+    }
+
+    void putU32(uint32_t value)
+    {
+        putU16(value);
+        putU16(value >> 16);
+    }
+
+    static uint32_t zigzag(int32_t value) { return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31); }
+
+    static size_t putVarint(uint8_t *out, uint32_t value)
+    {
+        size_t size = 0;
+        while (value >= 0x80)
+        {
+            out[size++] = (value & 0x7F) | 0x80;
+            value >>= 7;
+        }
+        out[size++] = value;
+        return size;
+    }
+
+    uint8_t *_buffer;
+    size_t _capacity;
+    uint16_t _samplePeriod;
+    size_t _length;     // Bytes in the buffer, including an open frame
+    size_t _ready;      // Bytes of closed frames at the front
+    size_t _frameStart; // Offset of the open frame
+    bool _frameOpen;
+    uint32_t _time;     // Timestamp and angle of the last sample in the open frame
+    int16_t _angle;
+};
+
+struct TelemetryEvent
+{
+    TelemetryType type;
+    uint32_t timestamp; // SAMPLES, us
+    int16_t angle;      // SAMPLES, raw 12-bit angle
+    int16_t delta;      // SAMPLES, counts since the previous sample, 0 for the first one
+    uint8_t level;      // BATTERY, %
+    uint16_t millivolts;
+    uint8_t power;      // BATTERY, TelemetryPower flags
+    uint8_t statCount;  // STATS, values beyond TELEMETRY_STAT_CAPACITY are dropped
+    uint32_t stats[TELEMETRY_STAT_CAPACITY];
+};
+
+// Parses the stream without allocating. Whole frames are decoded straight
+// from the data handed to feed(), only a frame cut off at the end of a piece
+// is copied aside until the rest arrives. Bytes outside a valid frame are
+// skipped until the next sync byte with a matching CRC.
+class TelemetryDecoder
+{
+public:
+    TelemetryDecoder()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        _input = NULL;
+        _inputLength = 0;
+        _inputPosition = 0;
+        _partialStart = 0;
+        _partialLength = 0;
+        _inFrame = false;
+        _hasAngle = false;
+        _angle = 0;
+        _time = 0;
+        _samplePeriod = 0;
+        _frames = 0;
+        _crcErrors = 0;
+        _malformed = 0;
+        _skipped = 0;
+    }
+
+    // Hands over the next piece of the stream. It is parsed in place and has
+    // to stay valid until next() returns false.
+    void feed(const uint8_t *data, size_t length)
+    {
+        _input = data;
+        _inputLength = length;
+        _inputPosition = 0;
+    }
+
+    // Returns false once the pieces fed so far are used up
+    bool next(TelemetryEvent &event)
+    {
+        while (true)
+        {
+            if (_inFrame)
+            {
+                if (_position < _payloadLength)
+                {
+                    if (readSample(event))
+                    {
+                        return true;
+                    }
+                    _malformed++;
+                }
+                _inFrame = false;
+            }
+
+            if (!nextFrame())
+            {
+                return false;
+            }
+            _frames++;
+
+            if (readFrame(event))
+            {
+                return true;
+            }
+        }
+    }
+
+    uint32_t getFrames() const { return _frames; }
+    uint32_t getCrcErrors() const { return _crcErrors; }
+    uint32_t getMalformed() const { return _malformed; } // Frames with a valid CRC but a broken payload
+    uint32_t getSkipped() const { return _skipped; }     // Bytes outside any valid frame
+
+private:
+    static size_t frameSize(const uint8_t *frame, size_t available)
+    {
+        return available < TELEMETRY_HEADER_SIZE ? TELEMETRY_HEADER_SIZE : TELEMETRY_HEADER_SIZE + frame[2] + 1;
+    }
+
+    static bool checkFrame(const uint8_t *frame, size_t size)
+    {
+        return telemetryCrc(frame + 1, size - 2) == frame[size - 1];
+    }
+
+    void startFrame(const uint8_t *frame)
+    {
+        _type = frame[1];
+        _payload = frame + TELEMETRY_HEADER_SIZE;
+        _payloadLength = frame[2];
+        _position = 0;
+    }
+
+    // Finds the next complete frame with a valid CRC
+    bool nextFrame()
+    {
+        while (true)
+        {
+            // Bytes left over from earlier pieces come first
+            if (_partialStart < _partialLength)
+            {
+                uint8_t *pending = _partial + _partialStart;
+                size_t available = _partialLength - _partialStart;
+                if (pending[0] != TELEMETRY_SYNC)
+                {
+                    _partialStart++;
+                    _skipped++;
+                    continue;
+                }
+
+                size_t size = frameSize(pending, available);
+                if (available < size)
+                {
+                    if (_inputPosition >= _inputLength)
+                    {
+                        compactPartial();
+                        return false;
+                    }
+                    compactPartial();
+                    size_t take = size - available;
+                    if (take > _inputLength - _inputPosition)
+                    {
+                        take = _inputLength - _inputPosition;
+                    }
+                    memcpy(_partial + _partialLength, _input + _inputPosition, take);
+                    _partialLength += take;
+                    _inputPosition += take;
+                    continue;
+                }
+
+                if (checkFrame(pending, size))
+                {
+                    _partialStart += size;
+                    startFrame(pending);
+                    return true;
+                }
+                _crcErrors++;
+                _partialStart++;
+                _skipped++;
+                continue;
+            }
+            _partialStart = 0;
+            _partialLength = 0;
+
+            while (_inputPosition < _inputLength && _input[_inputPosition] != TELEMETRY_SYNC)
+            {
+                _inputPosition++;
+                _skipped++;
+            }
+            if (_inputPosition >= _inputLength)
+            {
+                return false;
+            }
+
+            const uint8_t *frame = _input + _inputPosition;
+            size_t available = _inputLength - _inputPosition;
+            size_t size = frameSize(frame, available);
+            if (available < size)
+            {
+                // Continues in the next piece
+                memcpy(_partial, frame, available);
+                _partialLength = available;
+                _inputPosition = _inputLength;
+                return false;
+            }
+
+            if (checkFrame(frame, size))
+            {
+                _inputPosition += size;
+                startFrame(frame);
+                return true;
+            }
+            _crcErrors++;
+            _inputPosition++;
+            _skipped++;
+        }
+    }
+
+    void compactPartial()
+    {
+        memmove(_partial, _partial + _partialStart, _partialLength - _partialStart);
+        _partialLength -= _partialStart;
+        _partialStart = 0;
+    }
+
+    bool readFrame(TelemetryEvent &event)
+    {
+        switch (_type)
+        {
+        case TELEMETRY_SAMPLES:
+            if (_payloadLength < TELEMETRY_SAMPLES_BASE)
+            {
+                _malformed++;
+                return false;
+            }
+            event.type = TELEMETRY_SAMPLES;
+            event.timestamp = getU32(_payload);
+            event.angle = getU16(_payload + 4) & 4095;
+            _samplePeriod = getU16(_payload + 6);
+            event.delta = _hasAngle ? telemetryAngleDelta(event.angle, _angle) : 0;
+            _time = event.timestamp;
+            _angle = event.angle;
+            _hasAngle = true;
+            _position = TELEMETRY_SAMPLES_BASE;
+            _inFrame = true;
+            return true;
+        case TELEMETRY_BATTERY:
+            if (_payloadLength < 4)
+            {
+                _malformed++;
+                return false;
+            }
+            event.type = TELEMETRY_BATTERY;
+            event.level = _payload[0];
+            event.millivolts = getU16(_payload + 1);
+            event.power = _payload[3];
+            return true;
+        case TELEMETRY_STATS:
+            event.type = TELEMETRY_STATS;
+            event.statCount = 0;
+            while (_position < _payloadLength)
+            {
+                uint32_t value;
+                if (!readVarint(value))
+                {
+                    _malformed++;
+                    return false;
+                }
+                if (event.statCount < TELEMETRY_STAT_CAPACITY)
+                {
+                    event.stats[event.statCount++] = value;
+                }
+            }
+            return true;
+        default:
+            return false; // From newer firmware
+        }
+    }
+
+    bool readSample(TelemetryEvent &event)
+    {
+        uint32_t dt;
+        uint32_t delta;
+        if (!readVarint(dt) || !readVarint(delta))
+        {
+            return false;
+        }
+        event.type = TELEMETRY_SAMPLES;
+        event.timestamp = _time + _samplePeriod + unzigzag(dt);
+        event.delta = unzigzag(delta);
+        event.angle = (_angle + event.delta) & 4095;
+        _time = event.timestamp;
+        _angle = event.angle;
+        return true;
+    }
+
+    bool readVarint(uint32_t &value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 35 && _position < _payloadLength; shift += 7)
+        {
+            uint8_t byte = _payload[_position++];
+            value |= (uint32_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static int32_t unzigzag(uint32_t value) { return (int32_t)((value >> 1) ^ (0 - (value & 1))); }
+    static uint16_t getU16(const uint8_t *data) { return data[0] | (data[1] << 8); }
+    static uint32_t getU32(const uint8_t *data) { return getU16(data) | ((uint32_t)getU16(data + 2) << 16); }
+
+    const uint8_t *_input;
+    size_t _inputLength;
+    size_t _inputPosition;
+    uint8_t _partial[TELEMETRY_MAX_FRAME]; // Start of a frame cut off at the end of a piece
+    size_t _partialStart;
+    size_t _partialLength;
+    const uint8_t *_payload; // Frame being decoded, in the input or the partial buffer
+    size_t _payloadLength;
+    size_t _position;
+    uint8_t _type;
+    bool _inFrame;           // Samples frame with records left
+    bool _hasAngle;
+    int16_t _angle;
+    uint32_t _time;
+    uint16_t _samplePeriod;
+    uint32_t _frames;
+    uint32_t _crcErrors;
+    uint32_t _malformed;
+    uint32_t _skipped;
+};
+
+#endif
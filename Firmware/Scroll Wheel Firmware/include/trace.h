@@ -0,0 +1,128 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "defaults.h"
+
+// RAM trace of raw encoder samples and emitted reports for bug reports and replay.
+//
+// The buffer is a ring of fixed size blocks. Each block starts with the absolute
+// time and angle, followed by delta encoded records:
+//   0x00-0x7F  run of (tag + 1) resting samples one nominal period apart
+//   0x80       sample: zigzag(dt - period), zigzag(angle delta), zigzag(value)
+//   0x81       report: dt, zigzag(value)
+// All numbers after the tag are LEB128 varints. When the ring is full the
+// oldest block is overwritten, so a dump always holds the most recent history.
+
+constexpr uint8_t TRACE_VERSION = 4;
+constexpr uint8_t TRACE_TAG_SAMPLE = 0x80;
+constexpr uint8_t TRACE_TAG_REPORT = 0x81;
+constexpr size_t TRACE_BLOCK_HEADER = 7;
+
+static_assert(TRACE_BLOCK_SIZE > TRACE_BLOCK_HEADER + 16 && TRACE_BLOCK_SIZE - TRACE_BLOCK_HEADER <= 255,
+              "TRACE_BLOCK_SIZE must fit a few records and an 8-bit fill level");
+
+enum TraceStream : uint8_t
+{
+    TRACE_STREAM_SAMPLES = 0,
+    TRACE_STREAM_REPORTS = 1
+};
+
+// Start of a dump, followed by one section per stream
+struct __attribute__((packed)) TraceDumpHeader
+{
+    char magic[4]; // "SWTR"
+    uint8_t version;
+    uint8_t streams;
+    uint16_t samplePeriod; // Nominal sample period in us
+    uint16_t blockSize;
+    uint8_t multiplier;  // Wheel multiplier at dump time
+    ScrollConfig config; // Tuning at dump time
+};
+
+// Start of a stream section, followed by blocks oldest first
+struct __attribute__((packed)) TraceStreamHeader
+{
+    uint8_t stream;
+    uint16_t blocks;
+};
+
+typedef void (*TraceWriter)(const uint8_t *data, size_t length, void *context);
+
+void writeTraceHeader(TraceWriter writer, void *context, uint8_t streams, uint8_t multiplier, const ScrollConfig &config);
+
+// Written by exactly one task, read only while stopped
+class TraceBuffer
+{
+public:
+    TraceBuffer(uint8_t stream);
+
+    void start();
+    void stop();
+    bool isRunning() const { return _running.load(std::memory_order_relaxed); }
+
+    void addSample(uint32_t timestamp, int16_t angle, int32_t value);
+    void addReport(uint32_t timestamp, int32_t value);
+
+    // Writes the stream header and all blocks, the trace must be stopped
+    void dump(TraceWriter writer, void *context) const;
+
+private:
+    bool reserve(uint32_t timestamp, size_t length);
+    void put(uint8_t value) { _blocks[_block][_fill++] = value; }
+    void putVarint(uint32_t value);
+    void putSigned(int32_t value) { putVarint(((uint32_t)value << 1) ^ (uint32_t)(value >> 31)); }
+
+    uint8_t _blocks[TRACE_BLOCKS][TRACE_BLOCK_SIZE];
+    uint8_t _stream;
+    uint16_t _block;     // Block being written
+    uint16_t _used;      // Blocks holding data
+    uint16_t _fill;      // Write position in the current block
+    int16_t _runTag;     // Position of an open resting run in the current block, -1 if none
+    uint32_t _time;      // Timestamp as the decoder will reconstruct it
+    int16_t _angle;
+    std::atomic<bool> _running;
+    std::atomic<bool> _writing;
+};
+
+struct TraceEvent
+{
+    uint8_t stream;
+    uint32_t timestamp;
+    int16_t angle; // Sample stream only
+    int32_t value; // Scroll units produced or sent
+};
+
+// Parses a dump in place without allocating
+class TraceDecoder
+{
+public:
+    TraceDecoder(const uint8_t *data, size_t length);
+
+    bool readHeader(TraceDumpHeader &header);
+    bool next(TraceEvent &event);
+
+private:
+    bool readVarint(uint32_t &value);
+    bool readSigned(int32_t &value);
+    bool startBlock();
+
+    const uint8_t *_data;
+    size_t _length;
+    size_t _position;
+    size_t _blockEnd;
+    uint16_t _samplePeriod;
+    uint16_t _blockSize;
+    uint8_t _streamsLeft;
+    uint8_t _stream;
+    uint16_t _blocksLeft;
+    uint8_t _runLeft;
+    uint32_t _time;
+    int16_t _angle;
+};
+
+#endif
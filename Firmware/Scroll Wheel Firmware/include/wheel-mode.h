@@ -0,0 +1,57 @@
+#ifndef WHEEL_MODE_H
+#define WHEEL_MODE_H
+
+#include <stdint.h>
+
+#include "config.h"
+
+// What the wheel drives. The scroll mode is the mouse wheel pipeline, the
+// others go out on the Consumer Control report and are switched in the
+// config, so a change takes effect with the next sample and no reconnect.
+// The firmware only has that report when built with HID_CONSUMER.
+enum WheelMode : uint8_t
+{
+    WHEEL_MODE_SCROLL = 0, // Mouse wheel
+    WHEEL_MODE_JOG,        // One AC Pan unit per angular step
+    WHEEL_MODE_SHUTTLE,    // AC Pan at a speed set by the angle from where the mode started
+    WHEEL_MODE_KEYS,       // One consumer key tap per angular step, volume up and down by default
+    WHEEL_MODE_COUNT
+};
+
+// Turns accepted encoder counts into jog steps, key steps or shuttle pan.
+// Steps work like detents on a fixed grid of modeSteps per turn: the position
+// is kept in units of 1/modeSteps count, so the grid never drifts, and snaps
+// to the nearest step once it is a quarter step past the midpoint. Turning
+// back therefore steps after half a step, then every full step again.
+// Shuttle clamps at SHUTTLE_LEVELS steps either way of the stop position and
+// sends its level as pan once every SHUTTLE_INTERVAL.
+class WheelModeEngine
+{
+public:
+    WheelModeEngine();
+
+    void reset();
+    void setSampleRate(uint32_t rate);
+
+    // Feeds the counts the noise band let through in one sample (0 without
+    // motion), returns steps or shuttle pan for the consumer report
+    int32_t update(int32_t counts, const ScrollConfig &config);
+
+    uint8_t getMode() const { return _mode; }
+    int32_t getShuttleLevel() const { return _mode == WHEEL_MODE_SHUTTLE ? _level : 0; }
+
+    // Shuttle away from the stop position keeps sending like a turning wheel
+    bool isActive() const { return _mode == WHEEL_MODE_SHUTTLE && getShuttleLevel() != 0; }
+
+private:
+    int32_t advance(int32_t counts);
+
+    uint8_t _mode;
+    uint16_t _steps;          // Steps per turn of the config the state was built with
+    int32_t _offset;          // Position from the current step, 1/_steps counts, a step is ENCODER_COUNTS of them
+    int32_t _level;           // Steps from where the mode started
+    uint32_t _interval;       // Samples between shuttle reports
+    uint32_t _shuttleSamples; // Samples since the last shuttle report
+};
+
+#endif
@@ -1,6 +1,9 @@
+#include <esp_timer.h>
+
 #include "BleConnectionStatus.h"
+#include "BleMouse.h"
 
-BleConnectionStatus::BleConnectionStatus(void) {
+BleConnectionStatus::BleConnectionStatus(void) : inputMouse(NULL), inputConsumer(NULL), connParams(NULL), mouse(NULL) {
 }
 
 void BleConnectionStatus::onConnect(BLEServer* pServer)
@@ -8,6 +11,17 @@ void BleConnectionStatus::onConnect(BLEServer* pServer)
   this->connected = true;
   BLE2902* desc = (BLE2902*)this->inputMouse->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
   desc->setNotifications(true);
+  if (this->inputConsumer != NULL)
+  {
+    desc = (BLE2902*)this->inputConsumer->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
+    desc->setNotifications(true);
+  }
+}
+
+void BleConnectionStatus::onConnect(BLEServer* pServer, esp_ble_gatts_cb_param_t* param)
+{
+  memcpy(this->remoteAddress, param->connect.remote_bda, sizeof(esp_bd_addr_t));
+  this->connParams->onConnect(esp_timer_get_time() / 1000);
 }
 
 void BleConnectionStatus::onDisconnect(BLEServer* pServer)
@@ -15,5 +29,12 @@ void BleConnectionStatus::onDisconnect(BLEServer* pServer)
   this->connected = false;
   BLE2902* desc = (BLE2902*)this->inputMouse->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
   desc->setNotifications(false);
-  esp_restart();
+  if (this->inputConsumer != NULL)
+  {
+    desc = (BLE2902*)this->inputConsumer->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
+    desc->setNotifications(false);
+  }
+  this->connParams->onDisconnect();
+  // Bonds stay in NVS, advertising again is enough for the host to come back
+  this->mouse->onDisconnected();
 }
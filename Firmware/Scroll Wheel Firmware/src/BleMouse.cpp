@@ -6,10 +6,15 @@
 #include "HIDTypes.h"
 #include "HIDKeyboardTypes.h"
 #include <driver/adc.h>
+#include <esp_gap_ble_api.h>
+#include <esp_timer.h>
+#include <vector>
 #include "sdkconfig.h"
 
 #include "BleConnectionStatus.h"
 #include "BleMouse.h"
+#include "boot-sequence.h"
+#include "defaults.h"
 
 #if defined(CONFIG_ARDUHAL_ESP_LOG)
   #include "esp32-hal-log.h"
@@ -19,75 +24,143 @@
   static const char* LOG_TAG = "BLEDevice";
 #endif
 
-static const uint8_t _hidReportDescriptor[] = {
-  USAGE_PAGE(1),       0x01, // USAGE_PAGE (Generic Desktop)
-  USAGE(1),            0x02, // USAGE (Mouse)
-  COLLECTION(1),       0x01, // COLLECTION (Application)
-  USAGE_PAGE(1),       0x01, //   USAGE_PAGE (Generic Desktop)
-  USAGE(1),            0x02, //   USAGE (Mouse)
-  COLLECTION(1),       0x02, //   COLLECTION (Logical)
-  REPORT_ID(1),        0x01, //     REPORT_ID (1)
-  USAGE(1),            0x01, //     USAGE (Pointer)
-  COLLECTION(1),       0x00, //     COLLECTION (Physical)
-  // ------------------------------------------------- Buttons (Left, Right, Middle, Back, Forward)
-  USAGE_PAGE(1),       0x09, //     USAGE_PAGE (Button)
-  USAGE_MINIMUM(1),    0x01, //     USAGE_MINIMUM (Button 1)
-  USAGE_MAXIMUM(1),    0x05, //     USAGE_MAXIMUM (Button 5)
-  LOGICAL_MINIMUM(1),  0x00, //     LOGICAL_MINIMUM (0)
-  LOGICAL_MAXIMUM(1),  0x01, //     LOGICAL_MAXIMUM (1)
-  REPORT_SIZE(1),      0x01, //     REPORT_SIZE (1)
-  REPORT_COUNT(1),     0x05, //     REPORT_COUNT (5)
-  HIDINPUT(1),         0x02, //     INPUT (Data, Variable, Absolute) ;5 button bits
-  // ------------------------------------------------- Padding
-  REPORT_SIZE(1),      0x03, //     REPORT_SIZE (3)
-  REPORT_COUNT(1),     0x01, //     REPORT_COUNT (1)
-  HIDINPUT(1),         0x03, //     INPUT (Constant, Variable, Absolute) ;3 bit padding
-  // ------------------------------------------------- X/Y position
-  USAGE_PAGE(1),       0x01, //       USAGE_PAGE (Generic Desktop)
-  USAGE(1),            0x30, //       USAGE (X)
-  USAGE(1),            0x31, //       USAGE (Y)
-  LOGICAL_MINIMUM(1),  0x81, //       LOGICAL_MINIMUM (-127)
-  LOGICAL_MAXIMUM(1),  0x7f, //       LOGICAL_MAXIMUM (127)
-  REPORT_SIZE(1),      0x08, //       REPORT_SIZE (8)
-  REPORT_COUNT(1),     0x02, //       REPORT_COUNT (2)
-  HIDINPUT(1),         0x06, //       INPUT (Data, Variable, Relative) ;3 bytes (X,Y,Wheel)
-  // --------------------------------------------------- Wheel
-  USAGE(1),            0x38, //       USAGE (Wheel)
-  PHYSICAL_MINIMUM(1), 0x00, //       PHYSICAL_MINIMUM (0)
-  PHYSICAL_MAXIMUM(1), 0x00, //       PHYSICAL_MAXIMUM (0)
-  LOGICAL_MINIMUM(1),  0x81, //       LOGICAL_MINIMUM (-127)
-  LOGICAL_MAXIMUM(1),  0x7f, //       LOGICAL_MAXIMUM (127)
-  REPORT_SIZE(1),      0x08, //       REPORT_SIZE (8)
-  REPORT_COUNT(1),     0x01, //       REPORT_COUNT (1)
-  HIDINPUT(1),         0x06, //       INPUT (Data, Variable, Relative)
-  // ------------------------------------------------- Resolution Multiplier
-  USAGE_PAGE(1),       0x01, //       Generic Desktop
-  USAGE(1),            0x48, //       Usage: Resolution Multiplier
-  LOGICAL_MINIMUM(1),  0x00, //       Logical Min = 0
-  LOGICAL_MAXIMUM(1),  0x01, //       Logical Max = 1
-  PHYSICAL_MINIMUM(1), 0x01, //       Physical Min = 1
-  PHYSICAL_MAXIMUM(1), 0x80, //       Physical Max = 128
-  REPORT_SIZE(1),      0x08, //       REPORT_SIZE (8)
-  REPORT_COUNT(1),     0x01, //       REPORT_COUNT (1)
-  FEATURE(1),          0x02, //       Feature (Data,Var,Abs)
-  END_COLLECTION(0),         //     END_COLLECTION (Physical)
-  END_COLLECTION(0),         //   END_COLLECTION (Logical)
-  END_COLLECTION(0),         // END_COLLECTION (Application)
+#if HID_CONSUMER
+static constexpr HidDescriptor _hidReportDescriptor = makeCompositeDescriptor(WheelReport::layout, CONSUMER_REPORT_ID);
+static_assert(WheelReport::layout.reportId != CONSUMER_REPORT_ID, "Mouse and consumer reports need their own IDs");
+static constexpr uint16_t PNP_VERSION = 0x0211; // A new version makes hosts read the report map again
+#else
+static constexpr HidDescriptor _hidReportDescriptor = makeMouseDescriptor(WheelReport::layout);
+static constexpr uint16_t PNP_VERSION = 0x0210;
+#endif
+static_assert(HID_RESOLUTION_MULTIPLIER == WHEEL_HIRES_MULTIPLIER, "Descriptor and firmware disagree on the hi-res multiplier");
+
+class FeatureResolutionCallbacks : public BLECharacteristicCallbacks
+{
+public:
+  FeatureResolutionCallbacks(BleMouse* mouse) : mouse(mouse) {}
+
+  // Host writes 1 to enable hi-res wheel reports and 0 to fall back to notches
+  void onWrite(BLECharacteristic* pCharacteristic)
+  {
+    if (pCharacteristic->getLength() < 1)
+      return;
+    uint8_t value = pCharacteristic->getData()[0];
+    mouse->wheelMultiplier = (value & 0x01) ? WHEEL_HIRES_MULTIPLIER : 1;
+  }
+
+private:
+  BleMouse* mouse;
 };
 
+static BleMouse* gapMouse = NULL; // Instance the GAP handler reports to
+
+static uint32_t uptimeMs()
+{
+  return esp_timer_get_time() / 1000;
+}
+
+static void gapHandler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t* param)
+{
+  if (gapMouse == NULL)
+    return;
+
+  switch (event)
+  {
+  case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+    gapMouse->onConnParamsUpdated(param->update_conn_params.status == ESP_BT_STATUS_SUCCESS,
+                                  param->update_conn_params.conn_int,
+                                  param->update_conn_params.latency,
+                                  param->update_conn_params.timeout);
+    break;
+  case ESP_GAP_BLE_AUTH_CMPL_EVT:
+    if (param->ble_security.auth_cmpl.success)
+      gapMouse->onBonded(param->ble_security.auth_cmpl.bd_addr, param->ble_security.auth_cmpl.addr_type);
+    break;
+  case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
+    gapMouse->onAdvertisingStarted(param->adv_start_cmpl.status == ESP_BT_STATUS_SUCCESS);
+    break;
+  default:
+    break;
+  }
+}
+
+void BleMouse::gattsHandler(esp_gatts_cb_event_t event, esp_gatt_if_t gattsIf, esp_ble_gatts_cb_param_t* param)
+{
+  BleMouse* mouse = gapMouse;
+  if (mouse == NULL)
+    return;
+
+  switch (event)
+  {
+  case ESP_GATTS_CONNECT_EVT:
+  {
+    uint32_t now = uptimeMs();
+    bootTimeline.mark(BOOT_CONNECTED, now);
+    // Timed to the link, the first report may come much later when the wheel rests
+    if (mouse->awaitingReconnect)
+    {
+      mouse->awaitingReconnect = false;
+      mouse->reconnectTime = now - mouse->disconnectTime;
+      if (mouse->reconnectTime > mouse->maxReconnectTime)
+        mouse->maxReconnectTime = mouse->reconnectTime;
+      mouse->reconnects++;
+    }
+    mouse->notifyCredits = NOTIFY_CREDITS;
+    mouse->congested = false;
+    mouse->reconnectDirected = mouse->directedAdvertising;
+    mouse->directedAdvertising = false;
+    mouse->advertisingFailures = 0;
+    break;
+  }
+  case ESP_GATTS_CONGEST_EVT:
+    mouse->congested = param->congest.congested;
+    break;
+  case ESP_GATTS_CONF_EVT:
+    // Sent for notifications as well once the stack is done with the packet
+    if (((mouse->inputMouse != NULL && param->conf.handle == mouse->inputMouse->getHandle())
+         || (mouse->inputConsumer != NULL && param->conf.handle == mouse->inputConsumer->getHandle()))
+        && mouse->notifyCredits < NOTIFY_CREDITS)
+      mouse->notifyCredits++;
+    break;
+  default:
+    break;
+  }
+}
+
 BleMouse::BleMouse(std::string deviceName, std::string deviceManufacturer, uint8_t batteryLevel) : 
     _buttons(0),
-    hid(0)
+    hid(0),
+    inputMouse(0),
+    inputConsumer(0),
+    connParams(*this),
+    notifyCredits(NOTIFY_CREDITS),
+    congested(false),
+    lastNotify(0),
+    server(0),
+    hasBondedAddress(false),
+    directedAdvertising(false),
+    directedStart(0),
+    advertisingFailed(false),
+    advertisingFailures(0),
+    disconnectTime(0),
+    awaitingReconnect(false),
+    reconnectDirected(false),
+    reconnects(0),
+    reconnectTime(0),
+    maxReconnectTime(0),
+    setupStackFree(0),
+    wheelMultiplier(1)
 {
   this->deviceName = deviceName;
   this->deviceManufacturer = deviceManufacturer;
   this->batteryLevel = batteryLevel;
-  this->connectionStatus = new BleConnectionStatus();
+  this->connectionStatus.connParams = &this->connParams;
+  this->connectionStatus.mouse = this;
 }
 
 void BleMouse::begin(void)
 {
-  xTaskCreate(this->taskServer, "server", 20000, (void *)this, 5, NULL);
+  xTaskCreatePinnedToCore(this->taskServer, "server", BLE_SETUP_TASK_STACK, (void *)this, 5, NULL, BLE_SETUP_TASK_CORE);
 }
 
 void BleMouse::end(void)
@@ -103,12 +176,32 @@ void BleMouse::click(uint8_t b)
 }
 
 void BleMouse::move(signed char x, signed char y, signed char wheel, signed char hWheel)
+{
+  report(x, y, wheel, hWheel);
+}
+
+void BleMouse::report(int8_t x, int8_t y, int16_t wheel, int16_t pan)
 {
   if (this->isConnected())
   {
-    uint8_t m[] = {_buttons,x,y,wheel};
-    this->inputMouse->setValue(m, sizeof(m));
+    WheelReport m;
+    m.set(_buttons, x, y, wheel, pan);
+    this->inputMouse->setValue((uint8_t*)&m, sizeof(m));
     this->inputMouse->notify();
+    this->connParams.onMotion(uptimeMs());
+  }
+}
+
+void BleMouse::reportConsumer(uint16_t usage, int16_t pan)
+{
+  if (this->inputConsumer != NULL && this->isConnected())
+  {
+    ConsumerReport c;
+    c.usage = usage;
+    c.pan = pan;
+    this->inputConsumer->setValue((uint8_t*)&c, sizeof(c));
+    this->inputConsumer->notify();
+    this->connParams.onMotion(uptimeMs());
   }
 }
 
@@ -138,8 +231,200 @@ bool BleMouse::isPressed(uint8_t b)
   return false;
 }
 
+uint8_t BleMouse::getWheelMultiplier(void) {
+  return this->wheelMultiplier;
+}
+
+bool BleMouse::canSend(void) {
+  if (!this->isConnected() || this->congested)
+    return false;
+
+  if (this->notifyCredits <= 0)
+  {
+    if (uptimeMs() - this->lastNotify < NOTIFY_CREDIT_TIMEOUT)
+      return false;
+    this->notifyCredits = NOTIFY_CREDITS;
+  }
+  return true;
+}
+
+void BleMouse::sendWheel(int16_t wheel) {
+  onReportSent();
+  report(0, 0, wheel, 0);
+}
+
+void BleMouse::sendPan(int16_t pan) {
+  onReportSent();
+  reportConsumer(0, pan);
+}
+
+void BleMouse::tapConsumer(uint16_t usage) {
+  // The release may run the credits one below zero, canSend() waits for it to come back
+  onReportSent();
+  reportConsumer(usage, 0);
+  this->notifyCredits--;
+  reportConsumer(0, 0);
+}
+
+void BleMouse::onReportSent(void) {
+  this->notifyCredits--;
+  this->lastNotify = uptimeMs();
+  bootTimeline.mark(BOOT_FIRST_REPORT, this->lastNotify);
+}
+
+bool BleMouse::requestConnParams(const ConnParams &params) {
+  if (!this->isConnected())
+    return false;
+
+  esp_ble_conn_update_params_t conn = {};
+  memcpy(conn.bda, this->connectionStatus.remoteAddress, sizeof(esp_bd_addr_t));
+  conn.min_int = params.minInterval;
+  conn.max_int = params.maxInterval;
+  conn.latency = params.latency;
+  conn.timeout = params.timeout;
+  return esp_ble_gap_update_conn_params(&conn) == ESP_OK;
+}
+
+void BleMouse::updateLink(void) {
+  uint32_t now = uptimeMs();
+  this->connParams.update(now);
+
+  if (this->isConnected())
+    return;
+
+  if (this->advertisingFailed)
+  {
+    this->advertisingFailed = false;
+    if (++this->advertisingFailures >= RECONNECT_MAX_FAILURES)
+    {
+      ESP_LOGE(LOG_TAG, "Advertising does not start, rebooting");
+      esp_restart();
+    }
+    startAdvertising(false);
+  }
+  else if (this->directedAdvertising && now - this->directedStart >= RECONNECT_DIRECTED_TIME)
+  {
+    // The controller stops high duty directed advertising on its own, make sure and open up to any host
+    this->directedAdvertising = false;
+    esp_ble_gap_stop_advertising();
+    startAdvertising(false);
+  }
+}
+
+void BleMouse::onConnParamsUpdated(bool accepted, uint16_t interval, uint16_t latency, uint16_t timeout) {
+  this->connParams.onParamsUpdated(accepted, interval, latency, timeout);
+}
+
+// The address a host is reached at after its private address has changed: the
+// identity address it sent while bonding, or the bond address of the given type without one
+static void identityAddress(const esp_ble_bond_dev_t &bond, esp_bd_addr_t address, esp_ble_addr_type_t &addressType,
+                            esp_ble_addr_type_t bondAddressType)
+{
+  if (bond.bond_key.key_mask & ESP_BLE_ID_KEY_MASK)
+  {
+    memcpy(address, bond.bond_key.pid_key.static_addr, sizeof(esp_bd_addr_t));
+    addressType = bond.bond_key.pid_key.addr_type;
+    return;
+  }
+  memcpy(address, bond.bd_addr, sizeof(esp_bd_addr_t));
+  addressType = bondAddressType;
+}
+
+void BleMouse::onBonded(const esp_bd_addr_t address, esp_ble_addr_type_t addressType) {
+  // auth_cmpl carries the address of this connection, which may be a resolvable
+  // private address that is gone by the next reconnect. Look up the bond instead.
+  int count = esp_ble_get_bond_device_num();
+  if (count <= 0)
+    return;
+  std::vector<esp_ble_bond_dev_t> bonds(count);
+  if (esp_ble_get_bond_device_list(&count, bonds.data()) != ESP_OK)
+    return;
+
+  for (int i = 0; i < count; i++)
+  {
+    const esp_ble_bond_dev_t &bond = bonds[i];
+    if (memcmp(bond.bd_addr, address, sizeof(esp_bd_addr_t)) == 0
+        || ((bond.bond_key.key_mask & ESP_BLE_ID_KEY_MASK) && memcmp(bond.bond_key.pid_key.static_addr, address, sizeof(esp_bd_addr_t)) == 0))
+    {
+      identityAddress(bond, this->bondedAddress, this->bondedAddressType, addressType);
+      this->hasBondedAddress = true;
+      return;
+    }
+  }
+
+  // Not in the list, only a public or static random address is worth keeping
+  bool resolvable = addressType == BLE_ADDR_TYPE_RANDOM && (address[0] & 0xC0) == 0x40;
+  if (resolvable)
+    return;
+  memcpy(this->bondedAddress, address, sizeof(esp_bd_addr_t));
+  this->bondedAddressType = addressType;
+  this->hasBondedAddress = true;
+}
+
+void BleMouse::onAdvertisingStarted(bool success) {
+  if (success)
+  {
+    bootTimeline.mark(BOOT_ADVERTISING, uptimeMs());
+    if (!this->directedAdvertising)
+      this->advertisingFailures = 0;
+    return;
+  }
+  // A failed directed start falls back to undirected advertising without counting against the reboot limit
+  if (this->directedAdvertising)
+  {
+    this->directedAdvertising = false;
+    this->directedStart = 0;
+  }
+  this->advertisingFailed = true;
+}
+
+void BleMouse::onDisconnected(void) {
+  this->disconnectTime = uptimeMs();
+  this->awaitingReconnect = true;
+  this->notifyCredits = NOTIFY_CREDITS;
+  this->congested = false;
+  startAdvertising(true);
+}
+
+// After a cold boot the first stored bond stands in for the last host
+bool BleMouse::findBondedHost(void) {
+  if (this->hasBondedAddress)
+    return true;
+
+  int count = 1;
+  esp_ble_bond_dev_t bond;
+  if (esp_ble_get_bond_device_num() <= 0 || esp_ble_get_bond_device_list(&count, &bond) != ESP_OK || count < 1)
+    return false;
+
+  identityAddress(bond, this->bondedAddress, this->bondedAddressType, BLE_ADDR_TYPE_PUBLIC);
+  this->hasBondedAddress = true;
+  return true;
+}
+
+void BleMouse::startAdvertising(bool directed) {
+  if (directed && findBondedHost())
+  {
+    esp_ble_adv_params_t params = {};
+    params.adv_int_min = 0x20; // Ignored for high duty cycle, the controller advertises every 3.75 ms or faster
+    params.adv_int_max = 0x20;
+    params.adv_type = ADV_TYPE_DIRECT_IND_HIGH;
+    params.own_addr_type = BLE_ADDR_TYPE_PUBLIC;
+    memcpy(params.peer_addr, this->bondedAddress, sizeof(esp_bd_addr_t));
+    params.peer_addr_type = this->bondedAddressType;
+    params.channel_map = ADV_CHNL_ALL;
+    params.adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY;
+
+    this->directedStart = uptimeMs();
+    this->directedAdvertising = true;
+    if (esp_ble_gap_start_advertising(&params) == ESP_OK)
+      return;
+    this->directedAdvertising = false;
+  }
+  this->server->getAdvertising()->start();
+}
+
 bool BleMouse::isConnected(void) {
-  return this->connectionStatus->connected;
+  return this->connectionStatus.connected;
 }
 
 void BleMouse::setBatteryLevel(uint8_t level) {
@@ -151,35 +436,49 @@ void BleMouse::setBatteryLevel(uint8_t level) {
 void BleMouse::taskServer(void* pvParameter) {
   BleMouse* bleMouseInstance = (BleMouse *) pvParameter; //static_cast<BleMouse *>(pvParameter);
   BLEDevice::init(bleMouseInstance->deviceName);
+  gapMouse = bleMouseInstance;
+  BLEDevice::setCustomGapHandler(gapHandler);
+  BLEDevice::setCustomGattsHandler(gattsHandler);
   BLEServer *pServer = BLEDevice::createServer();
-  pServer->setCallbacks(bleMouseInstance->connectionStatus);
+  bleMouseInstance->server = pServer;
+  pServer->setCallbacks(&bleMouseInstance->connectionStatus);
 
   bleMouseInstance->hid = new BLEHIDDevice(pServer);
-  bleMouseInstance->inputMouse = bleMouseInstance->hid->inputReport(0x01); // <-- input REPORTID from report map
-  bleMouseInstance->featureResolution = bleMouseInstance->hid->featureReport(0x01); // <-- feature REPORTID for resolution multiplier  
-  bleMouseInstance->featureResolution->setValue(new uint8_t{0x80}, 1);
-  bleMouseInstance->connectionStatus->inputMouse = bleMouseInstance->inputMouse;
+  bleMouseInstance->inputMouse = bleMouseInstance->hid->inputReport(WheelReport::layout.reportId); // <-- input REPORTID from report map
+  bleMouseInstance->featureResolution = bleMouseInstance->hid->featureReport(WheelReport::layout.reportId); // <-- feature REPORTID for resolution multiplier
+  uint8_t resolution = 0x00; // Hosts enable hi-res by writing 1
+  bleMouseInstance->featureResolution->setValue(&resolution, 1);
+  static FeatureResolutionCallbacks featureCallbacks(bleMouseInstance);
+  bleMouseInstance->featureResolution->setCallbacks(&featureCallbacks);
+#if HID_CONSUMER
+  bleMouseInstance->inputConsumer = bleMouseInstance->hid->inputReport(CONSUMER_REPORT_ID);
+#endif
+  bleMouseInstance->connectionStatus.inputMouse = bleMouseInstance->inputMouse;
+  bleMouseInstance->connectionStatus.inputConsumer = bleMouseInstance->inputConsumer;
 
   bleMouseInstance->hid->manufacturer()->setValue(bleMouseInstance->deviceManufacturer);
 
-  bleMouseInstance->hid->pnp(0x02, 0xe502, 0xa111, 0x0210);
+  bleMouseInstance->hid->pnp(0x02, 0xe502, 0xa111, PNP_VERSION);
   bleMouseInstance->hid->hidInfo(0x00,0x02);
 
-  BLESecurity *pSecurity = new BLESecurity();
+  static BLESecurity security;
+  security.setAuthenticationMode(ESP_LE_AUTH_BOND);
 
-  pSecurity->setAuthenticationMode(ESP_LE_AUTH_BOND);
-
-  bleMouseInstance->hid->reportMap((uint8_t*)_hidReportDescriptor, sizeof(_hidReportDescriptor));
+  bleMouseInstance->hid->reportMap((uint8_t*)_hidReportDescriptor.data, _hidReportDescriptor.length);
   bleMouseInstance->hid->startServices();
 
   bleMouseInstance->onStarted(pServer);
+  bootTimeline.mark(BOOT_BLE_READY, uptimeMs());
 
   BLEAdvertising *pAdvertising = pServer->getAdvertising();
   pAdvertising->setAppearance(HID_MOUSE);
   pAdvertising->addServiceUUID(bleMouseInstance->hid->hidService()->getUUID());
-  pAdvertising->start();
+  bleMouseInstance->startAdvertising(true);
   bleMouseInstance->hid->setBatteryLevel(bleMouseInstance->batteryLevel);
 
   ESP_LOGD(LOG_TAG, "Advertising started!");
-  vTaskDelay(portMAX_DELAY); //delay(portMAX_DELAY);
+
+  // Everything after setup runs in the Bluedroid tasks, hand the stack back to the heap
+  bleMouseInstance->setupStackFree = uxTaskGetStackHighWaterMark(NULL);
+  vTaskDelete(NULL);
 }
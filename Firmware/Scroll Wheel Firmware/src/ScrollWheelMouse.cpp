@@ -0,0 +1,70 @@
+#include <Arduino.h>
+#include <BLE2902.h>
+#include <BLEServer.h>
+
+#include "ScrollWheelMouse.h"
+#include "config-service.h"
+#include "stats.h"
+#include "telemetry-service.h"
+
+class ConfigCallbacks : public BLECharacteristicCallbacks
+{
+  void onRead(BLECharacteristic *pCharacteristic)
+  {
+    ScrollConfig config = getConfig();
+    pCharacteristic->setValue((uint8_t *)&config, sizeof(config));
+  }
+
+  // Complete configs of this or an older layout are taken, anything invalid is dropped
+  void onWrite(BLECharacteristic *pCharacteristic)
+  {
+    ScrollConfig config;
+    if (!migrateConfig(pCharacteristic->getData(), pCharacteristic->getLength(), config))
+      return;
+    updateConfig(config);
+  }
+};
+
+#ifdef SCROLL_STATS
+class StatsCallbacks : public BLECharacteristicCallbacks
+{
+  // Fill in a fresh snapshot on every read
+  void onRead(BLECharacteristic *pCharacteristic)
+  {
+    StatsSnapshot snapshot;
+    getStats(snapshot);
+    pCharacteristic->setValue((uint8_t *)&snapshot, sizeof(snapshot));
+  }
+};
+#endif
+
+// Attribute handles: the service, declaration and value per characteristic, the telemetry CCCD
+#ifdef SCROLL_STATS
+static const uint32_t VENDOR_HANDLES = 1 + 2 + 2 + 1 + 2;
+#else
+static const uint32_t VENDOR_HANDLES = 1 + 2 + 2 + 1;
+#endif
+
+void ScrollWheelMouse::onStarted(BLEServer *pServer)
+{
+  // Config and telemetry are always there, the stats characteristic only with SCROLL_STATS
+  BLEService *service = pServer->createService(BLEUUID(VENDOR_SERVICE_UUID), VENDOR_HANDLES);
+
+  static ConfigCallbacks configCallbacks;
+  BLECharacteristic *config = service->createCharacteristic(VENDOR_CONFIG_UUID,
+                                                            BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_WRITE);
+  config->setCallbacks(&configCallbacks);
+
+  static BLE2902 telemetryDescriptor;
+  BLECharacteristic *telemetry = service->createCharacteristic(VENDOR_TELEMETRY_UUID, BLECharacteristic::PROPERTY_NOTIFY);
+  telemetry->addDescriptor(&telemetryDescriptor);
+  startTelemetry(pServer, telemetry);
+
+#ifdef SCROLL_STATS
+  static StatsCallbacks statsCallbacks;
+  BLECharacteristic *stats = service->createCharacteristic(VENDOR_STATS_UUID, BLECharacteristic::PROPERTY_READ);
+  stats->setCallbacks(&statsCallbacks);
+#endif
+
+  service->start();
+}
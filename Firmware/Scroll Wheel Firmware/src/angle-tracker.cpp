@@ -0,0 +1,61 @@
+#include <stdlib.h>
+
+#include "angle-tracker.h"
+#include "defaults.h"
+
+constexpr int32_t MAX_VELOCITY = ENCODER_COUNTS / 2 - 1; // From half a turn per sample on, either direction fits
+
+AngleTracker::AngleTracker() : _sampleRate(SAMPLE_RATE_HZ), _unwrapped(0), _aliased(0)
+{
+    reset();
+}
+
+void AngleTracker::reset()
+{
+    _position = 0;
+    _velocity = 0;
+    _started = false;
+}
+
+void AngleTracker::setSampleRate(uint32_t rate)
+{
+    if (rate == 0 || rate == _sampleRate)
+    {
+        return;
+    }
+    _velocity = (int64_t)_velocity * _sampleRate / rate;
+    _sampleRate = rate;
+}
+
+int64_t AngleTracker::update(int16_t angle, int32_t maxRotation)
+{
+    if (!_started)
+    {
+        _started = true;
+        _position = angle;
+        return _position;
+    }
+
+    int64_t predicted = _position + _velocity;
+    int16_t innovation = wrapCounts(angle - (int16_t)(predicted & (ENCODER_COUNTS - 1)), maxRotation);
+    int64_t position = predicted + innovation;
+
+    // Far off the prediction: an outlier or a jolt the speed cannot explain. Unwrap
+    // around the last position instead, so a bad sample is undone by the next good
+    // one rather than taken as a speed that adds a turn every sample.
+    if (abs(innovation) > maxRotation / 2)
+    {
+        _aliased++;
+        position = _position + wrapCounts(angle - (int16_t)(_position & (ENCODER_COUNTS - 1)), maxRotation);
+    }
+    int64_t step = position - _position;
+    if (step > maxRotation || step < -maxRotation)
+    {
+        _unwrapped++;
+    }
+
+    // The last step is the speed estimate, smoothing it would only delay the catch-up after a flick
+    _velocity = step > MAX_VELOCITY ? MAX_VELOCITY : step < -MAX_VELOCITY ? -MAX_VELOCITY : (int32_t)step;
+    _position = position;
+    return _position;
+}
@@ -0,0 +1,80 @@
+#include <Arduino.h>
+
+#include "battery-task.h"
+#include "defaults.h"
+#include "globals.h"
+#include "sampler.h"
+
+static_assert(BATTERY_UPDATE_INTERVAL >= POWER_SENSE_INTERVAL, "Battery updates are counted in power sense rounds");
+
+BatteryMonitor batteryMonitor(batteryAdc);
+PowerSource powerSource;
+
+static bool tracesStarted = false; // Traces this task started for the USB profile
+
+static bool readUsbPresent()
+{
+    return digitalRead(POWER_SENSE_PIN) == HIGH;
+}
+
+static bool readChargeActive()
+{
+    return digitalRead(CHARGE_STATE_SENSE_PIN) == LOW; // BQ25172 STAT is pulled low while charging
+}
+
+// On USB nothing has to save power: no idle downshift or power off, the fast
+// connection interval and the traces running so a dump always has the history
+static void applyPowerProfile(PowerProfile profile)
+{
+    bool performance = POWER_USB_PROFILE && profile == POWER_PROFILE_USB;
+    powerManager.setHoldActive(performance);
+    bleMouse.setHoldFast(performance);
+
+    if (performance && !sampleTrace.isRunning())
+    {
+        sampleTrace.start();
+        reportTrace.start();
+        tracesStarted = true;
+    }
+    else if (!performance && tracesStarted)
+    {
+        sampleTrace.stop();
+        reportTrace.stop();
+        tracesStarted = false;
+    }
+}
+
+// Lowest priority task on the system, the sampler preempts it between any two ADC reads
+static void batteryLoop(void *pvParameter)
+{
+    powerSource.reset(millis(), readUsbPresent(), readChargeActive());
+    applyPowerProfile(powerSource.getProfile());
+
+    TickType_t lastWake = xTaskGetTickCount();
+    uint32_t senseRounds = 0;
+    while (1)
+    {
+        if (powerSource.update(millis(), readUsbPresent(), readChargeActive()))
+        {
+            applyPowerProfile(powerSource.getProfile());
+        }
+
+#if SENSOR_BACKEND != 3
+        if (senseRounds == 0 && batteryMonitor.update())
+        {
+            bleMouse.setBatteryLevel(batteryMonitor.getLevel());
+        }
+#endif
+        senseRounds = (senseRounds + 1) % (BATTERY_UPDATE_INTERVAL / POWER_SENSE_INTERVAL);
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(POWER_SENSE_INTERVAL));
+    }
+}
+
+void startBatteryTask()
+{
+#if SENSOR_BACKEND == 3
+    // The analog sensor backend holds ADC1 in DMA mode, one-shot reads would fail
+    Serial.println("Battery monitor disabled, ADC1 is used by the sensor");
+#endif
+    xTaskCreatePinnedToCore(batteryLoop, "battery", BATTERY_TASK_STACK, NULL, BATTERY_TASK_PRIORITY, NULL, REPORTER_TASK_CORE);
+}
@@ -1,22 +1,89 @@
-#include <Arduino.h>
-
+#include "battery.h"
 #include "defaults.h"
+#include "scroll-math.h"
+
+constexpr int BATTERY_CURVE_SIZE = 11;
+
+// Eneloop cell voltage in mV at 0, 10, ... 100 % under the light load of the wheel
+constexpr uint16_t NIMH_CELL_CURVE[BATTERY_CURVE_SIZE] = {
+    1000, 1150, 1200, 1225, 1240, 1252, 1265, 1280, 1300, 1330, 1380,
+};
+
+constexpr bool isRising(const uint16_t *curve, int size)
+{
+    for (int i = 1; i < size; i++)
+    {
+        if (curve[i] <= curve[i - 1])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(isRising(NIMH_CELL_CURVE, BATTERY_CURVE_SIZE), "Discharge curve must rise with the charge");
+
+uint8_t getBatteryLevel(uint32_t packMillivolts)
+{
+    uint32_t cell = packMillivolts / BATTERY_CELLS;
+    if (cell <= NIMH_CELL_CURVE[0])
+    {
+        return 0;
+    }
+    for (int i = 1; i < BATTERY_CURVE_SIZE; i++)
+    {
+        if (cell < NIMH_CELL_CURVE[i])
+        {
+            uint32_t low = NIMH_CELL_CURVE[i - 1];
+            uint32_t span = NIMH_CELL_CURVE[i] - low;
+            return (i - 1) * 10 + ((cell - low) * 10 + span / 2) / span;
+        }
+    }
+    return 100;
+}
 
-int getBatteryLevel()
+BatteryMonitor::BatteryMonitor(AdcInput &adc) : _adc(adc)
 {
-    // read raw value from ADC
-    int rawValue = analogRead(BATTERY_SENSE_PIN);
-    float voltage = rawValue * (3.3 / 4095.0) * BATTERY_VALUE_CORRECTION;
-
-    // Pcalculate battery percentage
-    int percentage = map(voltage * 100,
-                         BATTERY_MIN_VOLTAGE * 100,
-                         BATTERY_MAX_VOLTAGE * 100,
-                         0,
-                         100);
-
-    // limit percentage to 0-100
-    percentage = constrain(percentage, 0, 100);
-
-    return percentage;
-}
\ No newline at end of file
+    reset();
+}
+
+void BatteryMonitor::reset()
+{
+    _filtered = 0;
+    _hasReading = false;
+    _level = 100;
+}
+
+bool BatteryMonitor::update()
+{
+    uint32_t sum = 0;
+    for (int i = 0; i < BATTERY_OVERSAMPLE; i++)
+    {
+        sum += _adc.readMillivolts();
+    }
+    return addReading(sum * BATTERY_VALUE_CORRECTION / BATTERY_OVERSAMPLE);
+}
+
+bool BatteryMonitor::addReading(uint32_t packMillivolts)
+{
+    uint32_t reading = packMillivolts << BATTERY_FILTER_BITS;
+    if (!_hasReading)
+    {
+        // Start from the first reading instead of crawling up from zero
+        _filtered = reading;
+        _hasReading = true;
+        _level = getBatteryLevel(packMillivolts);
+        return true;
+    }
+
+    // Rounded both ways, a floored step would settle up to a mV below a rising voltage
+    _filtered += roundShift((int32_t)reading - (int32_t)_filtered, BATTERY_FILTER_SHIFT);
+
+    uint8_t level = getBatteryLevel(getMillivolts());
+    if (level < _level || level >= _level + BATTERY_HYSTERESIS)
+    {
+        _level = level;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,61 @@
+#include "boot-sequence.h"
+#include "defaults.h"
+
+BootTimeline bootTimeline;
+
+const char *const BOOT_PHASE_NAMES[BOOT_PHASE_COUNT] = {
+    "setup", "sensor", "sampling", "ble ready", "advertising", "connected", "first report",
+};
+
+BootTimeline::BootTimeline()
+{
+    reset();
+}
+
+void BootTimeline::reset()
+{
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++)
+    {
+        _marks[i].store(NOT_REACHED, std::memory_order_relaxed);
+    }
+}
+
+void BootTimeline::mark(BootPhase phase, uint32_t now)
+{
+    uint32_t expected = NOT_REACHED;
+    _marks[phase].compare_exchange_strong(expected, now, std::memory_order_relaxed);
+}
+
+SensorProbe::SensorProbe(AngleSensor &sensor, BootTimeline &timeline) : _sensor(sensor), _timeline(timeline)
+{
+    reset(0);
+}
+
+void SensorProbe::reset(uint32_t now)
+{
+    _state = WAITING;
+    _start = now;
+    _lastAttempt = 0;
+    _attempts = 0;
+}
+
+SensorProbe::State SensorProbe::poll(uint32_t now)
+{
+    if (_state != WAITING || (_attempts > 0 && now - _lastAttempt < SENSOR_RETRY_INTERVAL))
+    {
+        return _state;
+    }
+
+    _attempts++;
+    _lastAttempt = now;
+    if (_sensor.begin())
+    {
+        _state = READY;
+        _timeline.mark(BOOT_SENSOR, now);
+    }
+    else if (SENSOR_GIVE_UP_TIME != 0 && now - _start >= SENSOR_GIVE_UP_TIME)
+    {
+        _state = GAVE_UP;
+    }
+    return _state;
+}
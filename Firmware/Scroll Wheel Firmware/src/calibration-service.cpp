@@ -0,0 +1,100 @@
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include "calibration-service.h"
+
+enum CalibrationState : uint8_t
+{
+    CALIBRATION_IDLE,
+    CALIBRATION_RECORDING,
+    CALIBRATION_RECORDED // Sampler is done with the fitter, the loop may fit
+};
+
+static CalibrationFitter fitter;
+static volatile CalibrationState state = CALIBRATION_IDLE;
+
+static bool storeCalibration(const CalibrationTable &table)
+{
+    // The sampler lets go of the spare copy after at most one sample
+    while (!publishCalibration(table))
+    {
+        if (!isValidCalibration(table))
+        {
+            return false;
+        }
+        vTaskDelay(1);
+    }
+
+    Preferences preferences;
+    bool stored = preferences.begin("scroll", false) && preferences.putBytes("calibration", &table, sizeof(table)) == sizeof(table);
+    preferences.end();
+    return stored;
+}
+
+void loadCalibration()
+{
+    Preferences preferences;
+    if (preferences.begin("scroll", true))
+    {
+        CalibrationTable stored;
+        if (preferences.getBytes("calibration", &stored, sizeof(stored)) == sizeof(stored))
+        {
+            publishCalibration(stored); // Keeps the identity table if it is invalid
+        }
+        preferences.end();
+    }
+}
+
+void startCalibration()
+{
+    state = CALIBRATION_IDLE;
+    vTaskDelay(2); // Let a sample that already saw the old state finish
+    fitter.reset();
+    state = CALIBRATION_RECORDING;
+}
+
+void cancelCalibration()
+{
+    state = CALIBRATION_IDLE;
+}
+
+bool isCalibrating()
+{
+    return state != CALIBRATION_IDLE;
+}
+
+uint16_t getCalibrationRevolutions()
+{
+    return fitter.getRevolutions();
+}
+
+void addCalibrationSample(int16_t rawAngle)
+{
+    if (state != CALIBRATION_RECORDING)
+    {
+        return;
+    }
+    fitter.addSample(rawAngle);
+    if (fitter.getRevolutions() >= CALIBRATION_REVOLUTIONS)
+    {
+        state = CALIBRATION_RECORDED;
+    }
+}
+
+bool finishCalibration(bool &success)
+{
+    if (state != CALIBRATION_RECORDED)
+    {
+        return false;
+    }
+
+    CalibrationTable table;
+    success = fitter.fit(table) && storeCalibration(table);
+    state = CALIBRATION_IDLE;
+    return true;
+}
+
+bool clearCalibration()
+{
+    return storeCalibration(identityCalibration());
+}
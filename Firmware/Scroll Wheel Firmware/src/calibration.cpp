@@ -0,0 +1,231 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "calibration.h"
+#include "defaults.h"
+#include "double-buffer.h"
+
+constexpr int32_t MAX_OFFSET = (ENCODER_COUNTS / 8) << CALIBRATION_Q; // 45 degrees, far beyond any real mount
+constexpr uint32_t MIN_TURN_SAMPLES = CALIBRATION_POINTS * 4;         // Fewer and the bins get too coarse
+
+static_assert(MAX_OFFSET <= INT16_MAX, "Calibration offsets overflow");
+static_assert(CALIBRATION_REVOLUTIONS >= 2, "CALIBRATION_REVOLUTIONS must be at least 2, one per half");
+static_assert(CALIBRATION_HARMONICS > 0 && CALIBRATION_HARMONICS < CALIBRATION_POINTS / 2, "CALIBRATION_HARMONICS out of range");
+
+CalibrationTable identityCalibration()
+{
+    CalibrationTable table;
+    table.version = CALIBRATION_VERSION;
+    memset(table.offset, 0, sizeof(table.offset));
+    return table;
+}
+
+bool isValidCalibration(const CalibrationTable &table)
+{
+    if (table.version != CALIBRATION_VERSION)
+    {
+        return false;
+    }
+    for (int i = 0; i < CALIBRATION_POINTS; i++)
+    {
+        int32_t offset = table.offset[i];
+        int32_t next = table.offset[(i + 1) & (CALIBRATION_POINTS - 1)];
+        if (abs(offset) > MAX_OFFSET || (CALIBRATION_SPAN << CALIBRATION_Q) + next - offset <= 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static DoubleBuffer<CalibrationTable> calibrationBuffer(identityCalibration());
+
+const CalibrationTable &acquireCalibration()
+{
+    return calibrationBuffer.acquire();
+}
+
+void releaseCalibration()
+{
+    calibrationBuffer.release();
+}
+
+const CalibrationTable &getCalibration()
+{
+    return calibrationBuffer.current();
+}
+
+bool publishCalibration(const CalibrationTable &table)
+{
+    return isValidCalibration(table) && calibrationBuffer.publish(table);
+}
+
+CalibrationFitter::CalibrationFitter()
+{
+    reset();
+}
+
+void CalibrationFitter::reset()
+{
+    memset(_bins, 0, sizeof(_bins));
+    memset(_pending, 0, sizeof(_pending));
+    _pendingSamples = 0;
+    _lastSamples = 0;
+    _travel = 0;
+    _angleBefore = -1;
+    _revolutions = 0;
+    _rejected = 0;
+}
+
+void CalibrationFitter::addSample(int16_t rawAngle)
+{
+    if (_angleBefore < 0)
+    {
+        _angleBefore = rawAngle;
+        return;
+    }
+
+    _travel += wrapCounts(rawAngle - _angleBefore);
+    _angleBefore = rawAngle;
+
+    _pending[rawAngle >> CALIBRATION_SHIFT]++;
+    _pendingSamples++;
+
+    if (abs(_travel) >= ENCODER_COUNTS)
+    {
+        closeRevolution();
+        _travel += _travel > 0 ? -ENCODER_COUNTS : ENCODER_COUNTS;
+    }
+}
+
+void CalibrationFitter::closeRevolution()
+{
+    // The spin-up turn only sets the reference length, a turn more than the
+    // tolerance off the previous one was not at a steady speed
+    uint32_t deviation = _pendingSamples > _lastSamples ? _pendingSamples - _lastSamples : _lastSamples - _pendingSamples;
+    bool steady = _lastSamples > 0 && deviation * 100 <= _lastSamples * CALIBRATION_SPEED_TOLERANCE;
+
+    if (steady && _pendingSamples >= MIN_TURN_SAMPLES)
+    {
+        for (int i = 0; i < CALIBRATION_POINTS; i++)
+        {
+            _bins[_revolutions & 1][i] += _pending[i];
+        }
+        _revolutions++;
+    }
+    else if (_lastSamples > 0)
+    {
+        _rejected++;
+    }
+
+    _lastSamples = _pendingSamples;
+    _pendingSamples = 0;
+    memset(_pending, 0, sizeof(_pending));
+}
+
+// Real angle at each knot relative to knot 0 minus the raw angle, in Q4 counts.
+// Where a turn starts is arbitrary, the mean is removed.
+static void knotOffsets(const uint32_t *bins, float *offsets)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < CALIBRATION_POINTS; i++)
+    {
+        total += bins[i];
+    }
+
+    float mean = 0;
+    uint64_t cumulative = 0;
+    for (int i = 0; i < CALIBRATION_POINTS; i++)
+    {
+        offsets[i] = (float)cumulative * (ENCODER_COUNTS << CALIBRATION_Q) / total - ((i * CALIBRATION_SPAN) << CALIBRATION_Q);
+        mean += offsets[i] / CALIBRATION_POINTS;
+        cumulative += bins[i];
+    }
+    for (int i = 0; i < CALIBRATION_POINTS; i++)
+    {
+        offsets[i] -= mean;
+    }
+}
+
+// Least squares fit with harmonics 1 to CALIBRATION_HARMONICS, the knots are evenly spaced over a turn
+static void fitHarmonics(const float *offsets, float *model)
+{
+    for (int i = 0; i < CALIBRATION_POINTS; i++)
+    {
+        model[i] = 0;
+    }
+    for (int k = 1; k <= CALIBRATION_HARMONICS; k++)
+    {
+        float re = 0, im = 0;
+        for (int i = 0; i < CALIBRATION_POINTS; i++)
+        {
+            float phase = 2 * (float)M_PI * k * i / CALIBRATION_POINTS;
+            re += offsets[i] * cosf(phase);
+            im += offsets[i] * sinf(phase);
+        }
+        for (int i = 0; i < CALIBRATION_POINTS; i++)
+        {
+            float phase = 2 * (float)M_PI * k * i / CALIBRATION_POINTS;
+            model[i] += 2 * (re * cosf(phase) + im * sinf(phase)) / CALIBRATION_POINTS;
+        }
+    }
+}
+
+// Squared error left after the correction, nullptr for none
+static float residual(const float *offsets, const float *model)
+{
+    float sum = 0;
+    for (int i = 0; i < CALIBRATION_POINTS; i++)
+    {
+        float error = offsets[i] - (model != nullptr ? model[i] : 0);
+        sum += error * error;
+    }
+    return sum;
+}
+
+bool CalibrationFitter::fit(CalibrationTable &table) const
+{
+    if (_revolutions < CALIBRATION_REVOLUTIONS)
+    {
+        return false;
+    }
+
+    // What only one half shows is wobble and noise, a clean sensor is better off without a table
+    float halves[2][CALIBRATION_POINTS];
+    float models[2][CALIBRATION_POINTS];
+    for (int half = 0; half < 2; half++)
+    {
+        knotOffsets(_bins[half], halves[half]);
+        fitHarmonics(halves[half], models[half]);
+    }
+    for (int half = 0; half < 2; half++)
+    {
+        if (residual(halves[half], models[half ^ 1]) >= residual(halves[half], nullptr))
+        {
+            return false;
+        }
+    }
+
+    uint32_t bins[CALIBRATION_POINTS];
+    for (int i = 0; i < CALIBRATION_POINTS; i++)
+    {
+        bins[i] = _bins[0][i] + _bins[1][i];
+    }
+    float offsets[CALIBRATION_POINTS];
+    float model[CALIBRATION_POINTS];
+    knotOffsets(bins, offsets);
+    fitHarmonics(offsets, model);
+
+    table.version = CALIBRATION_VERSION;
+    for (int i = 0; i < CALIBRATION_POINTS; i++)
+    {
+        int32_t offset = lroundf(model[i]);
+        if (abs(offset) > MAX_OFFSET)
+        {
+            return false;
+        }
+        table.offset[i] = offset;
+    }
+    return isValidCalibration(table);
+}
@@ -0,0 +1,82 @@
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include "config-service.h"
+#include "defaults.h"
+#include "sampler.h"
+#include "wheel-mode.h"
+
+static_assert(HID_CONSUMER || WHEEL_MODE == WHEEL_MODE_SCROLL, "Jog, shuttle and key modes need HID_CONSUMER");
+
+static SemaphoreHandle_t configMutex = NULL;
+
+// Only scroll mode has a report to go out on without the Consumer Control collection
+static bool canReport(const ScrollConfig &config)
+{
+    return HID_CONSUMER || config.wheelMode == WHEEL_MODE_SCROLL;
+}
+
+// Settings outside the sampler snapshot
+static void applyConfig(const ScrollConfig &config)
+{
+    powerManager.setIdleTimeout(config.idleTimeout);
+    powerManager.setOffTimeout(config.offTimeout);
+}
+
+void loadConfig()
+{
+    configMutex = xSemaphoreCreateMutex();
+
+    ScrollConfig config = defaultConfig();
+    bool upgraded = false;
+    Preferences preferences;
+    if (preferences.begin("scroll", true))
+    {
+        // An older firmware's blob keeps its settings, the new fields start at their defaults
+        uint8_t stored[sizeof(ScrollConfig)];
+        size_t length = preferences.getBytesLength("config");
+        if (length <= sizeof(stored) && preferences.getBytes("config", stored, length) == length
+            && migrateConfig(stored, length, config))
+        {
+            upgraded = stored[0] != CONFIG_VERSION;
+        }
+        preferences.end();
+    }
+    if (!canReport(config))
+    {
+        config.wheelMode = WHEEL_MODE_SCROLL; // Stored by a build with HID_CONSUMER
+    }
+
+    publishConfig(config); // The sampler is not running yet
+    applyConfig(config);
+
+    if (upgraded && preferences.begin("scroll", false))
+    {
+        preferences.putBytes("config", &config, sizeof(config));
+        preferences.end();
+    }
+}
+
+bool updateConfig(const ScrollConfig &config)
+{
+    if (!isValidConfig(config) || !canReport(config))
+    {
+        return false;
+    }
+
+    xSemaphoreTake(configMutex, portMAX_DELAY);
+
+    // The sampler lets go of the spare copy after at most one sample
+    while (!publishConfig(config))
+    {
+        vTaskDelay(1);
+    }
+    applyConfig(config);
+
+    Preferences preferences;
+    bool stored = preferences.begin("scroll", false) && preferences.putBytes("config", &config, sizeof(config)) == sizeof(config);
+    preferences.end();
+
+    xSemaphoreGive(configMutex);
+    return stored;
+}
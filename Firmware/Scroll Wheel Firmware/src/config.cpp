@@ -0,0 +1,155 @@
+#include <string.h>
+
+#include "config.h"
+#include "defaults.h"
+#include "double-buffer.h"
+#include "hid-descriptor.h"
+#include "noise-filter.h"
+#include "scroll-accel.h"
+#include "scroll-math.h"
+#include "wheel-mode.h"
+
+#define CONFIG_FIELD(name, member) {name, offsetof(ScrollConfig, member), sizeof(ScrollConfig::member)}
+
+const ConfigField CONFIG_FIELDS[] = {
+    CONFIG_FIELD("gain", scrollGain),
+    CONFIG_FIELD("max_rotation", maxRotation),
+    CONFIG_FIELD("band_min", noiseBandMin),
+    CONFIG_FIELD("band_max", noiseBandMax),
+    CONFIG_FIELD("band_gain", noiseBandGain),
+    CONFIG_FIELD("accel_curve", accelCurve),
+    CONFIG_FIELD("idle_timeout", idleTimeout),
+    CONFIG_FIELD("off_timeout", offTimeout),
+    CONFIG_FIELD("fly_decay", flywheelDecay),
+    CONFIG_FIELD("fly_speed", flywheelMinSpeed),
+    CONFIG_FIELD("mode", wheelMode),
+    CONFIG_FIELD("mode_steps", modeSteps),
+    CONFIG_FIELD("key_up", keyUp),
+    CONFIG_FIELD("key_down", keyDown),
+};
+
+const int CONFIG_FIELD_COUNT = sizeof(CONFIG_FIELDS) / sizeof(CONFIG_FIELDS[0]);
+
+ScrollConfig defaultConfig()
+{
+    ScrollConfig config;
+    config.version = CONFIG_VERSION;
+    config.scrollGain = SCROLL_GAIN_Q12;
+    config.maxRotation = MAX_ROTATION_COUNTS;
+    config.noiseBandMin = roundCounts(degreesToCounts(NOISE_BAND_MIN) * (1 << NoiseFilter::Q));
+    config.noiseBandMax = roundCounts(degreesToCounts(NOISE_BAND_MAX) * (1 << NoiseFilter::Q));
+    config.noiseBandGain = NOISE_BAND_GAIN;
+    config.accelCurve = ACCEL_CURVE;
+    config.idleTimeout = POWER_IDLE_TIMEOUT;
+    config.offTimeout = POWER_OFF_TIMEOUT;
+    config.flywheelDecay = FLYWHEEL_DECAY;
+    config.flywheelMinSpeed = FLYWHEEL_MIN_SPEED;
+    config.wheelMode = WHEEL_MODE;
+    config.modeSteps = MODE_STEPS;
+    config.keyUp = MODE_KEY_UP;
+    config.keyDown = MODE_KEY_DOWN;
+    return config;
+}
+
+// Blob length of every layout version, index 0 is unused
+static const size_t CONFIG_SIZES[] = {
+    0,
+    offsetof(ScrollConfig, flywheelDecay), // 1: gain, noise band, accel and power timeouts
+    offsetof(ScrollConfig, wheelMode),     // 2: flywheel
+    sizeof(ScrollConfig),                  // 3: wheel modes
+    sizeof(ScrollConfig),                  // 4: mode steps per turn instead of counts per step
+};
+
+static_assert(sizeof(CONFIG_SIZES) / sizeof(CONFIG_SIZES[0]) == CONFIG_VERSION + 1, "Add the blob length of the new CONFIG_VERSION");
+
+bool migrateConfig(const void *data, size_t length, ScrollConfig &config)
+{
+    if (length == 0)
+    {
+        return false;
+    }
+    uint8_t version = *(const uint8_t *)data;
+    if (version == 0 || version > CONFIG_VERSION || length != CONFIG_SIZES[version])
+    {
+        return false;
+    }
+
+    ScrollConfig migrated = defaultConfig();
+    memcpy(&migrated, data, length);
+    migrated.version = CONFIG_VERSION;
+    if (version == 3)
+    {
+        // Counts per step, the nearest whole number of steps per turn
+        uint16_t step = migrated.modeSteps;
+        migrated.modeSteps = step > 0 ? (ENCODER_COUNTS + step / 2) / step : 0;
+    }
+    if (!isValidConfig(migrated))
+    {
+        return false;
+    }
+    config = migrated;
+    return true;
+}
+
+bool isValidConfig(const ScrollConfig &config)
+{
+    return config.version == CONFIG_VERSION
+        && config.scrollGain > 0
+        && config.maxRotation > 0 && config.maxRotation < ENCODER_COUNTS
+        && config.noiseBandMin <= config.noiseBandMax
+        && config.noiseBandMax < (ENCODER_COUNTS / 2) << NoiseFilter::Q
+        && config.noiseBandGain > 0
+        && config.accelCurve < ACCEL_CURVE_COUNT
+        && config.idleTimeout > 0
+        && (config.offTimeout == 0 || config.offTimeout > config.idleTimeout)
+        && config.wheelMode < WHEEL_MODE_COUNT
+        && config.modeSteps > 0 && config.modeSteps <= ENCODER_COUNTS
+        && config.keyUp <= CONSUMER_USAGE_MAX && config.keyDown <= CONSUMER_USAGE_MAX;
+}
+
+static DoubleBuffer<ScrollConfig> configBuffer(defaultConfig());
+
+const ScrollConfig &acquireConfig()
+{
+    return configBuffer.acquire();
+}
+
+void releaseConfig()
+{
+    configBuffer.release();
+}
+
+const ScrollConfig &getConfig()
+{
+    return configBuffer.current();
+}
+
+bool publishConfig(const ScrollConfig &config)
+{
+    return isValidConfig(config) && configBuffer.publish(config);
+}
+
+uint32_t getConfigField(const ScrollConfig &config, const ConfigField &field)
+{
+    uint32_t value = 0;
+    memcpy(&value, (const uint8_t *)&config + field.offset, field.size); // Little endian on both targets
+    return value;
+}
+
+bool setConfigField(ScrollConfig &config, const char *name, uint32_t value)
+{
+    for (int i = 0; i < CONFIG_FIELD_COUNT; i++)
+    {
+        const ConfigField &field = CONFIG_FIELDS[i];
+        if (strcmp(field.name, name) == 0)
+        {
+            if (field.size < 4 && value >> (field.size * 8) != 0)
+            {
+                return false;
+            }
+            memcpy((uint8_t *)&config + field.offset, &value, field.size);
+            return true;
+        }
+    }
+    return false;
+}
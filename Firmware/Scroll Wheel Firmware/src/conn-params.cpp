@@ -0,0 +1,144 @@
+#include "conn-params.h"
+#include "defaults.h"
+
+static const ConnParams FAST_PARAMS = {
+    CONN_FAST_MIN_INTERVAL,
+    CONN_FAST_MAX_INTERVAL,
+    0,
+    CONN_FAST_TIMEOUT,
+};
+
+static const ConnParams IDLE_PARAMS = {
+    CONN_IDLE_MIN_INTERVAL,
+    CONN_IDLE_MAX_INTERVAL,
+    CONN_IDLE_LATENCY,
+    CONN_IDLE_SUPERVISION,
+};
+
+ConnParamPolicy::ConnParamPolicy(BleLinkControl &link) :
+    _link(link),
+    _state(DISCONNECTED),
+    _lastMotion(0),
+    _requested({0, 0, 0, 0}),
+    _retryTime(0),
+    _retryDelay(CONN_RETRY_DELAY),
+    _seenRejected(0),
+    _retrying(false),
+    _linkEvent(LINK_NONE),
+    _connectTime(0),
+    _current(0),
+    _rejected(0),
+    _holdFast(false)
+{
+}
+
+void ConnParamPolicy::onConnect(uint32_t now)
+{
+    _connectTime = now;
+    _linkEvent = LINK_UP;
+}
+
+void ConnParamPolicy::onDisconnect()
+{
+    _current = 0;
+    _linkEvent = LINK_DOWN;
+}
+
+void ConnParamPolicy::onMotion(uint32_t now)
+{
+    _lastMotion = now;
+    if (_state == IDLE)
+    {
+        request(FAST, FAST_PARAMS);
+    }
+}
+
+void ConnParamPolicy::onParamsUpdated(bool accepted, uint16_t interval, uint16_t latency, uint16_t timeout)
+{
+    if (!accepted)
+    {
+        _rejected++;
+        return;
+    }
+    _current = (uint64_t)interval << 32 | (uint32_t)latency << 16 | timeout;
+}
+
+void ConnParamPolicy::update(uint32_t now)
+{
+    switch (_linkEvent.exchange(LINK_NONE))
+    {
+    case LINK_UP:
+        _state = CONNECTED;
+        _lastMotion = _connectTime;
+        _retrying = false;
+        break;
+    case LINK_DOWN:
+        _state = DISCONNECTED;
+        _requested = {0, 0, 0, 0};
+        _retrying = false;
+        break;
+    default:
+        break;
+    }
+
+    // A rejection from the stack or the host, try the same parameters again later
+    uint32_t rejected = _rejected;
+    if (rejected != _seenRejected)
+    {
+        _seenRejected = rejected;
+        if (_state == FAST || _state == IDLE)
+        {
+            _retrying = true;
+            _retryTime = now + _retryDelay;
+            _retryDelay = _retryDelay * 2 > CONN_RETRY_MAX ? CONN_RETRY_MAX : _retryDelay * 2;
+        }
+    }
+
+    switch (_state)
+    {
+    case CONNECTED:
+        // Leave the host alone while it discovers services and enables notifications
+        if (now - _connectTime >= CONN_SETUP_DELAY)
+        {
+            request(FAST, FAST_PARAMS);
+        }
+        break;
+    case FAST:
+        if (!_holdFast && now - _lastMotion >= CONN_IDLE_TIMEOUT)
+        {
+            request(IDLE, IDLE_PARAMS);
+        }
+        break;
+    case IDLE:
+        if (_holdFast)
+        {
+            request(FAST, FAST_PARAMS);
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (_retrying && (int32_t)(now - _retryTime) >= 0)
+    {
+        send();
+    }
+}
+
+void ConnParamPolicy::request(State state, const ConnParams &params)
+{
+    // A new target starts over with the shortest back-off
+    _state = state;
+    _requested = params;
+    _retryDelay = CONN_RETRY_DELAY;
+    send();
+}
+
+void ConnParamPolicy::send()
+{
+    _retrying = false;
+    if (!_link.requestConnParams(_requested))
+    {
+        _rejected++;
+    }
+}
@@ -0,0 +1,325 @@
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+#include "battery-task.h"
+#include "boot-sequence.h"
+#include "calibration-service.h"
+#include "config-service.h"
+#include "console.h"
+#include "defaults.h"
+#include "globals.h"
+#include "sampler.h"
+#include "stats.h"
+#include "trace.h"
+
+static void writeSerial(const uint8_t *data, size_t length, void *context)
+{
+    Serial.write(data, length);
+}
+
+// Binary dump, starts with the "SWTR" magic so the host tool can find it in the log
+static void dumpTrace()
+{
+    sampleTrace.stop();
+    reportTrace.stop();
+
+    writeTraceHeader(writeSerial, NULL, 2, bleMouse.getWheelMultiplier(), getConfig());
+    sampleTrace.dump(writeSerial, NULL);
+    reportTrace.dump(writeSerial, NULL);
+    Serial.flush();
+}
+
+static void printStats()
+{
+#ifdef SCROLL_STATS
+    static const char *names[STAT_ID_COUNT] = {"i2c read", "compute", "notify", "latency"};
+    static const char *units[STAT_ID_COUNT] = {"cyc", "cyc", "cyc", "us"};
+    static const char *counterNames[COUNTER_ID_COUNT] = {"reports", "coalesced", "dropped", "overruns", "read errs"};
+
+    StatsSnapshot snapshot;
+    getStats(snapshot);
+
+    for (int i = 0; i < STAT_ID_COUNT; i++)
+    {
+        const StatSnapshot &stat = snapshot.stats[i];
+        Serial.printf("%-9s n=%u min=%u avg=%u max=%u %s\n", names[i], stat.count, stat.min, stat.avg, stat.max, units[i]);
+        Serial.print("          ");
+        for (int b = 0; b < STAT_BUCKETS; b++)
+        {
+            Serial.printf(" %u", stat.buckets[b]);
+        }
+        Serial.println();
+    }
+    for (int i = 0; i < COUNTER_ID_COUNT; i++)
+    {
+        Serial.printf("%-9s %u\n", counterNames[i], snapshot.counters[i]);
+    }
+#else
+    Serial.println("Stats not compiled in, build with -DSCROLL_STATS");
+#endif
+
+    const AngleTracker &tracker = rotarySensor.getTracker();
+    Serial.printf("Unwrap: %u samples beyond max rotation, %u aliased, %u read errors\n", tracker.getUnwrapped(),
+                  tracker.getAliased(), rotarySensor.getReadErrors());
+
+    static const char *axes[] = {"wheel", "pan"};
+    Serial.printf("Channels: %u, longest tick %u us since the last s\n", sensorChannels.getCount(), sensorChannels.getMaxTickTime());
+    for (uint8_t i = 0; i < sensorChannels.getCount(); i++)
+    {
+        Serial.printf("  %u %-5s offset jitter %u us, %u read errors\n", i, axes[sensorChannels.getAxis(i)],
+                      sensorChannels.getOffsetJitter(i), sensorChannels.getSensor(i).getReadErrors());
+    }
+    sensorChannels.resetTiming();
+}
+
+static void printPower()
+{
+    static const char *states[] = {"active", "idle", "off"};
+    Serial.printf("Power %s, %u wake-ups, last wake latency %u ms, max %u ms\n",
+                  states[powerManager.getState()], powerManager.getWakeups(),
+                  powerManager.getWakeLatency(), powerManager.getMaxWakeLatency());
+    Serial.printf("Battery %u %%, %u mV\n", batteryMonitor.getLevel(), batteryMonitor.getMillivolts());
+    Serial.printf("Profile %s, USB %s, charging %s, %u switches\n",
+                  powerSource.getProfile() == POWER_PROFILE_USB ? "usb" : "battery", powerSource.isUsbPowered() ? "yes" : "no",
+                  powerSource.isCharging() ? "yes" : "no", powerSource.getSwitches());
+}
+
+static void printConnection()
+{
+    const ConnParamPolicy &params = bleMouse.getConnParams();
+    Serial.printf("Connected %s, interval %u latency %u timeout %u, %u rejected\n",
+                  bleMouse.isConnected() ? "yes" : "no", params.getInterval(), params.getLatency(),
+                  params.getTimeout(), params.getRejected());
+    Serial.printf("%u reconnects, last %u ms (%s), max %u ms\n", bleMouse.getReconnects(),
+                  bleMouse.getReconnectTime(), bleMouse.wasReconnectDirected() ? "directed" : "undirected",
+                  bleMouse.getMaxReconnectTime());
+}
+
+// Phase times of this boot, phases not reached yet show a dash
+static void printBoot()
+{
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++)
+    {
+        BootPhase phase = (BootPhase)i;
+        if (bootTimeline.reached(phase))
+        {
+            Serial.printf("%-13s %6u ms\n", BOOT_PHASE_NAMES[i], bootTimeline.get(phase));
+        }
+        else
+        {
+            Serial.printf("%-13s %6s\n", BOOT_PHASE_NAMES[i], "-");
+        }
+    }
+}
+
+static void printStackFree(const char *name)
+{
+    TaskHandle_t task = xTaskGetHandle(name);
+    if (task != NULL)
+    {
+        Serial.printf(" %s %u", name, uxTaskGetStackHighWaterMark(task));
+    }
+}
+
+// High-water marks since boot, stack values are the bytes never touched
+static void printMemory()
+{
+    Serial.printf("Heap free %u, min %u, largest block %u bytes\n", heap_caps_get_free_size(MALLOC_CAP_8BIT),
+                  heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT), heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    Serial.print("Stack free:");
+    printStackFree("sampler");
+    printStackFree("reporter");
+    printStackFree("battery");
+    printStackFree("loopTask");
+    Serial.printf(" ble setup %u bytes\n", bleMouse.getSetupStackFree());
+}
+
+static void benchmarkSensor(const char *name, AngleSensor &sensor)
+{
+    constexpr int reads = 1000;
+
+    if (!sensor.begin())
+    {
+        Serial.printf("%-8s not available\n", name);
+        sensor.end();
+        return;
+    }
+    delay(10); // Let the first PWM frames and ADC samples arrive
+
+    uint32_t minCycles = UINT32_MAX;
+    uint32_t maxCycles = 0;
+    uint64_t sum = 0;
+    uint64_t sumSquares = 0;
+    uint32_t errors = 0;
+    for (int i = 0; i < reads; i++)
+    {
+        uint32_t start = systemClock.cycles();
+        int16_t angle = sensor.readAngle();
+        uint32_t cycles = systemClock.cycles() - start;
+
+        minCycles = min(minCycles, cycles);
+        maxCycles = max(maxCycles, cycles);
+        sum += cycles;
+        sumSquares += (uint64_t)cycles * cycles;
+        if (angle < 0)
+        {
+            errors++;
+        }
+        delayMicroseconds(1000000 / SAMPLE_RATE_HZ);
+    }
+    sensor.end();
+
+    float mhz = getCpuFrequencyMhz();
+    float avg = (float)sum / reads;
+    float jitter = sqrtf((float)sumSquares / reads - avg * avg);
+    Serial.printf("%-8s min %.2f avg %.2f max %.2f us, jitter %.2f us, %u errors\n",
+                  name, minCycles / mhz, avg / mhz, maxCycles / mhz, jitter / mhz, errors);
+}
+
+// Read latency of every backend, the sampler is paused meanwhile
+static void benchmarkSensors()
+{
+    pauseSampler(true);
+    // The backends all talk to the primary encoder, the pwm and analog passes change its OUT mode
+    selectPrimaryEncoder();
+    uint8_t outputMode = encoder.getOutputMode();
+    benchmarkSensor("library", libraryBackend);
+    benchmarkSensor("i2c", i2cBackend);
+    benchmarkSensor("pwm", pwmBackend);
+    benchmarkSensor("analog", analogBackend);
+
+    selectPrimaryEncoder();
+    encoder.setOutputMode(outputMode);
+    angleSensor.begin(); // After the OUT mode, the fast I2C backend re-points at ANGLE here
+    for (uint8_t i = 0; i < sensorChannels.getCount(); i++)
+    {
+        sensorChannels.getSensor(i).reset();
+    }
+    pauseSampler(false);
+}
+
+static void printConfig()
+{
+    const ScrollConfig &config = getConfig();
+    for (int i = 0; i < CONFIG_FIELD_COUNT; i++)
+    {
+        Serial.printf("%-12s %u\n", CONFIG_FIELDS[i].name, getConfigField(config, CONFIG_FIELDS[i]));
+    }
+}
+
+// "w <name> <value>" changes one field, "w defaults" goes back to defaults.h
+static void writeConfig()
+{
+    String line = Serial.readStringUntil('\n');
+    line.trim();
+
+    ScrollConfig config = getConfig();
+    if (line == "defaults")
+    {
+        config = defaultConfig();
+    }
+    else
+    {
+        int split = line.indexOf(' ');
+        if (split < 0 || !setConfigField(config, line.substring(0, split).c_str(), line.substring(split + 1).toInt()))
+        {
+            Serial.println("Usage: w <name> <value> or w defaults");
+            return;
+        }
+    }
+    Serial.println(updateConfig(config) ? "Config saved" : "Config rejected or not stored");
+}
+
+static void startOrCancelCalibration()
+{
+    if (isCalibrating())
+    {
+        cancelCalibration();
+        Serial.println("Calibration cancelled");
+        return;
+    }
+    startCalibration();
+    Serial.printf("Calibrating, spin the wheel at a steady speed for %u turns\n", CALIBRATION_REVOLUTIONS + 1);
+}
+
+static void printCalibration()
+{
+    const CalibrationTable &table = getCalibration();
+    int32_t minOffset = 0;
+    int32_t maxOffset = 0;
+    for (int i = 0; i < CALIBRATION_POINTS; i++)
+    {
+        minOffset = min<int32_t>(minOffset, table.offset[i]);
+        maxOffset = max<int32_t>(maxOffset, table.offset[i]);
+    }
+    Serial.printf("Linearity correction %.2f to %.2f counts\n", minOffset / (double)(1 << CALIBRATION_Q), maxOffset / (double)(1 << CALIBRATION_Q));
+}
+
+void handleConsole()
+{
+    bool calibrated;
+    if (finishCalibration(calibrated))
+    {
+        Serial.println(calibrated ? "Calibration stored" : "Calibration failed, table not stored");
+        printCalibration();
+    }
+
+    while (Serial.available())
+    {
+        switch (Serial.read())
+        {
+        case 't':
+            sampleTrace.start();
+            reportTrace.start();
+            Serial.println("Trace started");
+            break;
+        case 'd':
+            dumpTrace();
+            break;
+        case 's':
+            printStats();
+            break;
+        case 'p':
+            printPower();
+            break;
+        case 'c':
+            printConnection();
+            break;
+        case 'b':
+            benchmarkSensors();
+            break;
+        case 'm':
+            printMemory();
+            break;
+        case 'o':
+            printBoot();
+            break;
+        case 'k':
+            startOrCancelCalibration();
+            break;
+        case 'l':
+            printCalibration();
+            break;
+        case 'u':
+            Serial.println(clearCalibration() ? "Calibration cleared" : "Calibration not stored");
+            break;
+        case 'g':
+            printConfig();
+            break;
+        case 'w':
+            writeConfig();
+            break;
+#ifdef SCROLL_STATS
+        case 'r':
+            resetStats();
+            Serial.println("Stats reset");
+            break;
+#endif
+        case '?':
+            Serial.println("t: start trace, d: dump trace, s: stats, r: reset stats, p: power, c: connection, m: memory, o: boot times, b: sensor benchmark, g: config, w: write config, k: calibrate, l: calibration, u: clear calibration");
+            break;
+        default:
+            break;
+        }
+    }
+}
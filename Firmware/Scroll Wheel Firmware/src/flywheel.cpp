@@ -0,0 +1,117 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "defaults.h"
+#include "flywheel.h"
+#include "scroll-math.h"
+
+constexpr int32_t STOP_FRACTION = 16; // Coasting ends below 1/16 of the release speed threshold
+constexpr int DECAY_BITS = 16;        // Extra fraction bits of the coasting speed, so small speeds decay at the same rate
+
+static_assert(samplesFor(SAMPLE_RATE_HZ, FLYWHEEL_RELEASE_TIME) < UINT16_MAX, "FLYWHEEL_RELEASE_TIME too long for the sample rate");
+
+Flywheel::Flywheel() : _releaseSamples(samplesFor(SAMPLE_RATE_HZ, FLYWHEEL_RELEASE_TIME)), _sampleRate(SAMPLE_RATE_HZ)
+{
+    reset();
+}
+
+void Flywheel::setSampleRate(uint32_t rate)
+{
+    if (rate == 0 || rate == _sampleRate)
+    {
+        return;
+    }
+    _sampleRate = rate;
+    _releaseSamples = samplesFor(rate, FLYWHEEL_RELEASE_TIME);
+    reset();
+}
+
+void Flywheel::reset()
+{
+    memset(_history, 0, sizeof(_history));
+    _sum = 0;
+    _tailSum = 0;
+    _index = 0;
+    _releaseVelocity = 0;
+    _quietSamples = 0;
+    _multiplier = 1;
+    stop();
+}
+
+void Flywheel::stop()
+{
+    _coasting = false;
+    _velocity = 0;
+    _remainder = 0;
+}
+
+void Flywheel::touch()
+{
+    stop();
+    _releaseVelocity = 0;
+}
+
+int32_t Flywheel::update(int32_t value, int32_t amount, bool motion, uint8_t multiplier, const ScrollConfig &config)
+{
+    if (config.flywheelDecay == 0)
+    {
+        return value;
+    }
+    if (multiplier != _multiplier)
+    {
+        reset();
+        _multiplier = multiplier;
+    }
+
+    _sum += amount - _history[_index];
+    _tailSum += amount - _history[(_index + FLYWHEEL_WINDOW - FLYWHEEL_TAIL) % FLYWHEEL_WINDOW];
+    _history[_index] = amount;
+    _index = (_index + 1) % FLYWHEEL_WINDOW;
+
+    if (motion)
+    {
+        // Touching the wheel stops the coasting, the motion itself is reported as usual
+        stop();
+        _quietSamples = 0;
+
+        // Only a speed that ran down towards the stop is a release, tail speed over window speed
+        int64_t tail = _tailSum * FLYWHEEL_WINDOW * 100;
+        int64_t window = _sum * FLYWHEEL_TAIL * FLYWHEEL_TAPER;
+        bool tapered = _sum > 0 ? tail >= 0 && tail <= window : tail <= 0 && tail >= window;
+        _releaseVelocity = tapered ? _sum / FLYWHEEL_WINDOW : 0;
+        return value;
+    }
+
+    // Release speed in report units per second at multiplier 1, scaled to Q12 per sample
+    int32_t threshold = (int64_t)config.flywheelMinSpeed * multiplier * SCROLL_ONE / _sampleRate;
+
+    if (!_coasting)
+    {
+        if (_quietSamples < _releaseSamples && ++_quietSamples == _releaseSamples
+            && threshold > 0 && abs(_releaseVelocity) >= threshold)
+        {
+            _coasting = true;
+            _velocity = (int64_t)_releaseVelocity << DECAY_BITS;
+            _remainder = 0;
+        }
+        return 0;
+    }
+
+    _remainder += roundShift(_velocity, DECAY_BITS);
+    int32_t coastValue = _remainder / SCROLL_ONE;
+    _remainder -= coastValue * SCROLL_ONE;
+
+    // First order decay, 1 - 1/tau per sample is close enough to exp(-1/tau) for tau of a few ms and up
+    int32_t tauSamples = (int32_t)config.flywheelDecay * _sampleRate / 1000;
+    _velocity -= _velocity / (tauSamples > 1 ? tauSamples : 1);
+    if (llabs(_velocity) * STOP_FRACTION < (int64_t)threshold << DECAY_BITS)
+    {
+        stop();
+    }
+    return coastValue;
+}
+
+int32_t Flywheel::getVelocity() const
+{
+    return (int32_t)roundShift(_velocity, DECAY_BITS);
+}
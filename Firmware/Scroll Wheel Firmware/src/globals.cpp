@@ -1,6 +1,55 @@
 #include "globals.h"
 #include "defaults.h"
-#include "battery.h"
 
 AS5600 encoder;
-BleMouse bleMouse(BLE_DEVICE_NAME, "Mario", getBatteryLevel());
\ No newline at end of file
+As5600Sensor libraryBackend(encoder);
+FastI2cSensor i2cBackend(encoder, Wire);
+PwmSensor pwmBackend(encoder, SENSOR_OUT_PIN);
+AnalogSensor analogBackend(encoder, SENSOR_OUT_PIN);
+
+static_assert(SENSOR_CHANNELS == 1 || (SENSOR_CHANNELS == 2 && SENSOR_BACKEND == 1),
+              "A second encoder needs the fast I2C backend");
+static_assert(SENSOR_CHANNELS == 1 || SENSOR_SECOND_AXIS == CHANNEL_WHEEL || HID_CONSUMER,
+              "A pan wheel needs HID_CONSUMER");
+
+#if SENSOR_CHANNELS > 1 && SENSOR_CHANNEL_BUS == 1
+// Two AS5600 at the same address, each behind its own mux port
+static I2cMux sensorMux(Wire, SENSOR_MUX_ADDRESS);
+static MuxedSensor firstMuxed(i2cBackend, sensorMux, SENSOR_MUX_PORT_FIRST);
+static AS5600 secondEncoder;
+static FastI2cSensor secondI2c(secondEncoder, Wire);
+static MuxedSensor secondMuxed(secondI2c, sensorMux, SENSOR_MUX_PORT_SECOND);
+AngleSensor &angleSensor = firstMuxed;
+AngleSensor &secondAngleSensor = secondMuxed;
+#elif SENSOR_CHANNELS > 1
+// AS5600L next to the AS5600 on the same bus
+static AS5600L secondEncoder(SENSOR_AS5600L_ADDRESS);
+static FastI2cSensor secondI2c(secondEncoder, Wire);
+AngleSensor &angleSensor = i2cBackend;
+AngleSensor &secondAngleSensor = secondI2c;
+#elif SENSOR_BACKEND == 1
+AngleSensor &angleSensor = i2cBackend;
+#elif SENSOR_BACKEND == 2
+AngleSensor &angleSensor = pwmBackend;
+#elif SENSOR_BACKEND == 3
+AngleSensor &angleSensor = analogBackend;
+#else
+AngleSensor &angleSensor = libraryBackend;
+#endif
+Esp32Adc batteryAdc(BATTERY_SENSE_PIN);
+Esp32Clock systemClock;
+RotarySensor rotarySensor(angleSensor);
+#if SENSOR_CHANNELS > 1
+RotarySensor secondRotarySensor(secondAngleSensor);
+#endif
+SensorChannels sensorChannels(systemClock);
+ScrollWheelMouse bleMouse(BLE_DEVICE_NAME, "Mario", 100); // The battery task reports the real level
+
+bool selectPrimaryEncoder()
+{
+#if SENSOR_CHANNELS > 1 && SENSOR_CHANNEL_BUS == 1
+    return sensorMux.select(SENSOR_MUX_PORT_FIRST);
+#else
+    return true;
+#endif
+}
@@ -0,0 +1,329 @@
+#include <Arduino.h>
+#include <driver/adc.h>
+#include <esp_timer.h>
+
+#include "defaults.h"
+#include "hal-esp32.h"
+#include "scroll-math.h"
+
+constexpr uint8_t ANGLE_REGISTER = 0x0E;      // ANGLE high byte, low byte follows
+constexpr uint32_t PWM_FRAME_CLOCKS = 4351;   // 128 high, 4095 data, 128 low
+constexpr uint32_t PWM_HEADER_CLOCKS = 128;
+constexpr uint32_t ANALOG_READ_BYTES = 256;   // DMA results fetched per call
+constexpr uint32_t ANALOG_BUFFER_BYTES = 1024;
+
+bool As5600Sensor::begin()
+{
+    return _encoder.begin();
+}
+
+int16_t As5600Sensor::readAngle()
+{
+    return _encoder.readAngle();
+}
+
+SignalQuality As5600Sensor::readSignalQuality()
+{
+    uint8_t status = _encoder.readStatus();
+
+    SignalQuality quality;
+    quality.magnetDetected = status & AS5600_MAGNET_DETECT;
+    quality.fieldOutOfRange = status & (AS5600_MAGNET_LOW | AS5600_MAGNET_HIGH);
+    quality.agc = _encoder.readAGC();
+    quality.magnitude = _encoder.readMagnitude();
+    return quality;
+}
+
+void As5600Sensor::setPowerMode(SensorPowerMode mode)
+{
+    // SensorPowerMode follows the AS5600 PM register values
+    _encoder.setPowerMode(mode);
+}
+
+bool FastI2cSensor::begin()
+{
+    _wire.setClock(I2C_CLOCK_HZ);
+    _wire.setTimeOut(I2C_TIMEOUT);
+    _pointerSet = false;
+    return _encoder.begin();
+}
+
+void FastI2cSensor::end()
+{
+    _wire.setClock(100000);
+    _pointerSet = false;
+}
+
+int16_t FastI2cSensor::readAngle()
+{
+    uint8_t address = _encoder.getAddress();
+    if (!_pointerSet)
+    {
+        _wire.beginTransmission(address);
+        _wire.write(ANGLE_REGISTER);
+        if (_wire.endTransmission() != 0)
+        {
+            return SENSOR_READ_ERROR;
+        }
+        _pointerSet = true;
+    }
+
+    if (_wire.requestFrom(address, (uint8_t)2) != 2)
+    {
+        _pointerSet = false; // Start over with the register write after a failed transfer
+        return SENSOR_READ_ERROR;
+    }
+    uint8_t high = _wire.read();
+    uint8_t low = _wire.read();
+    return ((high << 8) | low) & 0x0FFF;
+}
+
+SignalQuality FastI2cSensor::readSignalQuality()
+{
+    _pointerSet = false; // The library moves the address pointer
+    return As5600Sensor::readSignalQuality();
+}
+
+void FastI2cSensor::setPowerMode(SensorPowerMode mode)
+{
+    _pointerSet = false;
+    As5600Sensor::setPowerMode(mode);
+}
+
+bool I2cMux::select(uint8_t port)
+{
+    if (port == _port)
+    {
+        return true;
+    }
+    _wire.beginTransmission(_address);
+    _wire.write(1 << port);
+    _port = _wire.endTransmission() == 0 ? port : NO_PORT;
+    return _port == port;
+}
+
+bool MuxedSensor::begin()
+{
+    return _mux.select(_port) && _sensor.begin();
+}
+
+void MuxedSensor::end()
+{
+    _sensor.end();
+}
+
+int16_t MuxedSensor::readAngle()
+{
+    return _mux.select(_port) ? _sensor.readAngle() : SENSOR_READ_ERROR;
+}
+
+SignalQuality MuxedSensor::readSignalQuality()
+{
+    if (!_mux.select(_port))
+    {
+        return {false, false, 0, 0}; // Reads as a missing magnet, the dead band opens fully until the port answers
+    }
+    return _sensor.readSignalQuality();
+}
+
+void MuxedSensor::setPowerMode(SensorPowerMode mode)
+{
+    if (_mux.select(_port))
+    {
+        _sensor.setPowerMode(mode);
+    }
+}
+
+bool PwmSensor::begin()
+{
+    _hasRise = false;
+    _hasFall = false;
+    _angle = SENSOR_READ_ERROR;
+    _frameTime = 0;
+
+    if (!_encoder.begin() || !_encoder.setOutputMode(AS5600_OUTMODE_PWM) || !_encoder.setPWMFrequency(AS5600_PWM_920))
+    {
+        return false;
+    }
+
+    mcpwm_capture_config_t config = {};
+    config.cap_edge = MCPWM_BOTH_EDGE;
+    config.cap_prescale = 1;
+    config.capture_cb = onCapture;
+    config.user_data = this;
+    return mcpwm_gpio_init(MCPWM_UNIT_0, MCPWM_CAP_0, _pin) == ESP_OK
+        && mcpwm_capture_enable_channel(MCPWM_UNIT_0, MCPWM_SELECT_CAP0, &config) == ESP_OK;
+}
+
+void PwmSensor::end()
+{
+    mcpwm_capture_disable_channel(MCPWM_UNIT_0, MCPWM_SELECT_CAP0);
+}
+
+int16_t PwmSensor::readAngle()
+{
+    uint32_t frameTime = _frameTime;
+    int16_t angle = _angle;
+    if ((uint32_t)esp_timer_get_time() - frameTime > SENSOR_STALE_TIME) // 32-bit difference, right across the wrap
+    {
+        return SENSOR_READ_ERROR;
+    }
+    return angle;
+}
+
+// Capture ticks run at the 80 MHz APB clock, a 920 Hz frame is about 87000 ticks
+bool IRAM_ATTR PwmSensor::onCapture(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel, const cap_event_data_t *event, void *arg)
+{
+    PwmSensor *sensor = (PwmSensor *)arg;
+
+    if (event->cap_edge == MCPWM_NEG_EDGE)
+    {
+        // Capture may start mid-frame, a fall before the first rise belongs to no frame
+        sensor->_fall = event->cap_value;
+        sensor->_hasFall = sensor->_hasRise;
+        return false;
+    }
+    if (!sensor->_hasRise)
+    {
+        sensor->_rise = event->cap_value;
+        sensor->_hasRise = true;
+        return false;
+    }
+
+    // A rising edge closes the previous frame
+    uint32_t period = event->cap_value - sensor->_rise;
+    uint32_t high = sensor->_fall - sensor->_rise;
+    sensor->_rise = event->cap_value;
+    if (!sensor->_hasFall || period == 0)
+    {
+        return false;
+    }
+    sensor->_hasFall = false;
+
+    int32_t clocks = (int32_t)((high * PWM_FRAME_CLOCKS + period / 2) / period) - (int32_t)PWM_HEADER_CLOCKS;
+    sensor->_angle = clocks < 0 ? 0 : (clocks > ENCODER_COUNTS - 1 ? ENCODER_COUNTS - 1 : clocks);
+    sensor->_frameTime = esp_timer_get_time();
+    return false;
+}
+
+bool AnalogSensor::begin()
+{
+    _angle = SENSOR_READ_ERROR;
+    _angleTime = 0;
+
+    int8_t channel = digitalPinToAnalogChannel(_pin);
+    if (channel < 0 || channel >= ADC1_CHANNEL_MAX)
+    {
+        return false; // DMA only works on ADC1
+    }
+    if (!_encoder.begin() || !_encoder.setOutputMode(AS5600_OUTMODE_ANALOG_90))
+    {
+        return false;
+    }
+
+    adc_digi_init_config_t init = {};
+    init.max_store_buf_size = ANALOG_BUFFER_BYTES;
+    init.conv_num_each_intr = ANALOG_READ_BYTES;
+    init.adc1_chan_mask = BIT(channel);
+    if (adc_digi_initialize(&init) != ESP_OK)
+    {
+        return false;
+    }
+
+    adc_digi_pattern_config_t pattern = {};
+    pattern.atten = ADC_ATTEN_DB_11;
+    pattern.channel = channel;
+    pattern.unit = 0;
+    pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+
+    adc_digi_configuration_t config = {};
+    config.conv_limit_en = true;
+    config.conv_limit_num = 250;
+    config.pattern_num = 1;
+    config.adc_pattern = &pattern;
+    config.sample_freq_hz = ANALOG_SAMPLE_RATE_HZ;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+    if (adc_digi_controller_configure(&config) != ESP_OK || adc_digi_start() != ESP_OK)
+    {
+        adc_digi_deinitialize();
+        return false;
+    }
+    _running = true;
+    return true;
+}
+
+void AnalogSensor::end()
+{
+    if (_running)
+    {
+        adc_digi_stop();
+        adc_digi_deinitialize();
+        _running = false;
+    }
+}
+
+int16_t AnalogSensor::readAngle()
+{
+    uint8_t buffer[ANALOG_READ_BYTES];
+    uint32_t length = 0;
+    uint32_t last = 0;
+
+    // Drain the DMA buffer so the angle never lags behind, only the newest chunk is averaged
+    while (adc_digi_read_bytes(buffer, sizeof(buffer), &length, 0) == ESP_OK && length > 0)
+    {
+        last = length;
+        if (length < sizeof(buffer))
+        {
+            break;
+        }
+    }
+
+    uint32_t count = last / SOC_ADC_DIGI_RESULT_BYTES;
+    if (count > 0)
+    {
+        // Average around the first sample so values on both sides of 0/4095 don't cancel out
+        int32_t first = -1;
+        int32_t sum = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            adc_digi_output_data_t *result = (adc_digi_output_data_t *)&buffer[i * SOC_ADC_DIGI_RESULT_BYTES];
+            int32_t raw = result->type1.data;
+            int32_t angle = (raw - ANALOG_RAW_MIN) * ENCODER_COUNTS / (ANALOG_RAW_MAX - ANALOG_RAW_MIN);
+            angle = angle < 0 ? 0 : (angle > ENCODER_COUNTS - 1 ? ENCODER_COUNTS - 1 : angle);
+            if (first < 0)
+            {
+                first = angle;
+            }
+            sum += wrapCounts(angle - first);
+        }
+        _angle = (first + sum / (int32_t)count) & (ENCODER_COUNTS - 1);
+        _angleTime = esp_timer_get_time();
+    }
+
+    if ((uint32_t)esp_timer_get_time() - _angleTime > SENSOR_STALE_TIME)
+    {
+        return SENSOR_READ_ERROR;
+    }
+    return _angle;
+}
+
+uint32_t Esp32Adc::readMillivolts()
+{
+    return analogReadMilliVolts(_pin);
+}
+
+uint32_t Esp32Clock::nowMs()
+{
+    return esp_timer_get_time() / 1000;
+}
+
+uint32_t Esp32Clock::nowUs()
+{
+    return esp_timer_get_time();
+}
+
+uint32_t Esp32Clock::cycles()
+{
+    return ESP.getCycleCount();
+}
@@ -0,0 +1,107 @@
+#include "hid-descriptor.h"
+
+// Known-good descriptors, written out by hand from the HID usage tables. The
+// builder has to reproduce them byte for byte, checked on every build.
+
+// The descriptor the firmware shipped with before the builder
+constexpr uint8_t CLASSIC_DESCRIPTOR[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01,             // Generic Desktop, Mouse, Application
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x02,             // Generic Desktop, Mouse, Logical
+    0x85, 0x01, 0x09, 0x01, 0xA1, 0x00,             // Report ID 1, Pointer, Physical
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x05,             // Buttons 1 to 5
+    0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x05, // 0 to 1, 1 bit, 5 times
+    0x81, 0x02,                                     // Input (Data, Var, Abs)
+    0x75, 0x03, 0x95, 0x01, 0x81, 0x03,             // 3 bit padding
+    0x05, 0x01, 0x09, 0x30, 0x09, 0x31,             // Generic Desktop, X, Y
+    0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x02, // -127 to 127, 8 bits, 2 times
+    0x81, 0x06,                                     // Input (Data, Var, Rel)
+    0x09, 0x38, 0x35, 0x00, 0x45, 0x00,             // Wheel, physical 0 to 0
+    0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x01, // -127 to 127, 8 bits, once
+    0x81, 0x06,                                     // Input (Data, Var, Rel)
+    0x05, 0x01, 0x09, 0x48,                         // Generic Desktop, Resolution Multiplier
+    0x15, 0x00, 0x25, 0x01, 0x35, 0x01, 0x45, 0x78, // 0 to 1, physical 1 to 120
+    0x75, 0x08, 0x95, 0x01, 0xB1, 0x02,             // 8 bits, once, Feature (Data, Var, Abs)
+    0xC0, 0xC0, 0xC0,
+};
+
+constexpr uint8_t HIRES_DESCRIPTOR[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01,
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x02,
+    0x85, 0x01, 0x09, 0x01, 0xA1, 0x00,
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x05,
+    0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x05,
+    0x81, 0x02,
+    0x75, 0x03, 0x95, 0x01, 0x81, 0x03,
+    0x05, 0x01, 0x09, 0x30, 0x09, 0x31,
+    0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x02,
+    0x81, 0x06,
+    0x09, 0x38, 0x35, 0x00, 0x45, 0x00,                         // Wheel, physical 0 to 0
+    0x16, 0x01, 0x80, 0x26, 0xFF, 0x7F, 0x75, 0x10, 0x95, 0x01, // -32767 to 32767, 16 bits, once
+    0x81, 0x06,                                                 // Input (Data, Var, Rel)
+    0x05, 0x0C, 0x0A, 0x38, 0x02, 0x81, 0x06,                   // Consumer, AC Pan, same size
+    0x05, 0x01, 0x09, 0x48,
+    0x15, 0x00, 0x25, 0x01, 0x35, 0x01, 0x45, 0x78,
+    0x75, 0x08, 0x95, 0x01, 0xB1, 0x02,
+    0xC0, 0xC0, 0xC0,
+};
+
+// Same as hi-res without the X/Y item block
+constexpr uint8_t SCROLL_ONLY_DESCRIPTOR[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01,
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x02,
+    0x85, 0x01, 0x09, 0x01, 0xA1, 0x00,
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x05,
+    0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x05,
+    0x81, 0x02,
+    0x75, 0x03, 0x95, 0x01, 0x81, 0x03,
+    0x05, 0x01,
+    0x09, 0x38, 0x35, 0x00, 0x45, 0x00,
+    0x16, 0x01, 0x80, 0x26, 0xFF, 0x7F, 0x75, 0x10, 0x95, 0x01,
+    0x81, 0x06,
+    0x05, 0x0C, 0x0A, 0x38, 0x02, 0x81, 0x06,
+    0x05, 0x01, 0x09, 0x48,
+    0x15, 0x00, 0x25, 0x01, 0x35, 0x01, 0x45, 0x78,
+    0x75, 0x08, 0x95, 0x01, 0xB1, 0x02,
+    0xC0, 0xC0, 0xC0,
+};
+
+constexpr uint8_t CONSUMER_DESCRIPTOR[] = {
+    0x05, 0x0C, 0x09, 0x01, 0xA1, 0x01,             // Consumer, Consumer Control, Application
+    0x85, 0x02,                                     // Report ID 2
+    0x19, 0x00, 0x2A, 0xFF, 0x03,                   // Usages 0 to 0x3FF
+    0x15, 0x00, 0x26, 0xFF, 0x03,                   // 0 to 0x3FF
+    0x75, 0x10, 0x95, 0x01, 0x81, 0x00,             // 16 bits, once, Input (Data, Array, Abs)
+    0x0A, 0x38, 0x02,                               // AC Pan
+    0x16, 0x01, 0x80, 0x26, 0xFF, 0x7F,             // -32767 to 32767, same size
+    0x81, 0x06,                                     // Input (Data, Var, Rel)
+    0xC0,
+};
+
+template <size_t N>
+constexpr bool sameBytes(const HidDescriptor &descriptor, const uint8_t (&expected)[N])
+{
+    if (descriptor.length != N)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < N; i++)
+    {
+        if (descriptor.data[i] != expected[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(sameBytes(makeMouseDescriptor(MouseReport<HID_CLASSIC>::layout), CLASSIC_DESCRIPTOR),
+              "Classic descriptor differs from the known-good bytes");
+static_assert(sameBytes(makeMouseDescriptor(MouseReport<HID_HIRES>::layout), HIRES_DESCRIPTOR),
+              "Hi-res descriptor differs from the known-good bytes");
+static_assert(sameBytes(makeMouseDescriptor(MouseReport<HID_SCROLL_ONLY>::layout), SCROLL_ONLY_DESCRIPTOR),
+              "Scroll-only descriptor differs from the known-good bytes");
+static_assert(sameBytes(makeConsumerDescriptor(CONSUMER_REPORT_ID), CONSUMER_DESCRIPTOR),
+              "Consumer descriptor differs from the known-good bytes");
+static_assert(makeCompositeDescriptor(MouseReport<HID_HIRES>::layout, CONSUMER_REPORT_ID).length
+                  == sizeof(HIRES_DESCRIPTOR) + sizeof(CONSUMER_DESCRIPTOR),
+              "Composite descriptor is not the mouse followed by the consumer collection");
@@ -3,52 +3,86 @@
 
 #include "BleMouse.h"
 #include "defaults.h"
-#include "battery.h"
-#include "main.h"
+#include "battery-task.h"
+#include "boot-sequence.h"
+#include "calibration-service.h"
+#include "config-service.h"
+#include "console.h"
 #include "globals.h"
+#include "sampler.h"
 
-unsigned long lastScrollUpdate = 0;
-unsigned long lastBatteryTime = 0;
+static SensorProbe sensorProbe(angleSensor, bootTimeline);
+
+// Starts sampling once the encoder answers, until then the loop keeps probing
+static void pollSensor()
+{
+    SensorProbe::State previous = sensorProbe.getState();
+    SensorProbe::State state = sensorProbe.poll(systemClock.nowMs());
+    if (state == SensorProbe::READY && previous != SensorProbe::READY)
+    {
+#if SENSOR_CHANNELS > 1
+        // The extra encoder is optional, a missing one only reads errors
+        if (!secondAngleSensor.begin())
+        {
+            Serial.println("Second encoder not found");
+        }
+#endif
+        startSampler();
+        if (sensorProbe.getAttempts() > 1)
+        {
+            Serial.printf("Rotary encoder found after %u tries\n", sensorProbe.getAttempts());
+        }
+    }
+    else if (state == SensorProbe::WAITING && sensorProbe.getAttempts() == 1)
+    {
+        Serial.println("Rotary encoder not found, retrying in the background");
+    }
+    else if (state == SensorProbe::GAVE_UP)
+    {
+        Serial.println("Rotary encoder not found, giving up");
+        powerOff();
+    }
+}
 
 void setup()
 {
     pinMode(PWR_SW_PIN, OUTPUT);
     digitalWrite(PWR_SW_PIN, HIGH); // Set PWR_SW_PIN high to keep the device on
+    bootTimeline.mark(BOOT_SETUP, systemClock.nowMs());
+
+    // The BLE stack takes longest to come up, it runs on the other core while
+    // the rest of setup() continues. The vendor services read the config.
+    loadConfig();
+    loadCalibration();
+    bleMouse.begin();
+    startReporter();
 
     Serial.begin(115200);
 
     Serial.println("Scroll Wheel version " FIRMWARE_VERSION);
     Serial.println("Initializing...");
 
-    bleMouse.begin();
-
     pinMode(BATTERY_SENSE_PIN, INPUT);
     pinMode(POWER_SENSE_PIN, INPUT);
     pinMode(CHARGE_STATE_SENSE_PIN, INPUT);
     analogReadResolution(12);
+    startBatteryTask();
 
     Wire.begin(22, 21);
 
-    if (!encoder.begin())
-    {
-        Serial.println("Rotary encoder not found!");
-        while (1)
-            ;
-    }
+    sensorProbe.reset(systemClock.nowMs());
+    pollSensor();
+
     Serial.println("Scroll Wheel ready, waiting for client...");
 }
 
 void loop()
 {
-    if (bleMouse.isConnected() && (millis() - lastScrollUpdate >= SCROLL_UPDATE_INTERVAL))
+    // Scrolling is handled by the sampler and reporter tasks
+    if (sensorProbe.getState() == SensorProbe::WAITING)
     {
-        lastScrollUpdate = millis();
-        int value = getScrollValue();
-
-        if (value != 0)
-        {
-            bleMouse.move(0, 0, value); // Send scroll value to BLE mouse
-        }
+        pollSensor();
     }
+    handleConsole();
     delay(LOOP_SLEEP_TIME);
-}
\ No newline at end of file
+}
@@ -0,0 +1,636 @@
+#include <chrono>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "angle-tracker.h"
+#include "battery.h"
+#include "boot-sequence.h"
+#include "calibration.h"
+#include "config.h"
+#include "defaults.h"
+#include "fakes.h"
+#include "legacy-pipeline.h"
+#include "noise-filter.h"
+#include "power-manager.h"
+#include "power-source.h"
+#include "report-coalescer.h"
+#include "rotary-sensor.h"
+#include "sampler.h"
+#include "scroll-accel.h"
+#include "scroll-math.h"
+#include "sensor-channels.h"
+#include "spsc-queue.h"
+#include "trace.h"
+#include "wheel-mode.h"
+
+// Benchmark runner for the native environment: per-stage cost of the scroll
+// pipeline and the simulated latency from first motion to the first report.
+
+static const size_t SAMPLES = 1000000;
+static const uint8_t HIRES_MULTIPLIER = 120; // WHEEL_HIRES_MULTIPLIER, BleMouse.h is ESP32 only
+static volatile int64_t sink; // Keeps results alive past the optimizer
+
+// Angle trace at SAMPLE_RATE_HZ for a wheel turning at the given speed, with +-1 count of noise
+static std::vector<int16_t> makeTrace(double degreesPerSecond, size_t samples)
+{
+    std::vector<int16_t> trace(samples);
+    double position = 0;
+    double step = degreesToCounts(degreesPerSecond) / SAMPLE_RATE_HZ;
+    for (size_t i = 0; i < samples; i++)
+    {
+        position += step;
+        int32_t count = (int32_t)position + (rand() % 3) - 1;
+        trace[i] = ((count % ENCODER_COUNTS) + ENCODER_COUNTS) % ENCODER_COUNTS;
+    }
+    return trace;
+}
+
+// Time stamp counter of the host, 0 where there is none
+static uint64_t hostCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+template <typename Stage>
+static void runStage(const char *name, Stage stage)
+{
+    uint64_t startCycles = hostCycles();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        stage(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double cycles = (double)(hostCycles() - startCycles) / SAMPLES;
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    printf("  %-16s %8.2f ns/sample %8.1f cycles/sample\n", name, ns / SAMPLES, cycles);
+}
+
+static void benchStages()
+{
+    std::vector<int16_t> angles = makeTrace(90, SAMPLES);
+
+    printf("Per-stage cost (%zu samples)\n", SAMPLES);
+
+    NoiseFilter filter;
+    runStage("noise filter", [&](size_t i) {
+        int16_t diff = wrapCounts(angles[i] - angles[i == 0 ? 0 : i - 1]);
+        filter.track(diff);
+        sink += filter.isMotion(diff);
+    });
+
+    CalibrationTable table = identityCalibration();
+    for (int i = 0; i < CALIBRATION_POINTS; i++)
+    {
+        table.offset[i] = (i * 37) % 64 - 32;
+    }
+    runStage("linearity", [&](size_t i) {
+        sink += correctAngle(table, angles[i]);
+    });
+
+    runStage("accel gain", [&](size_t i) {
+        sink += getAccelGain(i & 0xFF, ACCEL_SIGMOID);
+    });
+
+    FakeAngleSensor sensor;
+    sensor.trace = &angles;
+    RotarySensor rotary(sensor);
+    runStage("rotary sensor", [&](size_t i) {
+        sink += rotary.getScrollValue(HIRES_MULTIPLIER);
+    });
+
+    static TraceBuffer trace(TRACE_STREAM_SAMPLES);
+    trace.start();
+    runStage("trace", [&](size_t i) {
+        trace.addSample(i * 1000, angles[i], i & 0x10 ? 0 : 3);
+    });
+
+    FakeReportSink reports;
+    ReportCoalescer coalescer(reports);
+    runStage("coalescer", [&](size_t i) {
+        coalescer.add((int32_t)(i & 0x3FF) - 512);
+        reports.credits = 4;
+        reports.reports.clear();
+        coalescer.flush();
+    });
+}
+
+// The float degree pipeline the firmware started with against the same steps
+// in counts and the full pipeline of today. The host has a hardware FPU, on
+// the ESP32 the double literals of the old code run in software.
+static void benchLegacy()
+{
+    std::vector<int16_t> angles = makeTrace(90, SAMPLES);
+
+    printf("Old against new scroll math (%zu samples)\n", SAMPLES);
+    LegacyFloatPipeline legacy;
+    runStage("float degrees", [&](size_t i) {
+        sink += legacy.scrollValue(angles[i]);
+    });
+
+    CountPipeline counts;
+    runStage("counts", [&](size_t i) {
+        sink += counts.scrollValue(angles[i], HIRES_MULTIPLIER);
+    });
+
+    FakeAngleSensor sensor;
+    sensor.trace = &angles;
+    RotarySensor rotary(sensor);
+    runStage("full pipeline", [&](size_t i) {
+        sink += rotary.getScrollValue(HIRES_MULTIPLIER);
+    });
+}
+
+// Sampler to reporter queue: one sample through at a time, as while scrolling
+// slowly, and bursts of 16, as when the reporter waits on a notify
+static void benchQueue()
+{
+    static SpscQueue<ScrollSample, SAMPLE_QUEUE_SIZE> queue;
+    ScrollSample sample = {0, 0, 0, 0};
+
+    printf("Sample queue (%d slots, %zu byte samples)\n", SAMPLE_QUEUE_SIZE, sizeof(ScrollSample));
+    runStage("push and pop", [&](size_t i) {
+        sample.timestamp = i;
+        queue.push(sample);
+        queue.pop(sample);
+        sink += sample.timestamp;
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < SAMPLES; i += 16)
+    {
+        for (size_t j = 0; j < 16; j++)
+        {
+            sample.timestamp = i + j;
+            queue.push(sample);
+        }
+        while (queue.pop(sample))
+        {
+            sink += sample.timestamp;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    printf("  %-16s %8.2f ns/sample, %.0f M samples/s\n", "bursts of 16", ns / SAMPLES, SAMPLES * 1000.0 / ns);
+}
+
+// Time from the first motion to the connection event that carries the first report
+static void benchLatency(double degreesPerSecond)
+{
+    const uint32_t samplePeriod = 1000000 / SAMPLE_RATE_HZ;
+    const uint32_t eventPeriod = CONN_FAST_MIN_INTERVAL * 1250;
+    const int runs = 1000;
+
+    uint64_t total = 0;
+    uint64_t worst = 0;
+
+    for (int run = 0; run < runs; run++)
+    {
+        FakeClock clock;
+        FakeAngleSensor sensor;
+        FakeReportSink reports;
+        RotarySensor rotary(sensor);
+        ReportCoalescer coalescer(reports);
+
+        // Let the noise floor settle on a resting wheel
+        for (int i = 0; i < 1000; i++)
+        {
+            rotary.getScrollValue(HIRES_MULTIPLIER);
+        }
+
+        // Start moving at a random phase against the sampler and the connection events
+        uint64_t motionStart = rand() % samplePeriod;
+        uint64_t nextSample = samplePeriod;
+        uint64_t nextEvent = rand() % eventPeriod;
+        double position = 0;
+
+        while (reports.reports.empty())
+        {
+            if (nextSample <= nextEvent)
+            {
+                clock.us = nextSample;
+                nextSample += samplePeriod;
+                if (clock.us > motionStart)
+                {
+                    position = degreesToCounts(degreesPerSecond) * (clock.us - motionStart) / 1e6;
+                }
+                sensor.angle = (int16_t)position % ENCODER_COUNTS;
+                coalescer.add(rotary.getScrollValue(HIRES_MULTIPLIER));
+            }
+            else
+            {
+                clock.us = nextEvent;
+                nextEvent += eventPeriod;
+                reports.credits = 4;
+                coalescer.flush();
+            }
+        }
+
+        uint64_t latency = clock.us - motionStart;
+        total += latency;
+        worst = latency > worst ? latency : worst;
+    }
+
+    printf("  %6.0f deg/s     avg %6.2f ms, max %6.2f ms\n", degreesPerSecond, total / 1000.0 / runs, worst / 1000.0);
+}
+
+// A flick: the finger speeds the wheel up within 60 ms, then the bearing lets it
+// run down with a 2 s time constant. Returns false if unwrapping lost or gained
+// half a turn anywhere or ran backwards.
+static bool flickSurvives(double peakDegreesPerSecond, uint32_t rate, bool predictive)
+{
+    const double rampTime = 0.06;
+    const double decayTime = 2.0;
+    AngleTracker tracker;
+    tracker.setSampleRate(rate);
+    int64_t naive = 0;
+    int16_t angleBefore = 0;
+    double position = ENCODER_COUNTS / 4; // Clear of the wrap, noise on the first angle would read as a turn
+    double before = position;
+    for (uint32_t i = 0; i <= rate * 3; i++)
+    {
+        double t = (double)i / rate;
+        double speed = t < rampTime ? peakDegreesPerSecond * t / rampTime
+                                    : peakDegreesPerSecond * exp(-(t - rampTime) / decayTime);
+        position += degreesToCounts(speed) / rate;
+        int16_t angle = ((int64_t)llround(position) + (rand() % 3) - 1) & (ENCODER_COUNTS - 1);
+
+        int64_t unwrapped;
+        if (predictive)
+        {
+            unwrapped = tracker.update(angle);
+        }
+        else
+        {
+            naive += i == 0 ? angle : wrapCounts(angle - angleBefore);
+            unwrapped = naive;
+        }
+        angleBefore = angle;
+
+        if (i > 0 && (llabs(unwrapped - (int64_t)llround(position)) > ENCODER_COUNTS / 2 || unwrapped < before - 2))
+        {
+            return false;
+        }
+        before = unwrapped;
+    }
+    return true;
+}
+
+// Fastest flick that still unwraps correctly, in steps of 10 %
+static void benchUnwrap(uint32_t rate)
+{
+    double limits[2];
+    for (int predictive = 0; predictive < 2; predictive++)
+    {
+        double speed = 1000;
+        while (speed < 1e7 && flickSurvives(speed * 1.1, rate, predictive) && flickSurvives(speed * 1.1, rate, predictive))
+        {
+            speed *= 1.1;
+        }
+        limits[predictive] = speed;
+    }
+    printf("  %4u Hz  last to neighbour up to %8.0f deg/s, predictive up to %8.0f deg/s (%.1fx)\n", rate, limits[0],
+           limits[1], limits[1] / limits[0]);
+}
+
+// Recorded motion through one mode: a full turn forward at 90 deg/s, a 5
+// degree wiggle, half a turn back, then 45 degrees forward held for a second.
+// Prints what each phase sent: steps, key taps or shuttle pan.
+static void benchMode(WheelMode mode)
+{
+    ScrollConfig config = defaultConfig();
+    config.wheelMode = mode;
+    publishConfig(config);
+
+    FakeAngleSensor sensor;
+    RotarySensor rotary(sensor);
+    FakeReportSink reports;
+    reports.credits = INT32_MAX;
+    ReportCoalescer coalescer(reports, mode == WHEEL_MODE_KEYS ? 1 : 32767);
+    double position = ENCODER_COUNTS / 4;
+    sensor.angle = position;
+    for (int i = 0; i < 1000; i++)
+    {
+        rotary.getScrollValue(1);
+    }
+
+    const double phases[][2] = {{360, 4}, {5, 0.5}, {-5, 0.5}, {-180, 2}, {45, 1}, {0, 1}};
+    int64_t sent[6];
+    for (int phase = 0; phase < 6; phase++)
+    {
+        size_t before = reports.reports.size();
+        int samples = phases[phase][1] * SAMPLE_RATE_HZ;
+        double step = degreesToCounts(phases[phase][0]) / samples;
+        for (int i = 0; i < samples; i++)
+        {
+            position += step;
+            sensor.angle = ((int64_t)llround(position) + (rand() % 3) - 1) & (ENCODER_COUNTS - 1);
+            coalescer.add(rotary.getScrollValue(1));
+            coalescer.flush();
+        }
+        sent[phase] = 0;
+        for (size_t i = before; i < reports.reports.size(); i++)
+        {
+            sent[phase] += reports.reports[i];
+        }
+    }
+    printf("  mode %u  turn %5lld, wiggle %3lld/%3lld, back %5lld, 45 deg %5lld, held %5lld, %u reports\n", (unsigned)mode,
+           (long long)sent[0], (long long)sent[1], (long long)sent[2], (long long)sent[3], (long long)sent[4],
+           (long long)sent[5], coalescer.getReports());
+    publishConfig(defaultConfig());
+}
+
+// Raw angle of a sensor mounted off centre over a 7 magnet wheel: a once per
+// turn error from the eccentric mount plus a ripple at the magnet pitch
+static double distortedAngle(double counts, double eccentric, double ripple)
+{
+    double turn = counts * 2 * M_PI / ENCODER_COUNTS;
+    return counts + eccentric * sin(turn + 0.7) + ripple * sin(7 * turn);
+}
+
+// Largest deviation from a uniform angle over one turn, the constant phase removed
+static double peakError(double eccentric, double ripple, const CalibrationTable *table)
+{
+    const int steps = ENCODER_COUNTS * 4;
+    std::vector<double> errors(steps);
+    double mean = 0;
+    for (int i = 0; i < steps; i++)
+    {
+        double counts = i / 4.0;
+        int16_t raw = (int32_t)lround(distortedAngle(counts, eccentric, ripple)) & (ENCODER_COUNTS - 1);
+        int16_t angle = table != nullptr ? correctAngle(*table, raw) : raw;
+        double error = remainder(angle - counts, ENCODER_COUNTS);
+        errors[i] = error;
+        mean += error / steps;
+    }
+    double peak = 0;
+    for (double error : errors)
+    {
+        peak = fmax(peak, fabs(remainder(error - mean, ENCODER_COUNTS)));
+    }
+    return peak;
+}
+
+// Steady spin with +-2 % speed wobble and +-1 count of noise through the fitter
+static void benchCalibration(double eccentric, double ripple)
+{
+    CalibrationFitter fitter;
+    double position = 0;
+    double step = degreesToCounts(180) / SAMPLE_RATE_HZ;
+    size_t samples = 0;
+    while (fitter.getRevolutions() < CALIBRATION_REVOLUTIONS && samples < 100 * (size_t)SAMPLE_RATE_HZ)
+    {
+        position += step * (1 + 0.02 * sin(samples * 2 * M_PI / 3000));
+        int32_t raw = (int32_t)lround(distortedAngle(position, eccentric, ripple)) + (rand() % 3) - 1;
+        fitter.addSample(raw & (ENCODER_COUNTS - 1));
+        samples++;
+    }
+
+    CalibrationTable table;
+    if (!fitter.fit(table))
+    {
+        printf("  %4.0f/%-4.0f counts: peak error %5.2f, no table, %.1f s, %u turns rejected\n", eccentric, ripple,
+               peakError(eccentric, ripple, nullptr), (double)samples / SAMPLE_RATE_HZ, fitter.getRejected());
+        return;
+    }
+    printf("  %4.0f/%-4.0f counts: peak error %5.2f -> %4.2f counts, %.1f s, %u turns rejected\n", eccentric, ripple,
+           peakError(eccentric, ripple, nullptr), peakError(eccentric, ripple, &table),
+           (double)samples / SAMPLE_RATE_HZ, fitter.getRejected());
+}
+
+// Pack discharging linearly from 4.2 V to 3.0 V with ADC noise and a load dip every
+// 100 updates, the reported level should only ever step down
+static void benchBattery()
+{
+    const int updates = 2000;
+
+    FakeAdc adc;
+    adc.noise = 40;
+    BatteryMonitor monitor(adc);
+
+    int changes = 0;
+    int rises = 0;
+    uint8_t previous = 100;
+    for (int i = 0; i <= updates; i++)
+    {
+        adc.millivolts = 4200 - 1200 * i / updates - (i % 100 < 3 ? 80 : 0);
+        if (monitor.update())
+        {
+            changes++;
+            rises += monitor.getLevel() > previous;
+            previous = monitor.getLevel();
+        }
+    }
+
+    printf("Battery estimator (%d updates, 4.2 V to 3.0 V)\n", updates);
+    printf("  %d level changes, %d rises, final %u %% at %u mV\n", changes, rises, monitor.getLevel(), monitor.getMillivolts());
+}
+
+// Simulated sense pins over a minute with the wheel at rest: boot on battery,
+// a bouncing plug-in at 10 s with the charger starting a second later, unplug
+// at 40 s. The charger pin floats at random while on battery. The power
+// manager and connection policy run as the sampler and reporter drive them.
+static void benchPowerProfile()
+{
+    PowerSource source;
+    PowerManager power;
+    FakeLinkControl link;
+    ConnParamPolicy connection(link);
+    source.reset(0, false, false);
+    power.reset(0);
+    connection.onConnect(0);
+
+    uint32_t idleTime[3] = {0, 0, 0};     // Per phase: battery, USB, battery again
+    uint32_t switchTime[2] = {0, 0};      // Plug and unplug to profile change
+    uint32_t chargingTime = 0;
+    uint32_t fastRequests[3] = {0, 0, 0}; // Connection requests per phase, fast ones
+    uint32_t idleRequests[3] = {0, 0, 0};
+    bool falseCharging = false;
+    for (uint32_t now = 0; now < 60000; now++)
+    {
+        int phase = now < 10000 ? 0 : now < 40000 ? 1 : 2;
+        bool usb = phase == 1;
+        if ((now >= 10000 && now < 10200) || (now >= 40000 && now < 40100))
+        {
+            usb = (now / 20) % 2 == 0; // Contact bounce
+        }
+        bool charge = phase == 1 ? now >= 11000 : rand() % 2 == 0;
+
+        if (now % POWER_SENSE_INTERVAL == 0 && source.update(now, usb, charge))
+        {
+            bool performance = source.getProfile() == POWER_PROFILE_USB;
+            power.setHoldActive(performance);
+            connection.setHoldFast(performance);
+            switchTime[performance ? 0 : 1] = now - (performance ? 10000 : 40000);
+        }
+        falseCharging |= (phase == 0 || now >= 41000) && source.isCharging(); // After a second on battery
+        chargingTime += source.isCharging();
+
+        power.update(now, false);
+        idleTime[phase] += power.getState() == PowerManager::IDLE;
+
+        size_t requests = link.requests.size();
+        if (now % CONN_UPDATE_INTERVAL == 0)
+        {
+            connection.update(now);
+        }
+        if (link.requests.size() != requests)
+        {
+            bool fast = link.requests.back().minInterval == CONN_FAST_MIN_INTERVAL;
+            (fast ? fastRequests : idleRequests)[phase]++;
+        }
+    }
+
+    printf("Power profile (sense every %u ms, %u ms debounce, at rest)\n", POWER_SENSE_INTERVAL, POWER_SENSE_DEBOUNCE);
+    printf("  %u switches, USB after %u ms, battery after %u ms, charging %u ms%s\n", source.getSwitches(),
+           switchTime[0], switchTime[1], chargingTime, falseCharging ? ", CHARGING ON BATTERY" : "");
+    const char *names[3] = {"battery", "usb", "battery"};
+    for (int phase = 0; phase < 3; phase++)
+    {
+        printf("  %-8s idle %5u ms, %u fast and %u idle connection requests\n", names[phase], idleTime[phase],
+               fastRequests[phase], idleRequests[phase]);
+    }
+}
+
+// The main loop polling the probe every LOOP_SLEEP_TIME, with an encoder
+// that answers after the given number of failed probes (-1 never answers)
+static void benchBoot(int missingBegins)
+{
+    FakeAngleSensor sensor;
+    sensor.missingBegins = missingBegins;
+    BootTimeline timeline;
+    SensorProbe probe(sensor, timeline);
+    probe.reset(0);
+
+    uint32_t now = 0;
+    uint32_t loops = 0;
+    while (probe.poll(now) == SensorProbe::WAITING && now < 10 * SENSOR_GIVE_UP_TIME)
+    {
+        now += LOOP_SLEEP_TIME;
+        loops++;
+    }
+
+    if (probe.getState() == SensorProbe::READY)
+    {
+        printf("  %2d misses  sensor after %5u ms, %3u probes over %5u loop passes\n", missingBegins,
+               timeline.get(BOOT_SENSOR), probe.getAttempts(), loops);
+    }
+    else
+    {
+        printf("  %2d misses  %s after %5u ms, %3u probes\n", missingBegins,
+               probe.getState() == SensorProbe::GAVE_UP ? "gave up" : "still waiting", now, probe.getAttempts());
+    }
+}
+
+// Several encoders read back to back every tick, each read taking the given
+// bus time. Channel 1 (pan) turns at 180 deg/s while the others hold still
+// with +-1 count of noise, so the wheel has to stay at 0 while pan counts.
+static bool benchChannels(uint8_t count, uint32_t readCostUs)
+{
+    const uint32_t samplePeriod = 1000000 / SAMPLE_RATE_HZ;
+    const int samples = 2 * SAMPLE_RATE_HZ;
+
+    FakeClock clock;
+    FakeAngleSensor sensors[MAX_SENSOR_CHANNELS];
+    std::vector<RotarySensor> rotaries;
+    rotaries.reserve(count);
+    SensorChannels channels(clock);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        sensors[i].clock = &clock;
+        sensors[i].readCostUs = readCostUs;
+        sensors[i].angle = ENCODER_COUNTS / 4;
+        rotaries.emplace_back(sensors[i]);
+        channels.add(rotaries[i], i % 2 == 0 ? CHANNEL_WHEEL : CHANNEL_PAN);
+    }
+
+    double position = ENCODER_COUNTS / 4;
+    double step = degreesToCounts(180) / SAMPLE_RATE_HZ;
+    int64_t wheelTotal = 0;
+    int64_t panTotal = 0;
+    for (int i = 0; i < samples; i++)
+    {
+        clock.us = (uint64_t)i * samplePeriod;
+        position += step;
+        for (uint8_t c = 0; c < count; c++)
+        {
+            int32_t base = c == 1 ? (int32_t)llround(position) : ENCODER_COUNTS / 4;
+            sensors[c].angle = (base + (rand() % 3) - 1) & (ENCODER_COUNTS - 1);
+        }
+        int32_t wheel;
+        int32_t pan;
+        channels.sample(1, wheel, pan);
+        wheelTotal += wheel;
+        panTotal += pan;
+    }
+
+    uint32_t jitter = 0;
+    for (uint8_t c = 0; c < count; c++)
+    {
+        jitter = channels.getOffsetJitter(c) > jitter ? channels.getOffsetJitter(c) : jitter;
+    }
+    bool fits = channels.getMaxTickTime() <= samplePeriod;
+    printf("  %u channels %3u us reads  longest tick %4u us (%s), offset jitter %3u us, wheel %lld, pan %lld\n", count,
+           readCostUs, channels.getMaxTickTime(), fits ? "fits" : "OVER BUDGET", jitter, (long long)wheelTotal,
+           (long long)panTotal);
+    return fits;
+}
+
+int main()
+{
+    srand(1);
+    benchStages();
+    benchLegacy();
+    benchQueue();
+
+    printf("Simulated first motion to report latency (%d Hz sampling, %.2f ms interval)\n",
+           SAMPLE_RATE_HZ, CONN_FAST_MIN_INTERVAL * 1.25);
+    benchLatency(30);
+    benchLatency(90);
+    benchLatency(360);
+
+    printf("Flick unwrapping, 60 ms spin-up and 2 s run-down with +-1 count noise\n");
+    benchUnwrap(10);
+    benchUnwrap(POWER_IDLE_RATE_HZ);
+    benchUnwrap(SAMPLE_RATE_HZ);
+
+    printf("Linearity calibration (%d knots, %d turns at 180 deg/s), eccentric/ripple amplitude\n",
+           CALIBRATION_POINTS, CALIBRATION_REVOLUTIONS);
+    benchCalibration(0, 0);
+    benchCalibration(40, 0);
+    benchCalibration(0, 12);
+    benchCalibration(40, 12);
+
+    printf("Wheel modes (%d steps per turn, scroll units, jog steps, shuttle pan, key taps)\n", MODE_STEPS);
+    benchMode(WHEEL_MODE_SCROLL);
+    benchMode(WHEEL_MODE_JOG);
+    benchMode(WHEEL_MODE_SHUTTLE);
+    benchMode(WHEEL_MODE_KEYS);
+
+    benchBattery();
+    benchPowerProfile();
+
+    printf("Encoder probe (%u ms retry, give up after %u ms)\n", SENSOR_RETRY_INTERVAL, SENSOR_GIVE_UP_TIME);
+    benchBoot(0);
+    benchBoot(3);
+    benchBoot(-1);
+
+    printf("Sensor channels (%u us sample period, pan at 180 deg/s for 2 s, wheel held)\n", 1000000 / SAMPLE_RATE_HZ);
+    bool fits = benchChannels(1, 110);
+    fits &= benchChannels(2, 110);
+    fits &= benchChannels(4, 110);
+    fits &= benchChannels(3, 200);
+    if (!fits)
+    {
+        printf("Sensor channels over the sample period\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+#ifndef NATIVE_FAKES_H
+#define NATIVE_FAKES_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "conn-params.h"
+#include "hal.h"
+#include "report-coalescer.h"
+
+// Stand-ins for the ESP32 backends so the firmware core runs on Linux
+
+class FakeClock : public Clock
+{
+public:
+    uint64_t us = 0;
+
+    void advanceUs(uint32_t delta) { us += delta; }
+    uint32_t nowMs() { return us / 1000; }
+    uint32_t nowUs() { return us; }
+    uint32_t cycles() { return us * 240; } // ESP32 at 240 MHz
+};
+
+// Returns a preset angle, or walks through a recorded trace one sample per read
+class FakeAngleSensor : public AngleSensor
+{
+public:
+    int16_t angle = 0;
+    const std::vector<int16_t> *trace = nullptr;
+    size_t position = 0;
+    SignalQuality quality = {true, false, 64, 2000};
+    SensorPowerMode powerMode = SENSOR_POWER_NOMINAL;
+    int missingBegins = 0; // begin() calls that fail before the sensor answers, -1 for never
+    FakeClock *clock = nullptr;
+    uint32_t readCostUs = 0; // Bus time every read takes off the clock
+    uint32_t qualityReads = 0;
+
+    bool begin()
+    {
+        if (missingBegins == 0)
+        {
+            return true;
+        }
+        missingBegins -= missingBegins > 0;
+        return false;
+    }
+
+    int16_t readAngle()
+    {
+        spend();
+        if (trace != nullptr && !trace->empty())
+        {
+            angle = (*trace)[position];
+            position = (position + 1) % trace->size();
+        }
+        return angle;
+    }
+
+    SignalQuality readSignalQuality()
+    {
+        spend();
+        qualityReads++;
+        return quality;
+    }
+    void setPowerMode(SensorPowerMode mode) { powerMode = mode; }
+
+private:
+    void spend()
+    {
+        if (clock != nullptr)
+        {
+            clock->advanceUs(readCostUs);
+        }
+    }
+};
+
+class FakeAdc : public AdcInput
+{
+public:
+    uint32_t millivolts = 0;
+    uint32_t noise = 0; // Uniform noise of +-noise mV on every reading
+
+    uint32_t readMillivolts() { return millivolts + (noise ? rand() % (2 * noise + 1) - noise : 0); }
+};
+
+// HID characteristic with a limited number of packets per connection event
+class FakeReportSink : public ReportSink
+{
+public:
+    int credits = 4;
+    bool congested = false;
+    std::vector<int16_t> reports;
+
+    bool canSend() { return !congested && credits > 0; }
+
+    void sendWheel(int16_t wheel)
+    {
+        credits--;
+        reports.push_back(wheel);
+    }
+};
+
+class FakeLinkControl : public BleLinkControl
+{
+public:
+    bool accept = true;
+    std::vector<ConnParams> requests;
+
+    bool requestConnParams(const ConnParams &params)
+    {
+        requests.push_back(params);
+        return accept;
+    }
+};
+
+#endif
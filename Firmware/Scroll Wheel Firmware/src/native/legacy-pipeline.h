@@ -0,0 +1,77 @@
+#ifndef NATIVE_LEGACY_PIPELINE_H
+#define NATIVE_LEGACY_PIPELINE_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include "defaults.h"
+#include "scroll-math.h"
+
+// The scroll math before it moved to encoder counts, kept as the reference
+// for the equivalence tests and the old against new benchmark.
+
+// Float degrees with the 380 sentinel, as getScrollValue() did it
+class LegacyFloatPipeline
+{
+public:
+    int scrollValue(int rawAngle)
+    {
+        float angleDeg = rawAngle * 360.0 / 4096.0;
+        if (_angleBefore == 380.0)
+        {
+            _angleBefore = angleDeg;
+        }
+
+        float angleDiff = angleDeg - _angleBefore;
+        if (fabs(angleDiff) < JITTER_THRESHOLD)
+        {
+            return 0;
+        }
+        if (angleDiff > MAX_ROTATION_PER_READ)
+        {
+            angleDiff -= 360.0;
+        }
+        else if (angleDiff < -MAX_ROTATION_PER_READ)
+        {
+            angleDiff += 360.0;
+        }
+        _angleBefore = angleDeg;
+        return round(angleDiff * SCROLL_MULTIPLICATOR);
+    }
+
+private:
+    float _angleBefore = 380.0;
+};
+
+// The same steps in counts with the Q12 remainder, before the noise filter,
+// acceleration and inertia stages were added
+class CountPipeline
+{
+public:
+    int32_t scrollValue(int16_t rawAngle, uint8_t multiplier)
+    {
+        if (_countBefore < 0)
+        {
+            _countBefore = rawAngle;
+        }
+
+        int16_t countDiff = rawAngle - _countBefore;
+        if (countDiff > -JITTER_COUNTS && countDiff < JITTER_COUNTS)
+        {
+            return 0;
+        }
+        countDiff = wrapCounts(countDiff);
+        _countBefore = rawAngle;
+
+        _remainder += countDiff * SCROLL_GAIN_Q12 * multiplier;
+        int32_t value = _remainder / SCROLL_ONE;
+        _remainder -= value * SCROLL_ONE;
+        return value;
+    }
+
+private:
+    int16_t _countBefore = -1;
+    int32_t _remainder = 0;
+};
+
+#endif
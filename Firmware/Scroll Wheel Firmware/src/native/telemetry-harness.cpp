@@ -0,0 +1,274 @@
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "telemetry.h"
+
+// Round trip, fuzz and throughput runs for the telemetry encoder and decoder.
+//   program [rounds] [seed]
+
+static const uint16_t SAMPLE_PERIOD = 1000;
+
+struct Expected
+{
+    TelemetryType type;
+    uint32_t timestamp;
+    int16_t angle;
+    uint8_t level;
+    uint16_t millivolts;
+    uint32_t stat;
+};
+
+static int failures = 0;
+
+static void check(bool condition, const char *what, int round)
+{
+    if (!condition && failures++ < 10)
+    {
+        printf("  FAIL round %d: %s\n", round, what);
+    }
+}
+
+// Wheel at a random speed with timing jitter, gaps and now and then a status
+// pair, encoded as the firmware does it: batches of samples, flushed and sent
+// in notification sized pieces
+static std::vector<uint8_t> makeStream(std::vector<Expected> &expected, size_t samples, size_t mtu)
+{
+    static uint8_t buffer[1024];
+    TelemetryEncoder encoder(buffer, sizeof(buffer), SAMPLE_PERIOD);
+    std::vector<uint8_t> stream;
+
+    uint32_t time = rand();
+    int32_t angle = rand() % 4096;
+    int32_t speed = rand() % 41 - 20;
+    for (size_t i = 0; i < samples; i++)
+    {
+        time += SAMPLE_PERIOD + rand() % 21 - 10 + (rand() % 500 == 0 ? rand() % 100000 : 0);
+        if (rand() % 200 == 0)
+        {
+            speed = rand() % 401 - 200;
+        }
+        angle = (angle + speed + rand() % 3 - 1) & 4095;
+        if (rand() % 1000 == 0)
+        {
+            angle = rand() % 4096; // Far jump, as after a long stall
+        }
+
+        if (encoder.addSample(time, angle))
+        {
+            expected.push_back({TELEMETRY_SAMPLES, time, (int16_t)angle, 0, 0, 0});
+        }
+
+        if (i % 20 == 19)
+        {
+            encoder.flush();
+            if (rand() % 10 == 0)
+            {
+                uint8_t level = rand() % 101;
+                uint16_t millivolts = 3000 + rand() % 1200;
+                uint32_t stats[TELEMETRY_STAT_COUNT] = {(uint32_t)rand(), 0, 7, (uint32_t)i};
+                if (encoder.addBattery(level, millivolts, TELEMETRY_POWER_USB))
+                {
+                    expected.push_back({TELEMETRY_BATTERY, 0, 0, level, millivolts, 0});
+                }
+                if (encoder.addStats(stats, TELEMETRY_STAT_COUNT))
+                {
+                    expected.push_back({TELEMETRY_STATS, 0, 0, 0, 0, stats[0]});
+                }
+            }
+            while (encoder.ready() > 0)
+            {
+                size_t length = encoder.ready() < mtu ? encoder.ready() : mtu;
+                stream.insert(stream.end(), encoder.data(), encoder.data() + length);
+                encoder.consume(length);
+            }
+        }
+    }
+    encoder.flush();
+    stream.insert(stream.end(), encoder.data(), encoder.data() + encoder.ready());
+    return stream;
+}
+
+// Feeds the stream in random pieces, as notifications of changing size would arrive
+static void decodeStream(const std::vector<uint8_t> &stream, size_t maxPiece, std::vector<TelemetryEvent> &events,
+                         TelemetryDecoder &decoder)
+{
+    size_t position = 0;
+    while (position < stream.size())
+    {
+        size_t length = 1 + rand() % maxPiece;
+        if (length > stream.size() - position)
+        {
+            length = stream.size() - position;
+        }
+        std::vector<uint8_t> piece(stream.begin() + position, stream.begin() + position + length);
+        decoder.feed(piece.data(), piece.size());
+        TelemetryEvent event;
+        while (decoder.next(event))
+        {
+            events.push_back(event);
+        }
+        position += length;
+    }
+}
+
+static void roundTrip(int rounds)
+{
+    size_t events = 0;
+    size_t bytes = 0;
+    for (int round = 0; round < rounds; round++)
+    {
+        std::vector<Expected> expected;
+        std::vector<uint8_t> stream = makeStream(expected, 1 + rand() % 3000, 20 + rand() % 230);
+        std::vector<TelemetryEvent> decoded;
+        TelemetryDecoder decoder;
+        decodeStream(stream, 1 + rand() % 300, decoded, decoder);
+
+        check(decoded.size() == expected.size(), "event count", round);
+        check(decoder.getCrcErrors() == 0 && decoder.getSkipped() == 0 && decoder.getMalformed() == 0, "clean stream", round);
+        for (size_t i = 0; i < decoded.size() && i < expected.size(); i++)
+        {
+            const TelemetryEvent &event = decoded[i];
+            const Expected &want = expected[i];
+            bool match = event.type == want.type;
+            if (match && want.type == TELEMETRY_SAMPLES)
+            {
+                match = event.timestamp == want.timestamp && event.angle == want.angle;
+            }
+            else if (match && want.type == TELEMETRY_BATTERY)
+            {
+                match = event.level == want.level && event.millivolts == want.millivolts;
+            }
+            else if (match)
+            {
+                match = event.statCount == TELEMETRY_STAT_COUNT && event.stats[0] == want.stat;
+            }
+            check(match, "event mismatch", round);
+        }
+        events += expected.size();
+        bytes += stream.size();
+    }
+    printf("  round trip: %d streams, %zu events, %.2f bytes per event\n", rounds, events, (double)bytes / events);
+}
+
+// Flipped, dropped and inserted bytes must never crash the decoder, and it
+// has to pick up again on the frames after the damage
+static void corruption(int rounds)
+{
+    size_t expectedEvents = 0;
+    size_t decodedEvents = 0;
+    uint32_t crcErrors = 0;
+    for (int round = 0; round < rounds; round++)
+    {
+        std::vector<Expected> expected;
+        std::vector<uint8_t> stream = makeStream(expected, 2000, 244);
+        int damage = 1 + rand() % 8;
+        for (int i = 0; i < damage; i++)
+        {
+            size_t at = rand() % stream.size();
+            switch (rand() % 3)
+            {
+            case 0:
+                stream[at] ^= 1 << (rand() % 8);
+                break;
+            case 1:
+                stream.erase(stream.begin() + at, stream.begin() + at + std::min<size_t>(1 + rand() % 40, stream.size() - at));
+                break;
+            default:
+                stream.insert(stream.begin() + at, TELEMETRY_SYNC);
+                break;
+            }
+        }
+
+        std::vector<TelemetryEvent> decoded;
+        TelemetryDecoder decoder;
+        decodeStream(stream, 64, decoded, decoder);
+        expectedEvents += expected.size();
+        decodedEvents += decoded.size();
+        crcErrors += decoder.getCrcErrors();
+
+        // The last samples frame comes after the damage in most rounds
+        check(decoded.size() > expected.size() / 2, "no recovery", round);
+    }
+    printf("  corruption: %d streams, %.1f %% of events recovered, %u CRC errors\n", rounds,
+           100.0 * decodedEvents / expectedEvents, crcErrors);
+}
+
+static void garbage(int rounds)
+{
+    size_t events = 0;
+    for (int round = 0; round < rounds; round++)
+    {
+        std::vector<uint8_t> stream(1 + rand() % 4096);
+        for (uint8_t &byte : stream)
+        {
+            byte = rand() % 4 == 0 ? TELEMETRY_SYNC : rand();
+        }
+        std::vector<TelemetryEvent> decoded;
+        TelemetryDecoder decoder;
+        decodeStream(stream, 300, decoded, decoder);
+        events += decoded.size();
+    }
+    printf("  garbage: %d streams, %zu events passed the CRC\n", rounds, events);
+}
+
+static void throughput()
+{
+    std::vector<Expected> expected;
+    std::vector<uint8_t> stream = makeStream(expected, 1000000, 244);
+
+    auto start = std::chrono::steady_clock::now();
+    TelemetryDecoder decoder;
+    size_t events = 0;
+    for (size_t position = 0; position < stream.size(); position += 244)
+    {
+        decoder.feed(stream.data() + position, std::min<size_t>(244, stream.size() - position));
+        TelemetryEvent event;
+        while (decoder.next(event))
+        {
+            events++;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    check(events == expected.size(), "throughput event count", 0);
+    printf("  decode: %.1f MB/s, %.2f ns per event (244 byte notifications)\n", stream.size() * 1000.0 / ns, ns / events);
+
+    static uint8_t buffer[1024];
+    TelemetryEncoder encoder(buffer, sizeof(buffer), SAMPLE_PERIOD);
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        if (expected[i].type == TELEMETRY_SAMPLES && !encoder.addSample(expected[i].timestamp, expected[i].angle))
+        {
+            encoder.flush();
+            encoder.consume(encoder.ready());
+            encoder.addSample(expected[i].timestamp, expected[i].angle);
+        }
+    }
+    end = std::chrono::steady_clock::now();
+    ns = std::chrono::duration<double, std::nano>(end - start).count();
+    printf("  encode: %.2f ns per sample\n", ns / expected.size());
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 200;
+    srand(argc > 2 ? atoi(argv[2]) : 1);
+
+    printf("Telemetry protocol version %u\n", TELEMETRY_VERSION);
+    roundTrip(rounds);
+    corruption(rounds);
+    garbage(rounds);
+    throughput();
+
+    if (failures > 0)
+    {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
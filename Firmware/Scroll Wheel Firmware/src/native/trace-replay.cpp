@@ -0,0 +1,162 @@
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "fakes.h"
+#include "rotary-sensor.h"
+#include "config.h"
+#include "defaults.h"
+#include "trace.h"
+
+// Decodes a trace dump captured over serial and replays the recorded angles
+// through the same RotarySensor code the firmware runs. --mode replays the
+// recorded motion in another WheelMode, to see what jog, shuttle or keys make of it.
+//   program <capture> [--events] [--mode <n>]
+
+static bool readFile(const char *path, std::vector<uint8_t> &data)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    uint8_t buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        data.insert(data.end(), buffer, buffer + length);
+    }
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <capture> [--events] [--mode <n>]\n", argv[0]);
+        return 2;
+    }
+    bool printEvents = false;
+    int mode = -1;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--events") == 0)
+        {
+            printEvents = true;
+        }
+        else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc)
+        {
+            mode = atoi(argv[++i]);
+        }
+    }
+
+    std::vector<uint8_t> capture;
+    if (!readFile(argv[1], capture))
+    {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 1;
+    }
+
+    // The dump may be surrounded by regular serial log output
+    size_t start = 0;
+    while (start + 4 <= capture.size() && memcmp(&capture[start], "SWTR", 4) != 0)
+    {
+        start++;
+    }
+
+    TraceDecoder decoder(capture.data() + start, capture.size() - start);
+    TraceDumpHeader header;
+    if (!decoder.readHeader(header))
+    {
+        fprintf(stderr, "no trace dump found\n");
+        return 1;
+    }
+    printf("Trace v%u, %u us sample period, multiplier %u, gain %u, accel curve %u\n",
+           header.version, header.samplePeriod, header.multiplier, header.config.scrollGain, header.config.accelCurve);
+
+    std::vector<TraceEvent> samples;
+    std::vector<TraceEvent> reports;
+    TraceEvent event;
+    while (decoder.next(event))
+    {
+        if (printEvents)
+        {
+            printf("%u %10u %4d %6d\n", event.stream, event.timestamp, event.angle, event.value);
+        }
+        (event.stream == TRACE_STREAM_SAMPLES ? samples : reports).push_back(event);
+    }
+    if (samples.empty())
+    {
+        printf("No samples recorded\n");
+        return 0;
+    }
+
+    // Replay, the pipeline starts without the noise floor the device had learned,
+    // so early differences are expected
+    ScrollConfig config = header.config;
+    if (mode >= 0)
+    {
+        config.wheelMode = mode;
+    }
+    if (!publishConfig(config))
+    {
+        printf("Config in the dump is not valid, replaying with the defaults\n");
+    }
+    if (mode >= 0)
+    {
+        printf("Replaying in wheel mode %u, %u steps per turn\n", getConfig().wheelMode, getConfig().modeSteps);
+    }
+    FakeAngleSensor sensor;
+    RotarySensor rotary(sensor);
+    int64_t recorded = 0, replayed = 0;
+    size_t mismatches = 0;
+
+    // The sampler drops to POWER_IDLE_RATE_HZ while idle. A gap nearer the idle
+    // period than the recorded one marks a sample taken at the idle rate, which
+    // the pipeline has to know about just like on the device.
+    const uint32_t activeRate = header.samplePeriod ? 1000000 / header.samplePeriod : SAMPLE_RATE_HZ;
+    const uint32_t idleThreshold = (1000000 / activeRate + 1000000 / POWER_IDLE_RATE_HZ) / 2;
+    uint32_t rate = activeRate;
+    uint32_t lastTimestamp = samples.front().timestamp;
+    size_t idleSamples = 0;
+    rotary.setSampleRate(rate);
+
+    auto begin = std::chrono::steady_clock::now();
+    for (const TraceEvent &sample : samples)
+    {
+        uint32_t sampleRate = sample.timestamp - lastTimestamp > idleThreshold ? POWER_IDLE_RATE_HZ : activeRate;
+        lastTimestamp = sample.timestamp;
+        if (sampleRate != rate)
+        {
+            rate = sampleRate;
+            rotary.setSampleRate(rate);
+        }
+        idleSamples += rate == POWER_IDLE_RATE_HZ;
+
+        sensor.angle = sample.angle;
+        int32_t value = rotary.getScrollValue(header.multiplier);
+        recorded += sample.value;
+        replayed += value;
+        mismatches += value != sample.value;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+
+    int64_t sent = 0;
+    for (const TraceEvent &report : reports)
+    {
+        sent += report.value;
+    }
+
+    double seconds = (samples.back().timestamp - samples.front().timestamp) / 1e6;
+    printf("Samples:   %zu over %.2f s, %zu at the idle rate\n", samples.size(), seconds, idleSamples);
+    printf("Reports:   %zu, %lld units sent\n", reports.size(), (long long)sent);
+    printf("Recorded:  %lld units\n", (long long)recorded);
+    printf("Replayed:  %lld units, %zu samples differ\n", (long long)replayed, mismatches);
+    printf("Pipeline:  %.2f ns/sample\n", ns / samples.size());
+    return 0;
+}
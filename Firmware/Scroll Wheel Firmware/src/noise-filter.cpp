@@ -0,0 +1,151 @@
+#include <stdlib.h>
+
+#include "defaults.h"
+#include "noise-filter.h"
+
+constexpr int32_t toQ4(double degrees)
+{
+    return roundCounts(degreesToCounts(degrees) * (1 << NoiseFilter::Q));
+}
+
+constexpr int32_t BAND_MIN = toQ4(NOISE_BAND_MIN);
+constexpr int32_t BAND_MAX = toQ4(NOISE_BAND_MAX);
+constexpr int32_t BAND_START = toQ4(JITTER_THRESHOLD);
+constexpr int32_t REST_VELOCITY = 1 << (NoiseFilter::Q - 1); // Half a count per sample, above +-1 count of jitter
+
+constexpr int32_t ALPHA_Q8 = 128; // Position gain
+constexpr int32_t BETA_Q8 = 32;   // Velocity gain
+constexpr int NOISE_SHIFT = 5;    // Noise floor time constant of 32 samples
+
+static_assert(samplesFor(SAMPLE_RATE_HZ, NOISE_REST_TIME) < UINT16_MAX, "NOISE_REST_TIME too long for the sample rate");
+static_assert(BAND_MIN <= BAND_START && BAND_START <= BAND_MAX, "Noise band limits must bracket JITTER_THRESHOLD");
+
+NoiseFilter::NoiseFilter() : _sampleRate(SAMPLE_RATE_HZ), _bandMin(BAND_MIN), _bandMax(BAND_MAX), _bandGain(NOISE_BAND_GAIN)
+{
+    _restLimit = samplesFor(SAMPLE_RATE_HZ, NOISE_REST_TIME);
+    _holdLimit = samplesFor(SAMPLE_RATE_HZ, NOISE_MOVE_HOLD);
+    reset();
+}
+
+void NoiseFilter::setBand(int32_t min, int32_t max, uint8_t gain)
+{
+    _bandMin = min;
+    _bandMax = max;
+    _bandGain = gain;
+    if (!_noiseLearned)
+    {
+        _noiseSum = (BAND_START / _bandGain) << NOISE_SHIFT;
+    }
+}
+
+void NoiseFilter::setSampleRate(uint32_t rate)
+{
+    if (rate == 0 || rate == _sampleRate)
+    {
+        return;
+    }
+    _velocity = (int64_t)_velocity * _sampleRate / rate;
+    _sampleRate = rate;
+    _restLimit = samplesFor(rate, NOISE_REST_TIME);
+    _holdLimit = samplesFor(rate, NOISE_MOVE_HOLD);
+    _restSamples = _restSamples > _restLimit ? _restLimit : _restSamples;
+}
+
+void NoiseFilter::reset()
+{
+    _offset = 0;
+    _velocity = 0;
+    _noiseSum = (BAND_START / _bandGain) << NOISE_SHIFT;
+    _noiseLearned = false;
+    _qualityMargin = 0;
+    _restSamples = 0;
+    _holdSamples = 0;
+    _direction = 0;
+    _moving = false;
+}
+
+void NoiseFilter::track(int16_t sampleDiff)
+{
+    // Residual of the measurement against the predicted position
+    int32_t residual = _offset + ((int32_t)sampleDiff << Q) - _velocity;
+    // Rounded the same way in both directions, the velocity drives the accel gain
+    _offset = residual - (int32_t)roundShift(residual * ALPHA_Q8, 8);
+    _velocity += (int32_t)roundShift(residual * BETA_Q8, 8);
+
+    if (abs(_velocity) >= REST_VELOCITY)
+    {
+        _restSamples = 0;
+    }
+    else if (_restSamples < _restLimit)
+    {
+        _restSamples++;
+    }
+
+    // Only learn the noise floor while the wheel is resting. Jitter flipping
+    // back and forth past the band counts as rest, so the band grows over it.
+    if (_restSamples >= _restLimit)
+    {
+        // Kept as a running sum, a shifted difference would floor small noise away
+        _noiseSum += abs(residual) - noiseFloor();
+        _noiseLearned = true;
+    }
+}
+
+void NoiseFilter::setSignalQuality(bool magnetDetected, bool fieldOutOfRange, uint8_t agc, uint16_t magnitude)
+{
+    if (!magnetDetected)
+    {
+        _qualityMargin = _bandMax;
+        return;
+    }
+
+    // The AGC gain rises as the magnet moves away, so scale the margin with it
+    _qualityMargin = ((int32_t)agc * NOISE_AGC_MARGIN) >> 8;
+
+    if (fieldOutOfRange || magnitude < NOISE_MIN_MAGNITUDE)
+    {
+        _qualityMargin += _bandMax / 2;
+    }
+}
+
+int32_t NoiseFilter::noiseFloor() const
+{
+    return _noiseSum >> NOISE_SHIFT;
+}
+
+int32_t NoiseFilter::deadBand() const
+{
+    int32_t band = noiseFloor() * _bandGain + _qualityMargin;
+    if (band < _bandMin)
+    {
+        return _bandMin;
+    }
+    return band > _bandMax ? _bandMax : band;
+}
+
+bool NoiseFilter::isMotion(int16_t countDiff)
+{
+    if (_moving && ++_holdSamples > _holdLimit)
+    {
+        _moving = false;
+    }
+
+    // Keep following single count steps as long as the wheel turns the same way,
+    // turning back starts over like a wheel at rest
+    int32_t distance = abs((int32_t)countDiff) << Q;
+    int8_t direction = countDiff > 0 ? 1 : -1;
+    bool following = _moving && direction == _direction;
+    if (distance == 0 || (!following && distance <= deadBand()))
+    {
+        return false;
+    }
+
+    if (following)
+    {
+        _restSamples = 0;
+    }
+    _moving = true;
+    _direction = direction;
+    _holdSamples = 0;
+    return true;
+}
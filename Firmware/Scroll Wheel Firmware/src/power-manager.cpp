@@ -0,0 +1,89 @@
+#include "defaults.h"
+#include "power-manager.h"
+
+PowerManager::PowerManager() : _idleTimeout(POWER_IDLE_TIMEOUT), _offTimeout(POWER_OFF_TIMEOUT), _holdActive(false)
+{
+    reset(0);
+}
+
+void PowerManager::reset(uint32_t now)
+{
+    _state = ACTIVE;
+    _lastMotion = now;
+    _wakeups = 0;
+    _wakeStart = 0;
+    _wakeSamples = 0;
+    _waking = false;
+    _wakeLatency = 0;
+    _maxWakeLatency = 0;
+}
+
+bool PowerManager::update(uint32_t now, bool moving)
+{
+    State previous = _state;
+    if (_waking)
+    {
+        _wakeSamples++;
+    }
+
+    // Held active, the timeouts start over once the hold ends. Leaving idle
+    // this way is not a wake-up.
+    if (_holdActive)
+    {
+        _state = _state == OFF ? OFF : ACTIVE;
+        _lastMotion = now;
+        return _state != previous;
+    }
+
+    switch (_state)
+    {
+    case ACTIVE:
+        if (moving)
+        {
+            _lastMotion = now;
+        }
+        else if (now - _lastMotion >= _idleTimeout)
+        {
+            _state = IDLE;
+            _waking = false; // Back to sleep without a report, nothing to time
+        }
+        break;
+
+    case IDLE:
+        if (moving)
+        {
+            // Timed until the first report of a sample at the full rate
+            _wakeStart = now;
+            _wakeSamples = 0;
+            _waking = true;
+            _wakeups++;
+            _lastMotion = now;
+            _state = ACTIVE;
+        }
+        else if (_offTimeout != 0 && now - _lastMotion >= _offTimeout)
+        {
+            _state = OFF;
+        }
+        break;
+
+    case OFF:
+        break;
+    }
+
+    return _state != previous;
+}
+
+void PowerManager::onReport(uint32_t now)
+{
+    // The poll that woke up ran at the idle rate, its own report does not count
+    if (!_waking || _wakeSamples == 0)
+    {
+        return;
+    }
+    _waking = false;
+    _wakeLatency = now - _wakeStart;
+    if (_wakeLatency > _maxWakeLatency)
+    {
+        _maxWakeLatency = _wakeLatency;
+    }
+}
@@ -0,0 +1,42 @@
+#include "defaults.h"
+#include "power-source.h"
+
+PowerSource::PowerSource()
+{
+    reset(0, false, false);
+    _switches = 0;
+}
+
+void PowerSource::reset(uint32_t now, bool usbPresent, bool chargeActive)
+{
+    _usb = _usbLevel = usbPresent;
+    _charging = _chargeLevel = chargeActive;
+    _usbChanged = now;
+    _chargeChanged = now;
+}
+
+bool PowerSource::update(uint32_t now, bool usbPresent, bool chargeActive)
+{
+    if (usbPresent != _usbLevel)
+    {
+        _usbLevel = usbPresent;
+        _usbChanged = now;
+    }
+    if (chargeActive != _chargeLevel)
+    {
+        _chargeLevel = chargeActive;
+        _chargeChanged = now;
+    }
+
+    if (_charging != _chargeLevel && now - _chargeChanged >= POWER_SENSE_DEBOUNCE)
+    {
+        _charging = _chargeLevel;
+    }
+    if (_usb == _usbLevel || now - _usbChanged < POWER_SENSE_DEBOUNCE)
+    {
+        return false;
+    }
+    _usb = _usbLevel;
+    _switches++;
+    return true;
+}
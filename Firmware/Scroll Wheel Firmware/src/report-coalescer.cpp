@@ -0,0 +1,53 @@
+#include <limits.h>
+
+#include "report-coalescer.h"
+#include "stats.h"
+
+ReportCoalescer::ReportCoalescer(ReportSink &sink, int32_t maxStep) : _sink(sink), _maxStep(maxStep)
+{
+    clear();
+    _reports = 0;
+    _coalesced = 0;
+    _split = 0;
+}
+
+void ReportCoalescer::add(int32_t wheel)
+{
+    if (wheel == 0)
+    {
+        return;
+    }
+    if (_pending != 0)
+    {
+        _coalesced++;
+        STAT_COUNT(COUNTER_COALESCED, 1);
+    }
+
+    // Saturate rather than wrap if the link stays blocked for a long time
+    int64_t sum = (int64_t)_pending + wheel;
+    _pending = sum > INT32_MAX ? INT32_MAX : sum < INT32_MIN ? INT32_MIN : (int32_t)sum;
+}
+
+bool ReportCoalescer::flush()
+{
+    bool first = true;
+    while (_pending != 0 && _sink.canSend())
+    {
+        int32_t step = _pending > _maxStep ? _maxStep : _pending < -_maxStep ? -_maxStep : _pending;
+        _sink.sendWheel(step);
+        _pending -= step;
+        _reports++;
+        STAT_COUNT(COUNTER_REPORTS, 1);
+        if (!first)
+        {
+            _split++;
+        }
+        first = false;
+    }
+    return _pending == 0;
+}
+
+void ReportCoalescer::clear()
+{
+    _pending = 0;
+}
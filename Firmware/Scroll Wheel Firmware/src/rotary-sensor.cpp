@@ -1,44 +1,222 @@
-#include <Wire.h>
-#include <AS5600.h>
+#include <stdlib.h>
 
+#include "calibration.h"
+#include "config.h"
 #include "defaults.h"
-#include "globals.h"
+#include "rotary-sensor.h"
+#include "scroll-accel.h"
+#include "scroll-math.h"
+#include "stats.h"
+#include "wheel-mode.h"
 
-float angle_before = 380.0; // Initial angle
+// Position differences for the 16-bit filter stages, several turns per sample saturate
+static int16_t clampCounts(int64_t counts)
+{
+    return counts > INT16_MAX ? INT16_MAX : counts < -INT16_MAX ? -INT16_MAX : (int16_t)counts;
+}
 
-int getScrollValue()
+RotarySensor::RotarySensor(AngleSensor &sensor) :
+    _sensor(sensor),
+    _qualityInterval(samplesFor(SAMPLE_RATE_HZ, NOISE_QUALITY_INTERVAL)),
+    _sampleRate(SAMPLE_RATE_HZ),
+    _followsMode(true),
+    _usesCalibration(true)
 {
-    int rawAngle = encoder.readAngle(); // Value between 0 and 4095 (12-bit)
-    float angleDeg = rawAngle * 360.0 / 4096.0;
+    reset();
+}
 
-    // set first angle after boot
-    if (angle_before == 380.0)
+void RotarySensor::setSampleRate(uint32_t rate)
+{
+    if (rate == 0)
     {
-        angle_before = angleDeg;
+        return;
     }
+    _sampleRate = rate;
+    _qualityInterval = samplesFor(rate, NOISE_QUALITY_INTERVAL);
+    _tracker.setSampleRate(rate);
+    _filter.setSampleRate(rate);
+    _flywheel.setSampleRate(rate);
+    _modes.setSampleRate(rate);
+}
+
+void RotarySensor::reset()
+{
+    _acceptedPosition = 0;
+    _positionBefore = 0;
+    _sampleBefore = 0;
+    _remainder = 0;
+    _multiplier = 1;
+    _qualitySamples = _qualityInterval; // Due with the first sample
+    _readErrors = 0;
+    _rawAngle = 0;
+    _calibration = nullptr;
+    _readOk = false;
+    _tracker.reset();
+    _filter.reset();
+    _flywheel.reset();
+    _modes.reset();
+}
 
-    float angleDiff = angleDeg - angle_before;
+void RotarySensor::readSignalQuality()
+{
+    SignalQuality quality = _sensor.readSignalQuality();
+    _filter.setSignalQuality(quality.magnetDetected, quality.fieldOutOfRange, quality.agc, quality.magnitude);
+}
 
-    if (fabs(angleDiff) < JITTER_THRESHOLD)
+void RotarySensor::applyCalibration(const CalibrationTable &table)
+{
+    // The table was replaced: move every position by what the new one makes of the
+    // last angle, so the switch itself reads as neither a step nor noise
+    if (_calibration != nullptr && _tracker.isStarted())
     {
-        return 0; // Ignore small changes
+        int16_t angle = correctAngle(table, _rawAngle);
+        int16_t shift = wrapCounts(angle - _sampleBefore);
+        _tracker.shift(shift);
+        _acceptedPosition += shift;
+        _positionBefore += shift;
+        _sampleBefore = angle;
     }
+    _calibration = &table;
+}
 
-    // Handle wrap-around at 0/360 degrees
-    if (angleDiff > MAX_ROTATION_PER_READ)
+bool RotarySensor::pollSignalQuality()
+{
+    if (_tracker.isStarted() && _qualitySamples < _qualityInterval)
     {
-        angleDiff -= 360.0;
+        return false;
     }
-    else if (angleDiff < -MAX_ROTATION_PER_READ)
+    _qualitySamples = 0;
+    readSignalQuality();
+    return true;
+}
+
+int32_t RotarySensor::getScrollValue(uint8_t multiplier)
+{
+    pollSignalQuality();
+    return readScrollValue(multiplier);
+}
+
+int32_t RotarySensor::readScrollValue(uint8_t multiplier)
+{
+    _qualitySamples++;
+
+    // Only the angle read, the occasional AGC/magnitude read would skew the histogram
+    STAT_START(readStart);
+    int16_t rawAngle = _sensor.readAngle(); // Value between 0 and 4095 (12-bit)
+    STAT_STOP(STAT_I2C_READ, readStart);
+
+    // A stuck bus or missing frame only costs this sample, the next read catches up
+    _readOk = rawAngle >= 0;
+    if (!_readOk)
     {
-        angleDiff += 360.0;
+        _readErrors++;
+        STAT_COUNT(COUNTER_READ_ERRORS, 1);
+        return 0;
     }
 
-    // Store current angle for next comparison
-    angle_before = angleDeg;
+    STAT_START(computeStart);
+    int16_t angle = rawAngle;
+    if (_usesCalibration)
+    {
+        const CalibrationTable &table = acquireCalibration();
+        if (&table != _calibration)
+        {
+            applyCalibration(table);
+        }
+        angle = correctAngle(table, rawAngle);
+        releaseCalibration();
+    }
+    _rawAngle = rawAngle;
+    int32_t scrollValue = processAngle(angle, multiplier);
+    STAT_STOP(STAT_COMPUTE, computeStart);
 
-    // Scale and round the value as needed
-    int scrollValue = round(angleDiff * SCROLL_MULTIPLICATOR);
+    return scrollValue;
+}
 
+int32_t RotarySensor::processAngle(int16_t rawAngle, uint8_t multiplier)
+{
+    const ScrollConfig &config = acquireConfig();
+    int32_t scrollValue = processAngle(rawAngle, multiplier, config);
+    releaseConfig();
     return scrollValue;
-}
\ No newline at end of file
+}
+
+int32_t RotarySensor::processAngle(int16_t rawAngle, uint8_t multiplier, const ScrollConfig &config)
+{
+    // Unwrap around the predicted position, the first angle after boot starts the count
+    bool first = !_tracker.isStarted();
+    int64_t position = _tracker.update(rawAngle, config.maxRotation);
+    if (first)
+    {
+        _acceptedPosition = position;
+        _positionBefore = position;
+    }
+    _sampleBefore = rawAngle;
+
+    _filter.setBand(config.noiseBandMin, config.noiseBandMax, config.noiseBandGain);
+    _filter.track(clampCounts(position - _positionBefore));
+    _positionBefore = position;
+
+    // Unwrapped before the noise check so jitter around 0/4096 is caught as well
+    int16_t countDiff = clampCounts(position - _acceptedPosition);
+
+    bool motion = _filter.isMotion(countDiff);
+
+    // Jog, shuttle and keys only see the counts past the noise band, gain and
+    // inertia belong to the wheel. Switching modes drops what the other side held.
+    uint8_t mode = _modes.getMode();
+    int32_t modeValue = _followsMode ? _modes.update(motion ? countDiff : 0, config) : 0;
+    if (_modes.getMode() != mode)
+    {
+        _remainder = 0;
+        _flywheel.reset();
+    }
+    if (motion)
+    {
+        // Store current position for next comparison
+        _acceptedPosition = position;
+    }
+    if (_modes.getMode() != WHEEL_MODE_SCROLL)
+    {
+        return modeValue;
+    }
+
+    if (!motion)
+    {
+        // Ignore changes inside the noise band, a flick may still be coasting. A
+        // nudge past one count and half the band is a hand on the wheel, which stops it.
+        int32_t touchBand = _filter.deadBand() / 2 > (1 << NoiseFilter::Q) ? _filter.deadBand() / 2 : 1 << NoiseFilter::Q;
+        if ((abs((int32_t)countDiff) << NoiseFilter::Q) > touchBand)
+        {
+            _flywheel.touch();
+        }
+        return _flywheel.update(0, 0, false, multiplier, config);
+    }
+
+    // Drop the remainder if the host switched between notch and hi-res units
+    if (multiplier != _multiplier)
+    {
+        _remainder = 0;
+        _multiplier = multiplier;
+    }
+
+    // Scale by the speed dependent gain, the product is Q20 before the shift.
+    // The curve is laid out for SAMPLE_RATE_HZ, slower polling covers more counts per sample.
+    int32_t velocity = _filter.velocity();
+    if (_sampleRate != SAMPLE_RATE_HZ)
+    {
+        velocity = (int64_t)velocity * _sampleRate / SAMPLE_RATE_HZ;
+    }
+    int64_t scaled = (int64_t)countDiff * config.scrollGain * multiplier * getAccelGain(velocity, config.accelCurve);
+    int64_t amount = roundShift(scaled, ACCEL_GAIN_BITS);
+    _remainder += amount;
+
+    // Only the fraction below one report unit stays behind, the coalescer splits large values.
+    // A full config (gain, multiplier and accel at their limits) can pass the int32 range.
+    int64_t units = _remainder / SCROLL_ONE;
+    int32_t scrollValue = units > INT32_MAX ? INT32_MAX : units < -INT32_MAX ? -INT32_MAX : (int32_t)units;
+    _remainder -= units * SCROLL_ONE;
+
+    int32_t flywheelAmount = amount > INT32_MAX ? INT32_MAX : amount < -INT32_MAX ? -INT32_MAX : (int32_t)amount;
+    return _flywheel.update(scrollValue, flywheelAmount, true, multiplier, config);
+}
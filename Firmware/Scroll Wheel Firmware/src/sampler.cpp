@@ -0,0 +1,312 @@
+#include <Arduino.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+
+#include <atomic>
+
+#include "boot-sequence.h"
+#include "calibration-service.h"
+#include "defaults.h"
+#include "globals.h"
+#include "report-coalescer.h"
+#include "sampler.h"
+#include "spsc-queue.h"
+#include "stats.h"
+#include "telemetry-service.h"
+#include "wheel-mode.h"
+
+// Records and times every report on its way to the BLE stack
+class TracingSink : public ReportSink
+{
+public:
+    bool canSend() { return bleMouse.canSend(); }
+
+    void sendWheel(int16_t wheel)
+    {
+        reportTrace.addReport(systemClock.nowUs(), wheel);
+        STAT_START(notifyStart);
+        bleMouse.sendWheel(wheel);
+        STAT_STOP(STAT_NOTIFY, notifyStart);
+    }
+};
+
+static std::atomic<uint32_t> keyUsages(MODE_KEY_UP << 16 | MODE_KEY_DOWN); // Key mode usages, up in the high half
+
+// Jog steps and shuttle speed as AC Pan on the consumer report
+class PanSink : public ReportSink
+{
+public:
+    bool canSend() { return bleMouse.canSend(); }
+
+    void sendWheel(int16_t pan)
+    {
+        reportTrace.addReport(systemClock.nowUs(), pan);
+        bleMouse.sendPan(pan);
+    }
+};
+
+// Key mode steps, the coalescer hands over one step per report
+class KeySink : public ReportSink
+{
+public:
+    bool canSend() { return bleMouse.canSend(); }
+
+    void sendWheel(int16_t steps)
+    {
+        uint32_t keys = keyUsages.load(std::memory_order_relaxed);
+        reportTrace.addReport(systemClock.nowUs(), steps);
+        bleMouse.tapConsumer(steps > 0 ? keys >> 16 : keys & 0xFFFF);
+    }
+};
+
+TraceBuffer sampleTrace(TRACE_STREAM_SAMPLES);
+TraceBuffer reportTrace(TRACE_STREAM_REPORTS);
+PowerManager powerManager;
+
+static SpscQueue<ScrollSample, SAMPLE_QUEUE_SIZE> sampleQueue;
+static TracingSink tracingSink;
+static ReportCoalescer coalescer(tracingSink, WheelReport::WHEEL_MAX);
+static PanSink panSink;
+static ReportCoalescer panCoalescer(panSink, ConsumerReport::PAN_MAX);
+static KeySink keySink;
+static ReportCoalescer keyCoalescer(keySink, 1);
+
+static TaskHandle_t samplerTask = NULL;
+static TaskHandle_t reporterTask = NULL;
+static esp_timer_handle_t sampleTimer = NULL;
+
+static volatile uint32_t samplerOverruns = 0; // Sample slots missed or dropped on a full queue
+
+// Runs in the esp_timer task, only wakes the sampler so the I2C read happens on its own core
+static void onSampleTimer(void *arg)
+{
+    xTaskNotifyGive(samplerTask);
+}
+
+static void setSampleRate(uint32_t rate)
+{
+    esp_timer_stop(sampleTimer);
+    esp_timer_start_periodic(sampleTimer, 1000000 / rate);
+    for (uint8_t i = 0; i < sensorChannels.getCount(); i++)
+    {
+        sensorChannels.getSensor(i).setSampleRate(rate);
+    }
+}
+
+static ReportCoalescer &coalescerFor(uint8_t mode)
+{
+    switch (mode)
+    {
+    case WHEEL_MODE_JOG:
+    case WHEEL_MODE_SHUTTLE:
+        return panCoalescer;
+    case WHEEL_MODE_KEYS:
+        return keyCoalescer;
+    default:
+        return coalescer;
+    }
+}
+
+static void setCpuIdle(bool idle)
+{
+#if CONFIG_PM_ENABLE && CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    // Light sleep between samples, the BLE controller keeps the link in modem sleep
+    esp_pm_config_esp32_t pm = {};
+    pm.max_freq_mhz = POWER_ACTIVE_CPU_MHZ;
+    pm.min_freq_mhz = POWER_IDLE_CPU_MHZ;
+    pm.light_sleep_enable = idle;
+    esp_pm_configure(&pm);
+#else
+    // Without tickless idle in the sdkconfig, light sleep would drop the BLE link
+    setCpuFrequencyMhz(idle ? POWER_IDLE_CPU_MHZ : POWER_ACTIVE_CPU_MHZ);
+#endif
+}
+
+void powerOff()
+{
+    Serial.println("No motion, powering off");
+    Serial.flush();
+    digitalWrite(PWR_SW_PIN, LOW);
+
+    // Still running from USB power, stop drawing current until the next reset
+    esp_deep_sleep_start();
+}
+
+static void applyPowerState(PowerManager::State state)
+{
+    switch (state)
+    {
+    case PowerManager::ACTIVE:
+        setCpuIdle(false);
+        angleSensor.setPowerMode(SENSOR_POWER_NOMINAL);
+#if SENSOR_CHANNELS > 1
+        secondAngleSensor.setPowerMode(SENSOR_POWER_NOMINAL);
+#endif
+        setSampleRate(SAMPLE_RATE_HZ);
+        break;
+    case PowerManager::IDLE:
+        angleSensor.setPowerMode(SENSOR_POWER_IDLE_MODE);
+#if SENSOR_CHANNELS > 1
+        secondAngleSensor.setPowerMode(SENSOR_POWER_IDLE_MODE);
+#endif
+        setSampleRate(POWER_IDLE_RATE_HZ);
+        setCpuIdle(true);
+        break;
+    case PowerManager::OFF:
+        powerOff();
+        break;
+    }
+}
+
+static void samplerLoop(void *pvParameter)
+{
+    while (1)
+    {
+        uint32_t pending = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (pending > 1)
+        {
+            samplerOverruns += pending - 1;
+            STAT_COUNT(COUNTER_OVERRUNS, pending - 1);
+        }
+
+        ScrollSample sample;
+        sample.timestamp = systemClock.nowUs();
+        sensorChannels.sample(bleMouse.getWheelMultiplier(), sample.delta, sample.pan);
+        sample.mode = rotarySensor.getMode();
+        sampleTrace.addSample(sample.timestamp, rotarySensor.getLastAngle(), sample.delta);
+        addTelemetrySample(sample.timestamp, rotarySensor.getRawAngle());
+
+        // Calibration turns the wheel several times, none of that goes to the host
+        if (isCalibrating())
+        {
+            if (rotarySensor.isReadOk())
+            {
+                addCalibrationSample(rotarySensor.getRawAngle()); // A failed read would count as a sample at the old angle
+            }
+            sample.delta = 0;
+            sample.pan = 0;
+        }
+
+        if (powerManager.update(systemClock.nowMs(), sensorChannels.isMoving()))
+        {
+            applyPowerState(powerManager.getState());
+        }
+
+        if ((sample.delta == 0 && sample.pan == 0) || !bleMouse.isConnected())
+        {
+            continue;
+        }
+        powerManager.onReport(systemClock.nowMs());
+
+        if (sample.mode == WHEEL_MODE_KEYS)
+        {
+            const ScrollConfig &config = acquireConfig();
+            keyUsages.store((uint32_t)config.keyUp << 16 | config.keyDown, std::memory_order_relaxed);
+            releaseConfig();
+        }
+
+        if (!sampleQueue.push(sample))
+        {
+            samplerOverruns++;
+            STAT_COUNT(COUNTER_DROPPED, 1);
+            continue;
+        }
+        xTaskNotifyGive(reporterTask);
+    }
+}
+
+static void reporterLoop(void *pvParameter)
+{
+#ifdef SCROLL_STATS
+    uint32_t oldestPending = 0; // Timestamp of the oldest sample not yet fully reported
+#endif
+
+    while (1)
+    {
+        // Also wake up without samples to let the connection drop to idle parameters,
+        // and poll for credits while reports are held back by the stack
+        bool pending = coalescer.getPending() != 0 || panCoalescer.getPending() != 0 || keyCoalescer.getPending() != 0;
+        TickType_t timeout = pending ? 1 : pdMS_TO_TICKS(CONN_UPDATE_INTERVAL);
+        ulTaskNotifyTake(pdTRUE, timeout);
+        bleMouse.updateLink();
+
+        if (!bleMouse.isConnected())
+        {
+            coalescer.clear();
+            panCoalescer.clear();
+            keyCoalescer.clear();
+        }
+
+        ScrollSample sample;
+        while (sampleQueue.pop(sample))
+        {
+#ifdef SCROLL_STATS
+            if (coalescer.getPending() == 0)
+            {
+                oldestPending = sample.timestamp;
+            }
+#endif
+            coalescerFor(sample.mode).add(sample.delta);
+            panCoalescer.add(sample.pan);
+        }
+        panCoalescer.flush();
+        keyCoalescer.flush();
+
+#ifdef SCROLL_STATS
+        uint32_t reports = coalescer.getReports();
+        coalescer.flush();
+        if (coalescer.getReports() != reports)
+        {
+            STAT_RECORD(STAT_LATENCY, systemClock.nowUs() - oldestPending);
+        }
+#else
+        coalescer.flush();
+#endif
+    }
+}
+
+void startReporter()
+{
+    xTaskCreatePinnedToCore(reporterLoop, "reporter", REPORTER_TASK_STACK, NULL, REPORTER_TASK_PRIORITY, &reporterTask, REPORTER_TASK_CORE);
+}
+
+void startSampler()
+{
+    sensorChannels.add(rotarySensor, CHANNEL_WHEEL);
+#if SENSOR_CHANNELS > 1
+    sensorChannels.add(secondRotarySensor, (ChannelAxis)SENSOR_SECOND_AXIS);
+#endif
+
+    xTaskCreatePinnedToCore(samplerLoop, "sampler", SAMPLER_TASK_STACK, NULL, SAMPLER_TASK_PRIORITY, &samplerTask, SAMPLER_TASK_CORE);
+
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = onSampleTimer;
+    timerArgs.name = "sample";
+    esp_timer_create(&timerArgs, &sampleTimer);
+    powerManager.reset(systemClock.nowMs());
+    esp_timer_start_periodic(sampleTimer, 1000000 / SAMPLE_RATE_HZ);
+    bootTimeline.mark(BOOT_SAMPLING, systemClock.nowMs());
+}
+
+void pauseSampler(bool paused)
+{
+    if (sampleTimer == NULL)
+    {
+        return; // Still waiting for the encoder
+    }
+    if (paused)
+    {
+        esp_timer_stop(sampleTimer);
+        vTaskDelay(pdMS_TO_TICKS(2)); // Let a read in progress finish
+    }
+    else
+    {
+        setSampleRate(powerManager.getState() == PowerManager::IDLE ? POWER_IDLE_RATE_HZ : SAMPLE_RATE_HZ);
+    }
+}
+
+uint32_t getSamplerOverruns()
+{
+    return samplerOverruns;
+}
@@ -0,0 +1,168 @@
+#include "defaults.h"
+#include "scroll-accel.h"
+#include "scroll-math.h"
+
+// Gain curves are evaluated at compile time into lookup tables over
+// 0..ACCEL_MAX_SPEED, the hot path only interpolates between two entries.
+
+constexpr int ACCEL_TABLE_BITS = 5;
+constexpr int ACCEL_TABLE_SIZE = (1 << ACCEL_TABLE_BITS) + 1;
+
+struct AccelTable
+{
+    uint16_t gain[ACCEL_TABLE_SIZE];
+};
+
+struct AccelPoint
+{
+    double speed; // Fraction of ACCEL_MAX_SPEED
+    double gain;
+};
+
+// Custom curve: precise below a third of the top speed, then a steep ramp
+constexpr AccelPoint ACCEL_CUSTOM_POINTS[] = {
+    {0.00, 1.0},
+    {0.15, 1.0},
+    {0.35, 1.5},
+    {0.60, 4.0},
+    {1.00, ACCEL_MAX_GAIN},
+};
+
+constexpr double constExp(double x)
+{
+    int halvings = 0;
+    while (x > 0.5 || x < -0.5)
+    {
+        x /= 2;
+        halvings++;
+    }
+
+    double sum = 1, term = 1;
+    for (int n = 1; n < 16; n++)
+    {
+        term *= x / n;
+        sum += term;
+    }
+
+    while (halvings-- > 0)
+    {
+        sum *= sum;
+    }
+    return sum;
+}
+
+constexpr double constPow(double x, int exponent)
+{
+    double result = 1;
+    for (int i = 0; i < exponent; i++)
+    {
+        result *= x;
+    }
+    return result;
+}
+
+constexpr double logistic(double x)
+{
+    return 1.0 / (1.0 + constExp(-ACCEL_SIGMOID_STEEPNESS * (x - 0.5)));
+}
+
+constexpr double curveOff(double)
+{
+    return 1.0;
+}
+
+constexpr double curveLinear(double x)
+{
+    return 1.0 + (ACCEL_MAX_GAIN - 1.0) * x;
+}
+
+constexpr double curvePower(double x)
+{
+    return 1.0 + (ACCEL_MAX_GAIN - 1.0) * constPow(x, ACCEL_POWER_EXPONENT);
+}
+
+constexpr double curveSigmoid(double x)
+{
+    // Rescaled so the curve starts at a gain of 1 and ends at ACCEL_MAX_GAIN
+    return 1.0 + (ACCEL_MAX_GAIN - 1.0) * (logistic(x) - logistic(0)) / (logistic(1) - logistic(0));
+}
+
+constexpr double curveCustom(double x)
+{
+    constexpr int count = sizeof(ACCEL_CUSTOM_POINTS) / sizeof(ACCEL_CUSTOM_POINTS[0]);
+    for (int i = 1; i < count; i++)
+    {
+        const AccelPoint &a = ACCEL_CUSTOM_POINTS[i - 1];
+        const AccelPoint &b = ACCEL_CUSTOM_POINTS[i];
+        if (x <= b.speed)
+        {
+            return a.gain + (b.gain - a.gain) * (x - a.speed) / (b.speed - a.speed);
+        }
+    }
+    return ACCEL_CUSTOM_POINTS[count - 1].gain;
+}
+
+constexpr AccelTable makeTable(double (*curve)(double))
+{
+    AccelTable table{};
+    for (int i = 0; i < ACCEL_TABLE_SIZE; i++)
+    {
+        double gain = curve((double)i / (ACCEL_TABLE_SIZE - 1));
+        table.gain[i] = (uint16_t)(gain * (1 << ACCEL_GAIN_BITS) + 0.5);
+    }
+    return table;
+}
+
+constexpr bool isMonotonic(const AccelTable &table)
+{
+    if (table.gain[0] != 1 << ACCEL_GAIN_BITS)
+    {
+        return false;
+    }
+    for (int i = 1; i < ACCEL_TABLE_SIZE; i++)
+    {
+        if (table.gain[i] < table.gain[i - 1])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr AccelTable accelTables[ACCEL_CURVE_COUNT] = {
+    makeTable(curveOff),
+    makeTable(curveLinear),
+    makeTable(curvePower),
+    makeTable(curveSigmoid),
+    makeTable(curveCustom),
+};
+
+static_assert(isMonotonic(accelTables[ACCEL_OFF]), "Off curve must stay at a gain of 1");
+static_assert(isMonotonic(accelTables[ACCEL_LINEAR]), "Linear curve must start at 1 and never fall");
+static_assert(isMonotonic(accelTables[ACCEL_POWER]), "Power curve must start at 1 and never fall");
+static_assert(isMonotonic(accelTables[ACCEL_SIGMOID]), "Sigmoid curve must start at 1 and never fall");
+static_assert(isMonotonic(accelTables[ACCEL_CUSTOM]), "ACCEL_CUSTOM_POINTS must start at 1 and never fall");
+static_assert(ACCEL_MAX_GAIN * (1 << ACCEL_GAIN_BITS) < 65536, "ACCEL_MAX_GAIN does not fit the Q8 table");
+
+// Q4 counts per sample that map to the last table entry
+constexpr int32_t ACCEL_FULL_SCALE = roundCounts(degreesToCounts(ACCEL_MAX_SPEED) * 16 / SAMPLE_RATE_HZ);
+static_assert(ACCEL_FULL_SCALE > 0, "ACCEL_MAX_SPEED too low for the sample rate");
+
+uint16_t getAccelGain(int32_t velocity, uint8_t curve)
+{
+    const AccelTable &table = accelTables[curve];
+
+    int32_t speed = velocity < 0 ? -velocity : velocity;
+    if (speed >= ACCEL_FULL_SCALE)
+    {
+        return table.gain[ACCEL_TABLE_SIZE - 1];
+    }
+
+    // Table position in Q8, interpolate between the two neighbouring entries
+    int32_t position = (speed << (ACCEL_TABLE_BITS + 8)) / ACCEL_FULL_SCALE;
+    int32_t index = position >> 8;
+    int32_t fraction = position & 0xFF;
+    int32_t low = table.gain[index];
+    int32_t high = table.gain[index + 1];
+    return low + (((high - low) * fraction) >> 8);
+}
@@ -0,0 +1,81 @@
+#include "sensor-channels.h"
+#include "wheel-mode.h"
+
+SensorChannels::SensorChannels(Clock &clock) : _clock(clock), _count(0), _qualityNext(0)
+{
+    resetTiming();
+}
+
+bool SensorChannels::add(RotarySensor &sensor, ChannelAxis axis)
+{
+    if (_count == MAX_SENSOR_CHANNELS || (_count == 0 && axis != CHANNEL_WHEEL))
+    {
+        return false;
+    }
+    sensor.setFollowsMode(_count == 0);
+    sensor.setUsesCalibration(_count == 0);
+    _sensors[_count] = &sensor;
+    _axes[_count] = axis;
+    _count++;
+    return true;
+}
+
+void SensorChannels::resetTiming()
+{
+    _maxTickTime = 0;
+    for (int i = 0; i < MAX_SENSOR_CHANNELS; i++)
+    {
+        _minOffset[i] = UINT32_MAX;
+        _maxOffset[i] = 0;
+    }
+}
+
+void SensorChannels::sample(uint8_t multiplier, int32_t &wheel, int32_t &pan)
+{
+    wheel = 0;
+    pan = 0;
+    uint32_t start = _clock.nowUs();
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        uint32_t offset = i == 0 ? 0 : _clock.nowUs() - start;
+        _minOffset[i] = offset < _minOffset[i] ? offset : _minOffset[i];
+        _maxOffset[i] = offset > _maxOffset[i] ? offset : _maxOffset[i];
+
+        if (_axes[i] == CHANNEL_PAN)
+        {
+            pan += _sensors[i]->readScrollValue(1);
+            continue;
+        }
+        int32_t value = _sensors[i]->readScrollValue(multiplier);
+        if (i == 0 || _sensors[0]->getMode() == WHEEL_MODE_SCROLL)
+        {
+            wheel += value;
+        }
+    }
+
+    // Channels that fall due together take turns on the following ticks
+    for (uint8_t n = 0; n < _count; n++)
+    {
+        uint8_t i = (_qualityNext + n) % _count;
+        if (_sensors[i]->pollSignalQuality())
+        {
+            _qualityNext = (i + 1) % _count;
+            break;
+        }
+    }
+
+    uint32_t tickTime = _clock.nowUs() - start;
+    _maxTickTime = tickTime > _maxTickTime ? tickTime : _maxTickTime;
+}
+
+bool SensorChannels::isMoving() const
+{
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        if (_sensors[i]->isMoving())
+        {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,99 @@
+#ifdef SCROLL_STATS
+
+#include <string.h>
+
+#include "defaults.h"
+#include "stats.h"
+
+#if defined(__XTENSA__)
+extern "C" uint32_t ets_get_cpu_frequency(void); // ROM, follows setCpuFrequencyMhz() and power management
+#endif
+
+struct Stat
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t buckets[STAT_BUCKETS];
+};
+
+// Each stat and counter has a single writer, readers take a best effort snapshot
+static Stat stats[STAT_ID_COUNT];
+static volatile uint32_t counters[COUNTER_ID_COUNT];
+
+static int bucketOf(uint32_t value)
+{
+    int bucket = value == 0 ? 0 : 32 - __builtin_clz(value);
+    return bucket < STAT_BUCKETS ? bucket : STAT_BUCKETS - 1;
+}
+
+void recordStat(StatId id, uint32_t value)
+{
+    Stat &stat = stats[id];
+    if (stat.count == 0 || value < stat.min)
+    {
+        stat.min = value;
+    }
+    if (value > stat.max)
+    {
+        stat.max = value;
+    }
+    stat.count++;
+    stat.sum += value;
+    stat.buckets[bucketOf(value)]++;
+}
+
+void recordCycles(StatId id, uint32_t cycles)
+{
+#if defined(__XTENSA__)
+    // The sampler switches between the idle and active clock, one scale keeps the samples comparable
+    uint32_t cyclesPerUs = ets_get_cpu_frequency();
+    if (cyclesPerUs != POWER_ACTIVE_CPU_MHZ && cyclesPerUs != 0)
+    {
+        cycles = (uint64_t)cycles * POWER_ACTIVE_CPU_MHZ / cyclesPerUs;
+    }
+#endif
+    recordStat(id, cycles);
+}
+
+void countStat(CounterId id, uint32_t amount)
+{
+    counters[id] += amount;
+}
+
+void resetStats()
+{
+    memset(stats, 0, sizeof(stats));
+    for (int i = 0; i < COUNTER_ID_COUNT; i++)
+    {
+        counters[i] = 0;
+    }
+}
+
+void getStats(StatsSnapshot &snapshot)
+{
+    snapshot.version = STATS_VERSION;
+    snapshot.cyclesPerUs = POWER_ACTIVE_CPU_MHZ;
+
+    for (int i = 0; i < STAT_ID_COUNT; i++)
+    {
+        const Stat &stat = stats[i];
+        StatSnapshot &out = snapshot.stats[i];
+        out.count = stat.count;
+        out.min = stat.min;
+        out.max = stat.max;
+        out.avg = stat.count ? stat.sum / stat.count : 0;
+        for (int b = 0; b < STAT_BUCKETS; b++)
+        {
+            out.buckets[b] = stat.buckets[b] > 0xFFFF ? 0xFFFF : stat.buckets[b];
+        }
+    }
+
+    for (int i = 0; i < COUNTER_ID_COUNT; i++)
+    {
+        snapshot.counters[i] = counters[i];
+    }
+}
+
+#endif
@@ -0,0 +1,125 @@
+#include <Arduino.h>
+#include <BLE2902.h>
+#include <BLECharacteristic.h>
+#include <BLEServer.h>
+
+#include "battery-task.h"
+#include "defaults.h"
+#include "globals.h"
+#include "sampler.h"
+#include "spsc-queue.h"
+#include "telemetry-service.h"
+#include "telemetry.h"
+
+struct TelemetrySample
+{
+    uint32_t timestamp;
+    int16_t angle;
+};
+
+static SpscQueue<TelemetrySample, TELEMETRY_QUEUE_SIZE> sampleQueue;
+static uint8_t streamBuffer[TELEMETRY_BUFFER_SIZE];
+static TelemetryEncoder encoder(streamBuffer, sizeof(streamBuffer), 1000000 / SAMPLE_RATE_HZ);
+
+static BLEServer *telemetryServer = NULL;
+static BLECharacteristic *telemetryCharacteristic = NULL;
+static BLE2902 *telemetryDescriptor = NULL;
+
+static volatile bool subscribed = false;
+static volatile uint32_t dropped = 0; // Samples lost on a full queue or stream buffer
+
+void addTelemetrySample(uint32_t timestamp, int16_t rawAngle)
+{
+    if (subscribed && !sampleQueue.push({timestamp, rawAngle}))
+    {
+        dropped++;
+    }
+}
+
+static uint8_t readPowerFlags()
+{
+    return (powerSource.isUsbPowered() ? TELEMETRY_POWER_USB : 0) | (powerSource.isCharging() ? TELEMETRY_POWER_CHARGING : 0);
+}
+
+static void addStatus()
+{
+    encoder.addBattery(batteryMonitor.getLevel(), batteryMonitor.getMillivolts(), readPowerFlags());
+
+    uint32_t stats[TELEMETRY_STAT_COUNT];
+    stats[TELEMETRY_STAT_OVERRUNS] = getSamplerOverruns();
+    stats[TELEMETRY_STAT_READ_ERRORS] = rotarySensor.getReadErrors();
+    stats[TELEMETRY_STAT_RECONNECTS] = bleMouse.getReconnects();
+    stats[TELEMETRY_STAT_DROPPED] = dropped;
+    stats[TELEMETRY_STAT_ALIASED] = rotarySensor.getTracker().getAliased();
+    encoder.addStats(stats, TELEMETRY_STAT_COUNT);
+}
+
+// Cuts the closed frames into at most TELEMETRY_BURST notifications, and only
+// while no input report waits for the stack. The rest waits for the next round,
+// so a scroll report has at most one round of telemetry ahead of it.
+static void sendReady()
+{
+    uint16_t mtu = telemetryServer->getPeerMTU(telemetryServer->getConnId());
+    size_t piece = max<uint16_t>(mtu, ESP_GATT_DEF_BLE_MTU_SIZE) - 3; // 0 until the peer is known
+    for (int sent = 0; sent < TELEMETRY_BURST && encoder.ready() > 0; sent++)
+    {
+        if (bleMouse.isCongested() || bleMouse.hasReportsInFlight())
+        {
+            break;
+        }
+        size_t length = min(encoder.ready(), piece);
+        telemetryCharacteristic->setValue((uint8_t *)encoder.data(), length);
+        telemetryCharacteristic->notify();
+        encoder.consume(length);
+    }
+}
+
+// Below the reporter, so telemetry only ever gets the airtime scrolling leaves over
+static void telemetryLoop(void *pvParameter)
+{
+    TickType_t lastWake = xTaskGetTickCount();
+    uint32_t lastStatus = 0;
+    while (1)
+    {
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(TELEMETRY_INTERVAL));
+
+        TelemetrySample sample;
+        if (!bleMouse.isConnected() || !telemetryDescriptor->getNotifications())
+        {
+            subscribed = false;
+            while (sampleQueue.pop(sample))
+                ;
+            encoder.reset();
+            continue;
+        }
+        if (!subscribed)
+        {
+            subscribed = true;
+            lastStatus = millis() - TELEMETRY_STATUS_INTERVAL; // Status right away
+        }
+
+        while (sampleQueue.pop(sample))
+        {
+            if (!encoder.addSample(sample.timestamp, sample.angle))
+            {
+                dropped++;
+            }
+        }
+        encoder.flush();
+
+        if (millis() - lastStatus >= TELEMETRY_STATUS_INTERVAL)
+        {
+            lastStatus = millis();
+            addStatus();
+        }
+        sendReady();
+    }
+}
+
+void startTelemetry(BLEServer *server, BLECharacteristic *characteristic)
+{
+    telemetryServer = server;
+    telemetryCharacteristic = characteristic;
+    telemetryDescriptor = (BLE2902 *)characteristic->getDescriptorByUUID(BLEUUID((uint16_t)0x2902));
+    xTaskCreatePinnedToCore(telemetryLoop, "telemetry", TELEMETRY_TASK_STACK, NULL, TELEMETRY_TASK_PRIORITY, NULL, REPORTER_TASK_CORE);
+}
@@ -0,0 +1,341 @@
+#include <string.h>
+
+#include "trace.h"
+
+constexpr uint32_t TRACE_PERIOD = 1000000 / SAMPLE_RATE_HZ;
+constexpr size_t TRACE_MAX_RECORD = 16; // Tag and three 5-byte varints
+
+void writeTraceHeader(TraceWriter writer, void *context, uint8_t streams, uint8_t multiplier, const ScrollConfig &config)
+{
+    TraceDumpHeader header;
+    memcpy(header.magic, "SWTR", 4);
+    header.version = TRACE_VERSION;
+    header.streams = streams;
+    header.samplePeriod = TRACE_PERIOD;
+    header.blockSize = TRACE_BLOCK_SIZE;
+    header.multiplier = multiplier;
+    header.config = config;
+    writer((const uint8_t *)&header, sizeof(header), context);
+}
+
+TraceBuffer::TraceBuffer(uint8_t stream) : _stream(stream), _running(false), _writing(false)
+{
+    _used = 0;
+}
+
+void TraceBuffer::start()
+{
+    stop();
+    _block = 0;
+    _used = 0;
+    _fill = 0;
+    _runTag = -1;
+    _time = 0;
+    _angle = 0;
+    _running = true;
+}
+
+void TraceBuffer::stop()
+{
+    _running = false;
+
+    // Let a record that is being written finish before anyone reads the blocks
+    while (_writing)
+    {
+    }
+}
+
+bool TraceBuffer::reserve(uint32_t timestamp, size_t length)
+{
+    if (_used != 0 && _fill + length <= TRACE_BLOCK_SIZE)
+    {
+        return false;
+    }
+
+    if (_used == 0)
+    {
+        _time = timestamp;
+    }
+    else
+    {
+        _block = (_block + 1) % TRACE_BLOCKS;
+    }
+    if (_used < TRACE_BLOCKS)
+    {
+        _used++;
+    }
+
+    // Block header with the state the first record is relative to
+    uint8_t *block = _blocks[_block];
+    block[0] = _time;
+    block[1] = _time >> 8;
+    block[2] = _time >> 16;
+    block[3] = _time >> 24;
+    block[4] = _angle;
+    block[5] = _angle >> 8;
+    block[6] = 0;
+    _fill = TRACE_BLOCK_HEADER;
+    _runTag = -1;
+    return true;
+}
+
+void TraceBuffer::putVarint(uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        put((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    put(value);
+}
+
+void TraceBuffer::addSample(uint32_t timestamp, int16_t angle, int32_t value)
+{
+    _writing = true;
+    if (!_running)
+    {
+        _writing = false;
+        return;
+    }
+
+    if (_used == 0)
+    {
+        _angle = angle;
+    }
+
+    int32_t angleDelta = ((angle - _angle + 2048) & 0xFFF) - 2048;
+    int32_t jitter = (int32_t)(timestamp - _time - TRACE_PERIOD);
+    bool resting = angleDelta == 0 && value == 0 && jitter >= -TRACE_IDLE_JITTER && jitter <= TRACE_IDLE_JITTER;
+
+    if (resting)
+    {
+        // Extend the open run, or start a new one
+        if (reserve(timestamp, 1) || _runTag < 0 || _blocks[_block][_runTag] == 0x7F)
+        {
+            _runTag = _fill;
+            put(0);
+        }
+        else
+        {
+            _blocks[_block][_runTag]++;
+        }
+        _time += TRACE_PERIOD;
+    }
+    else
+    {
+        reserve(timestamp, TRACE_MAX_RECORD);
+        put(TRACE_TAG_SAMPLE);
+        putSigned(timestamp - _time - TRACE_PERIOD);
+        putSigned(angleDelta);
+        putSigned(value);
+        _time = timestamp;
+        _angle = angle;
+        _runTag = -1;
+    }
+
+    _blocks[_block][6] = _fill - TRACE_BLOCK_HEADER;
+    _writing = false;
+}
+
+void TraceBuffer::addReport(uint32_t timestamp, int32_t value)
+{
+    _writing = true;
+    if (!_running)
+    {
+        _writing = false;
+        return;
+    }
+
+    reserve(timestamp, TRACE_MAX_RECORD);
+    put(TRACE_TAG_REPORT);
+    putVarint(timestamp - _time);
+    putSigned(value);
+    _time = timestamp;
+
+    _blocks[_block][6] = _fill - TRACE_BLOCK_HEADER;
+    _writing = false;
+}
+
+void TraceBuffer::dump(TraceWriter writer, void *context) const
+{
+    TraceStreamHeader header;
+    header.stream = _stream;
+    header.blocks = _used;
+    writer((const uint8_t *)&header, sizeof(header), context);
+
+    // Oldest block first, only the filled part of each block
+    uint16_t block = _used < TRACE_BLOCKS ? 0 : (_block + 1) % TRACE_BLOCKS;
+    for (uint16_t i = 0; i < _used; i++)
+    {
+        writer(_blocks[block], TRACE_BLOCK_HEADER + _blocks[block][6], context);
+        block = (block + 1) % TRACE_BLOCKS;
+    }
+}
+
+TraceDecoder::TraceDecoder(const uint8_t *data, size_t length) :
+    _data(data),
+    _length(length),
+    _position(0),
+    _blockEnd(0),
+    _samplePeriod(0),
+    _blockSize(0),
+    _streamsLeft(0),
+    _stream(0),
+    _blocksLeft(0),
+    _runLeft(0),
+    _time(0),
+    _angle(0)
+{
+}
+
+bool TraceDecoder::readHeader(TraceDumpHeader &header)
+{
+    if (_length - _position < sizeof(header))
+    {
+        return false;
+    }
+    memcpy(&header, _data + _position, sizeof(header));
+    if (memcmp(header.magic, "SWTR", 4) != 0 || header.version != TRACE_VERSION)
+    {
+        return false;
+    }
+
+    _position += sizeof(header);
+    _samplePeriod = header.samplePeriod;
+    _blockSize = header.blockSize;
+    _streamsLeft = header.streams;
+    _blocksLeft = 0;
+    _blockEnd = _position;
+    return true;
+}
+
+bool TraceDecoder::readVarint(uint32_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        if (_position >= _blockEnd)
+        {
+            return false;
+        }
+        uint8_t byte = _data[_position++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TraceDecoder::readSigned(int32_t &value)
+{
+    uint32_t raw;
+    if (!readVarint(raw))
+    {
+        return false;
+    }
+    value = (int32_t)(raw >> 1) ^ -(int32_t)(raw & 1);
+    return true;
+}
+
+bool TraceDecoder::startBlock()
+{
+    if (_length - _position < TRACE_BLOCK_HEADER)
+    {
+        return false;
+    }
+
+    const uint8_t *block = _data + _position;
+    size_t end = _position + TRACE_BLOCK_HEADER + block[6];
+    if (end > _length || TRACE_BLOCK_HEADER + block[6] > _blockSize)
+    {
+        return false;
+    }
+
+    _time = block[0] | block[1] << 8 | block[2] << 16 | (uint32_t)block[3] << 24;
+    _angle = block[4] | block[5] << 8;
+    _position += TRACE_BLOCK_HEADER;
+    _blockEnd = end;
+    _blocksLeft--;
+    return true;
+}
+
+bool TraceDecoder::next(TraceEvent &event)
+{
+    while (true)
+    {
+        if (_runLeft > 0)
+        {
+            _runLeft--;
+            _time += _samplePeriod;
+            event.stream = _stream;
+            event.timestamp = _time;
+            event.angle = _angle;
+            event.value = 0;
+            return true;
+        }
+
+        if (_position < _blockEnd)
+        {
+            uint8_t tag = _data[_position++];
+            if (tag < 0x80)
+            {
+                _runLeft = tag + 1;
+                continue;
+            }
+
+            int32_t offset, angleDelta, value;
+            uint32_t dt;
+            if (tag == TRACE_TAG_SAMPLE)
+            {
+                if (!readSigned(offset) || !readSigned(angleDelta) || !readSigned(value))
+                {
+                    return false;
+                }
+                _time += _samplePeriod + offset;
+                _angle = (_angle + angleDelta) & 0xFFF;
+            }
+            else if (tag == TRACE_TAG_REPORT)
+            {
+                if (!readVarint(dt) || !readSigned(value))
+                {
+                    return false;
+                }
+                _time += dt;
+            }
+            else
+            {
+                return false;
+            }
+
+            event.stream = _stream;
+            event.timestamp = _time;
+            event.angle = _angle;
+            event.value = value;
+            return true;
+        }
+
+        if (_blocksLeft > 0)
+        {
+            if (!startBlock())
+            {
+                return false;
+            }
+            continue;
+        }
+
+        if (_streamsLeft == 0 || _length - _position < sizeof(TraceStreamHeader))
+        {
+            return false;
+        }
+
+        TraceStreamHeader header;
+        memcpy(&header, _data + _position, sizeof(header));
+        _position += sizeof(header);
+        _blockEnd = _position;
+        _stream = header.stream;
+        _blocksLeft = header.blocks;
+        _streamsLeft--;
+    }
+}
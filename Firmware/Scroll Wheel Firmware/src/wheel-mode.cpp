@@ -0,0 +1,92 @@
+#include "defaults.h"
+#include "scroll-math.h"
+#include "wheel-mode.h"
+
+constexpr int32_t HYSTERESIS = ENCODER_COUNTS / 4; // A quarter step past the midpoint, in 1/steps counts
+constexpr int32_t SNAP = ENCODER_COUNTS / 2 + HYSTERESIS;
+
+static_assert(SHUTTLE_LEVELS > 0, "SHUTTLE_LEVELS must be at least 1");
+static_assert(MODE_STEPS > 0 && MODE_STEPS <= ENCODER_COUNTS, "MODE_STEPS out of range");
+
+WheelModeEngine::WheelModeEngine()
+{
+    _interval = 1;
+    setSampleRate(SAMPLE_RATE_HZ);
+    reset();
+}
+
+void WheelModeEngine::reset()
+{
+    _mode = WHEEL_MODE_SCROLL;
+    _steps = 1;
+    _offset = 0;
+    _level = 0;
+    _shuttleSamples = 0;
+}
+
+void WheelModeEngine::setSampleRate(uint32_t rate)
+{
+    uint32_t interval = rate * SHUTTLE_INTERVAL / 1000;
+    _interval = interval > 0 ? interval : 1;
+}
+
+// Moves the position by counts and returns the steps it snapped over, either sign
+int32_t WheelModeEngine::advance(int32_t counts)
+{
+    // Counts are a 16-bit sample difference and steps at most ENCODER_COUNTS, both fit with the offset
+    _offset += counts * _steps;
+    int32_t steps = 0;
+    if (_offset >= SNAP)
+    {
+        steps = (_offset - SNAP) / ENCODER_COUNTS + 1;
+    }
+    else if (_offset <= -SNAP)
+    {
+        steps = -((-_offset - SNAP) / ENCODER_COUNTS + 1);
+    }
+    _offset -= steps * ENCODER_COUNTS;
+    _level += steps;
+    return steps;
+}
+
+int32_t WheelModeEngine::update(int32_t counts, const ScrollConfig &config)
+{
+    // A new mode or step size starts from a clean state, the shuttle stops where the wheel is now
+    if (config.wheelMode != _mode || config.modeSteps != _steps)
+    {
+        reset();
+        _mode = config.wheelMode;
+        _steps = config.modeSteps;
+    }
+
+    switch (_mode)
+    {
+    case WHEEL_MODE_JOG:
+    case WHEEL_MODE_KEYS:
+        return advance(counts);
+    case WHEEL_MODE_SHUTTLE:
+    {
+        // Past the last level the wheel turns freely, the position stays where
+        // that level was reached so turning back leaves it after half a step
+        advance(counts);
+        if (_level > SHUTTLE_LEVELS || (_level == SHUTTLE_LEVELS && _offset > SNAP - ENCODER_COUNTS))
+        {
+            _level = SHUTTLE_LEVELS;
+            _offset = SNAP - ENCODER_COUNTS;
+        }
+        else if (_level < -SHUTTLE_LEVELS || (_level == -SHUTTLE_LEVELS && _offset < ENCODER_COUNTS - SNAP))
+        {
+            _level = -SHUTTLE_LEVELS;
+            _offset = ENCODER_COUNTS - SNAP;
+        }
+        if (++_shuttleSamples < _interval)
+        {
+            return 0;
+        }
+        _shuttleSamples = 0;
+        return getShuttleLevel();
+    }
+    default:
+        return 0;
+    }
+}
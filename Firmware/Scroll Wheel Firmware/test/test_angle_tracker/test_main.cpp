@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <unity.h>
+
+#include "angle-tracker.h"
+#include "config.h"
+#include "fakes.h"
+#include "rotary-sensor.h"
+
+// Multi-turn unwrapping: fast spins past half a turn per sample, reversals,
+// and single bad samples that must not leave a speed behind.
+
+static int16_t wrap(int64_t position)
+{
+    return position & (ENCODER_COUNTS - 1);
+}
+
+void setUp()
+{
+    publishConfig(defaultConfig());
+}
+
+void tearDown()
+{
+}
+
+void test_first_angle_is_the_start()
+{
+    AngleTracker tracker;
+    TEST_ASSERT_FALSE(tracker.isStarted());
+    TEST_ASSERT_EQUAL(1234, tracker.update(1234));
+    TEST_ASSERT_TRUE(tracker.isStarted());
+    TEST_ASSERT_EQUAL(0, tracker.getVelocity());
+}
+
+void test_slow_turn_wraps_around()
+{
+    AngleTracker tracker;
+    int64_t position = ENCODER_COUNTS - 100;
+    tracker.update(wrap(position));
+    for (int i = 0; i < 3 * ENCODER_COUNTS / 7; i++)
+    {
+        position += 7;
+        TEST_ASSERT_EQUAL(position, tracker.update(wrap(position)));
+    }
+    for (int i = 0; i < 6 * ENCODER_COUNTS / 5; i++)
+    {
+        position -= 5;
+        TEST_ASSERT_EQUAL(position, tracker.update(wrap(position)));
+    }
+    TEST_ASSERT_EQUAL(0, tracker.getAliased());
+}
+
+void test_fast_spin_past_half_a_turn_per_sample()
+{
+    // Spun up gently to 0.6 turns per sample and back down again
+    AngleTracker tracker;
+    int64_t position = 0;
+    tracker.update(0);
+    int32_t speed = 0;
+    for (int i = 0; i < 400; i++)
+    {
+        speed += i < 200 ? 12 : -12;
+        position += speed;
+        TEST_ASSERT_EQUAL(position, tracker.update(wrap(position)));
+    }
+    TEST_ASSERT_EQUAL(0, tracker.getAliased());
+}
+
+void test_speed_stays_below_half_a_turn()
+{
+    AngleTracker tracker;
+    int64_t position = 0;
+    tracker.update(0);
+    int32_t speed = 0;
+    for (int i = 0; i < 250; i++)
+    {
+        speed += 12;
+        position += speed;
+        tracker.update(wrap(position));
+        TEST_ASSERT_TRUE(abs(tracker.getVelocity()) < ENCODER_COUNTS / 2);
+    }
+}
+
+void test_outlier_leaves_no_speed()
+{
+    AngleTracker tracker;
+    tracker.update(1000);
+    tracker.update(2500);
+    for (int i = 0; i < 1000; i++)
+    {
+        tracker.update(1000);
+    }
+    TEST_ASSERT_EQUAL(1000, tracker.getPosition());
+    TEST_ASSERT_EQUAL(0, tracker.getVelocity());
+    TEST_ASSERT_TRUE(tracker.getAliased() > 0);
+}
+
+void test_outlier_while_turning_keeps_the_turn()
+{
+    AngleTracker tracker;
+    int64_t position = 0;
+    tracker.update(0);
+    for (int i = 0; i < 1000; i++)
+    {
+        position += 3;
+        int16_t angle = i == 500 ? wrap(position + ENCODER_COUNTS / 3) : wrap(position);
+        tracker.update(angle);
+    }
+    TEST_ASSERT_EQUAL(position, tracker.getPosition());
+    TEST_ASSERT_EQUAL(3, tracker.getVelocity());
+}
+
+void test_outlier_scrolls_net_zero()
+{
+    FakeAngleSensor sensor;
+    sensor.angle = 1000;
+    RotarySensor rotary(sensor);
+    int64_t reported = 0;
+    for (int i = 0; i < 500; i++)
+    {
+        reported += rotary.getScrollValue(1);
+    }
+    sensor.angle = 2500;
+    reported += rotary.getScrollValue(1);
+    sensor.angle = 1000;
+    for (int i = 0; i < 1000; i++)
+    {
+        reported += rotary.getScrollValue(1);
+    }
+    TEST_ASSERT_EQUAL(0, reported);
+    TEST_ASSERT_FALSE(rotary.isMoving());
+}
+
+void test_sample_rate_change_keeps_counts_per_second()
+{
+    AngleTracker tracker;
+    int64_t position = 0;
+    tracker.update(0);
+    for (int i = 0; i < 10; i++)
+    {
+        position += 40;
+        tracker.update(wrap(position));
+    }
+    tracker.setSampleRate(SAMPLE_RATE_HZ / 4);
+    TEST_ASSERT_EQUAL(160, tracker.getVelocity());
+    for (int i = 0; i < 10; i++)
+    {
+        position += 160;
+        TEST_ASSERT_EQUAL(position, tracker.update(wrap(position)));
+    }
+    TEST_ASSERT_EQUAL(0, tracker.getAliased());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_angle_is_the_start);
+    RUN_TEST(test_slow_turn_wraps_around);
+    RUN_TEST(test_fast_spin_past_half_a_turn_per_sample);
+    RUN_TEST(test_speed_stays_below_half_a_turn);
+    RUN_TEST(test_outlier_leaves_no_speed);
+    RUN_TEST(test_outlier_while_turning_keeps_the_turn);
+    RUN_TEST(test_outlier_scrolls_net_zero);
+    RUN_TEST(test_sample_rate_change_keeps_counts_per_second);
+    return UNITY_END();
+}
@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <unity.h>
+
+#include "battery.h"
+#include "defaults.h"
+#include "fakes.h"
+
+// Battery level against synthetic pack voltage curves: the discharge table,
+// a slow discharge with ADC noise and the recovery after a load.
+
+static const uint16_t CELL_POINTS[] = {1000, 1150, 1200, 1225, 1240, 1252, 1265, 1280, 1300, 1330, 1380}; // 0 to 100 %
+
+static FakeAdc adc;
+
+void setUp()
+{
+    srand(1);
+    adc = FakeAdc();
+}
+
+void tearDown()
+{
+}
+
+void test_curve_points_map_to_their_level()
+{
+    for (int i = 0; i < 11; i++)
+    {
+        TEST_ASSERT_EQUAL(i * 10, getBatteryLevel(CELL_POINTS[i] * BATTERY_CELLS));
+    }
+    TEST_ASSERT_EQUAL(0, getBatteryLevel(0));
+    TEST_ASSERT_EQUAL(0, getBatteryLevel(900 * BATTERY_CELLS));
+    TEST_ASSERT_EQUAL(100, getBatteryLevel(1500 * BATTERY_CELLS));
+}
+
+void test_level_rises_with_the_voltage()
+{
+    uint8_t before = 0;
+    for (uint32_t mv = 900 * BATTERY_CELLS; mv <= 1500 * BATTERY_CELLS; mv++)
+    {
+        uint8_t level = getBatteryLevel(mv);
+        TEST_ASSERT_GREATER_OR_EQUAL(before, level);
+        TEST_ASSERT_LESS_OR_EQUAL(100, level);
+        before = level;
+    }
+}
+
+void test_first_reading_sets_the_level()
+{
+    BatteryMonitor battery(adc);
+    adc.millivolts = 1240 * BATTERY_CELLS / BATTERY_VALUE_CORRECTION;
+    TEST_ASSERT_TRUE(battery.update());
+    TEST_ASSERT_EQUAL(40, battery.getLevel());
+    TEST_ASSERT_EQUAL(1240 * BATTERY_CELLS, battery.getMillivolts());
+}
+
+void test_oversampling_averages_the_noise()
+{
+    BatteryMonitor battery(adc);
+    adc.millivolts = 1265 * BATTERY_CELLS / BATTERY_VALUE_CORRECTION;
+    adc.noise = 60;
+    for (int i = 0; i < 100; i++)
+    {
+        battery.update();
+    }
+    TEST_ASSERT_INT_WITHIN(10, 1265 * BATTERY_CELLS, battery.getMillivolts());
+    TEST_ASSERT_INT_WITHIN(1, 60, battery.getLevel());
+}
+
+void test_noisy_discharge_only_falls()
+{
+    // Full to empty over 2000 updates, the level never goes back up on noise
+    BatteryMonitor battery(adc);
+    adc.noise = 40;
+    uint8_t before = 100;
+    for (int i = 0; i <= 2000; i++)
+    {
+        uint32_t cell = 1380 - (1380 - 1000) * i / 2000;
+        adc.millivolts = cell * BATTERY_CELLS / BATTERY_VALUE_CORRECTION;
+        battery.update();
+        TEST_ASSERT_LESS_OR_EQUAL(before, battery.getLevel());
+        before = battery.getLevel();
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(2, battery.getLevel());
+}
+
+void test_recovery_after_load_needs_the_hysteresis()
+{
+    BatteryMonitor battery(adc);
+    adc.millivolts = 1252 * BATTERY_CELLS / BATTERY_VALUE_CORRECTION; // 50 %
+    battery.update();
+    TEST_ASSERT_EQUAL(50, battery.getLevel());
+
+    // A short sag under load takes the level down right away
+    adc.millivolts = 1245 * BATTERY_CELLS / BATTERY_VALUE_CORRECTION;
+    for (int i = 0; i < 100; i++)
+    {
+        battery.update();
+    }
+    uint8_t loaded = battery.getLevel();
+    TEST_ASSERT_TRUE(loaded < 50);
+
+    // Recovering by less than the hysteresis is not reported
+    adc.millivolts = 1246 * BATTERY_CELLS / BATTERY_VALUE_CORRECTION;
+    for (int i = 0; i < 100; i++)
+    {
+        TEST_ASSERT_FALSE(battery.update());
+    }
+    TEST_ASSERT_EQUAL(loaded, battery.getLevel());
+
+    // Back at rest the level comes back
+    adc.millivolts = 1252 * BATTERY_CELLS / BATTERY_VALUE_CORRECTION;
+    for (int i = 0; i < 100; i++)
+    {
+        battery.update();
+    }
+    TEST_ASSERT_TRUE(battery.getLevel() >= loaded + BATTERY_HYSTERESIS);
+    TEST_ASSERT_INT_WITHIN(1, 50, battery.getLevel());
+}
+
+void test_reset_starts_over()
+{
+    BatteryMonitor battery(adc);
+    adc.millivolts = 1000 * BATTERY_CELLS / BATTERY_VALUE_CORRECTION;
+    battery.update();
+    TEST_ASSERT_EQUAL(0, battery.getLevel());
+    battery.reset();
+    adc.millivolts = 1380 * BATTERY_CELLS / BATTERY_VALUE_CORRECTION;
+    battery.update();
+    TEST_ASSERT_EQUAL(100, battery.getLevel());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_curve_points_map_to_their_level);
+    RUN_TEST(test_level_rises_with_the_voltage);
+    RUN_TEST(test_first_reading_sets_the_level);
+    RUN_TEST(test_oversampling_averages_the_noise);
+    RUN_TEST(test_noisy_discharge_only_falls);
+    RUN_TEST(test_recovery_after_load_needs_the_hysteresis);
+    RUN_TEST(test_reset_starts_over);
+    return UNITY_END();
+}
@@ -0,0 +1,129 @@
+#include <thread>
+#include <unity.h>
+
+#include "boot-sequence.h"
+#include "defaults.h"
+#include "fakes.h"
+
+// Boot phase marks from several tasks and the non-blocking encoder probe:
+// a sensor that answers at once, late, or never.
+
+static FakeAngleSensor sensor;
+static BootTimeline timeline;
+
+// Polls every ms until the probe leaves WAITING or the time runs out, returns the time it took
+static uint32_t probeUntilDone(SensorProbe &probe, uint32_t start, uint32_t limit)
+{
+    uint32_t now = start;
+    while (probe.poll(now) == SensorProbe::WAITING && now - start < limit)
+    {
+        now++;
+    }
+    return now - start;
+}
+
+void setUp()
+{
+    sensor = FakeAngleSensor();
+    timeline.reset();
+}
+
+void tearDown()
+{
+}
+
+void test_phases_keep_their_first_mark()
+{
+    TEST_ASSERT_FALSE(timeline.reached(BOOT_CONNECTED));
+    TEST_ASSERT_EQUAL(BootTimeline::NOT_REACHED, timeline.get(BOOT_CONNECTED));
+    timeline.mark(BOOT_CONNECTED, 800);
+    timeline.mark(BOOT_CONNECTED, 1200); // A reconnect later on
+    TEST_ASSERT_TRUE(timeline.reached(BOOT_CONNECTED));
+    TEST_ASSERT_EQUAL(800, timeline.get(BOOT_CONNECTED));
+    TEST_ASSERT_FALSE(timeline.reached(BOOT_FIRST_REPORT));
+
+    timeline.reset();
+    TEST_ASSERT_FALSE(timeline.reached(BOOT_CONNECTED));
+}
+
+void test_first_mark_wins_across_tasks()
+{
+    // BLE callbacks and the main loop race for the same phase
+    std::thread other([]() {
+        for (uint32_t i = 0; i < 10000; i++)
+        {
+            timeline.mark(BOOT_FIRST_REPORT, 5000 + i);
+        }
+    });
+    timeline.mark(BOOT_FIRST_REPORT, 4000);
+    other.join();
+    uint32_t first = timeline.get(BOOT_FIRST_REPORT);
+    TEST_ASSERT_TRUE(first == 4000 || first == 5000);
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        timeline.mark(BOOT_FIRST_REPORT, i);
+    }
+    TEST_ASSERT_EQUAL(first, timeline.get(BOOT_FIRST_REPORT));
+}
+
+void test_sensor_answers_on_the_first_try()
+{
+    SensorProbe probe(sensor, timeline);
+    probe.reset(50);
+    TEST_ASSERT_EQUAL(SensorProbe::READY, probe.poll(50));
+    TEST_ASSERT_EQUAL(1, probe.getAttempts());
+    TEST_ASSERT_EQUAL(50, timeline.get(BOOT_SENSOR));
+
+    // Later polls do not touch the bus again
+    TEST_ASSERT_EQUAL(SensorProbe::READY, probe.poll(5000));
+    TEST_ASSERT_EQUAL(1, probe.getAttempts());
+}
+
+void test_late_sensor_is_retried_at_the_interval()
+{
+    sensor.missingBegins = 3;
+    SensorProbe probe(sensor, timeline);
+    probe.reset(0);
+    uint32_t took = probeUntilDone(probe, 0, 10 * SENSOR_RETRY_INTERVAL);
+    TEST_ASSERT_EQUAL(SensorProbe::READY, probe.getState());
+    TEST_ASSERT_EQUAL(4, probe.getAttempts());
+    TEST_ASSERT_EQUAL(3 * SENSOR_RETRY_INTERVAL, took);
+    TEST_ASSERT_EQUAL(3 * SENSOR_RETRY_INTERVAL, timeline.get(BOOT_SENSOR));
+}
+
+void test_missing_sensor_gives_up()
+{
+    sensor.missingBegins = -1;
+    SensorProbe probe(sensor, timeline);
+    probe.reset(1000);
+    uint32_t took = probeUntilDone(probe, 1000, 10 * SENSOR_GIVE_UP_TIME);
+    TEST_ASSERT_EQUAL(SensorProbe::GAVE_UP, probe.getState());
+    TEST_ASSERT_TRUE(took >= SENSOR_GIVE_UP_TIME && took < SENSOR_GIVE_UP_TIME + SENSOR_RETRY_INTERVAL);
+    TEST_ASSERT_EQUAL(SENSOR_GIVE_UP_TIME / SENSOR_RETRY_INTERVAL + 1, probe.getAttempts());
+    TEST_ASSERT_FALSE(timeline.reached(BOOT_SENSOR));
+
+    // Gave up for good, the caller powers off
+    TEST_ASSERT_EQUAL(SensorProbe::GAVE_UP, probe.poll(1000 + 20 * SENSOR_GIVE_UP_TIME));
+}
+
+void test_probe_across_the_millis_wrap()
+{
+    sensor.missingBegins = 2;
+    SensorProbe probe(sensor, timeline);
+    uint32_t start = UINT32_MAX - SENSOR_RETRY_INTERVAL / 2;
+    probe.reset(start);
+    TEST_ASSERT_EQUAL(2 * SENSOR_RETRY_INTERVAL, probeUntilDone(probe, start, 10 * SENSOR_RETRY_INTERVAL));
+    TEST_ASSERT_EQUAL(SensorProbe::READY, probe.getState());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_phases_keep_their_first_mark);
+    RUN_TEST(test_first_mark_wins_across_tasks);
+    RUN_TEST(test_sensor_answers_on_the_first_try);
+    RUN_TEST(test_late_sensor_is_retried_at_the_interval);
+    RUN_TEST(test_missing_sensor_gives_up);
+    RUN_TEST(test_probe_across_the_millis_wrap);
+    return UNITY_END();
+}
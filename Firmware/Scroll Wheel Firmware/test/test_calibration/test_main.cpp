@@ -0,0 +1,228 @@
+#include <math.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include "calibration.h"
+#include "config.h"
+#include "defaults.h"
+#include "fakes.h"
+#include "rotary-sensor.h"
+
+// Linearity table checks, the fitter on simulated steady spins of a clean and
+// a distorted sensor, and the sampler side switching tables under a wheel.
+
+// Raw angle of a sensor mounted off centre over a 7 magnet wheel
+static double distortedAngle(double counts, double eccentric, double ripple)
+{
+    double turn = counts * 2 * M_PI / ENCODER_COUNTS;
+    return counts + eccentric * sin(turn + 0.7) + ripple * sin(7 * turn);
+}
+
+// Largest deviation from a uniform angle over one turn, the constant phase removed
+static double peakError(double eccentric, double ripple, const CalibrationTable &table)
+{
+    const int steps = ENCODER_COUNTS * 4;
+    static double errors[steps];
+    double mean = 0;
+    for (int i = 0; i < steps; i++)
+    {
+        double counts = i / 4.0;
+        int16_t raw = (int32_t)lround(distortedAngle(counts, eccentric, ripple)) & (ENCODER_COUNTS - 1);
+        errors[i] = remainder(correctAngle(table, raw) - counts, ENCODER_COUNTS);
+        mean += errors[i] / steps;
+    }
+    double peak = 0;
+    for (int i = 0; i < steps; i++)
+    {
+        peak = fmax(peak, fabs(remainder(errors[i] - mean, ENCODER_COUNTS)));
+    }
+    return peak;
+}
+
+// Hand spin at 180 deg/s with +-2 % speed wobble and +-1 count of noise
+static void spin(CalibrationFitter &fitter, double eccentric, double ripple, size_t maxSamples)
+{
+    double position = 0;
+    double step = degreesToCounts(180) / SAMPLE_RATE_HZ;
+    for (size_t samples = 0; fitter.getRevolutions() < CALIBRATION_REVOLUTIONS && samples < maxSamples; samples++)
+    {
+        position += step * (1 + 0.02 * sin(samples * 2 * M_PI / 3000));
+        int32_t raw = (int32_t)lround(distortedAngle(position, eccentric, ripple)) + (rand() % 3) - 1;
+        fitter.addSample(raw & (ENCODER_COUNTS - 1));
+    }
+}
+
+void setUp()
+{
+    srand(1);
+    publishConfig(defaultConfig());
+    publishCalibration(identityCalibration());
+}
+
+void tearDown()
+{
+}
+
+void test_identity_leaves_angles_alone()
+{
+    CalibrationTable table = identityCalibration();
+    TEST_ASSERT_TRUE(isValidCalibration(table));
+    for (int16_t angle = 0; angle < ENCODER_COUNTS; angle++)
+    {
+        TEST_ASSERT_EQUAL(angle, correctAngle(table, angle));
+    }
+}
+
+void test_invalid_tables_are_refused()
+{
+    CalibrationTable table = identityCalibration();
+    table.version = CALIBRATION_VERSION + 1;
+    TEST_ASSERT_FALSE(publishCalibration(table));
+
+    table = identityCalibration();
+    table.offset[3] = (ENCODER_COUNTS / 4) << CALIBRATION_Q;
+    TEST_ASSERT_FALSE(isValidCalibration(table));
+
+    // The corrected angle would run backwards between knots 10 and 11
+    table = identityCalibration();
+    table.offset[10] = (CALIBRATION_SPAN + 1) << CALIBRATION_Q;
+    TEST_ASSERT_FALSE(isValidCalibration(table));
+}
+
+void test_no_fit_before_enough_turns()
+{
+    CalibrationFitter fitter;
+    spin(fitter, 40, 12, CALIBRATION_REVOLUTIONS * 2 * SAMPLE_RATE_HZ);
+    TEST_ASSERT_TRUE(fitter.getRevolutions() < CALIBRATION_REVOLUTIONS);
+    CalibrationTable table;
+    TEST_ASSERT_FALSE(fitter.fit(table));
+}
+
+void test_clean_sensor_gets_no_table()
+{
+    CalibrationFitter fitter;
+    spin(fitter, 0, 0, 100 * SAMPLE_RATE_HZ);
+    TEST_ASSERT_EQUAL(CALIBRATION_REVOLUTIONS, fitter.getRevolutions());
+    CalibrationTable table;
+    TEST_ASSERT_FALSE(fitter.fit(table));
+}
+
+void test_distorted_sensor_is_corrected()
+{
+    const double distortions[][2] = {{40, 0}, {0, 12}, {40, 12}};
+    for (const double *distortion : distortions)
+    {
+        CalibrationFitter fitter;
+        spin(fitter, distortion[0], distortion[1], 100 * SAMPLE_RATE_HZ);
+        CalibrationTable table;
+        TEST_ASSERT_TRUE(fitter.fit(table));
+        TEST_ASSERT_TRUE(peakError(distortion[0], distortion[1], table) < 5);
+        TEST_ASSERT_TRUE(peakError(distortion[0], distortion[1], table) * 2 < peakError(distortion[0], distortion[1], identityCalibration()));
+    }
+}
+
+void test_unsteady_turns_are_rejected()
+{
+    // Every turn 20 % faster than the one before
+    CalibrationFitter fitter;
+    double position = 0;
+    double step = degreesToCounts(90) / SAMPLE_RATE_HZ;
+    for (int samples = 0; samples < 60 * SAMPLE_RATE_HZ && position < 20 * ENCODER_COUNTS; samples++)
+    {
+        position += step * pow(1.2, floor(position / ENCODER_COUNTS));
+        fitter.addSample((int32_t)lround(position) & (ENCODER_COUNTS - 1));
+    }
+    TEST_ASSERT_EQUAL(0, fitter.getRevolutions());
+    TEST_ASSERT_TRUE(fitter.getRejected() > 10);
+}
+
+void test_new_table_at_rest_scrolls_nothing()
+{
+    FakeAngleSensor sensor;
+    sensor.angle = 1000;
+    RotarySensor rotary(sensor);
+    int64_t reported = 0;
+    for (int i = 0; i < 500; i++)
+    {
+        reported += rotary.getScrollValue(1);
+    }
+
+    // A table that moves every angle by 100 counts
+    CalibrationTable table = identityCalibration();
+    for (int i = 0; i < CALIBRATION_POINTS; i++)
+    {
+        table.offset[i] = 100 << CALIBRATION_Q;
+    }
+    TEST_ASSERT_TRUE(publishCalibration(table));
+    for (int i = 0; i < 500; i++)
+    {
+        reported += rotary.getScrollValue(1);
+    }
+    TEST_ASSERT_EQUAL(0, reported);
+    TEST_ASSERT_EQUAL(1100, rotary.getLastAngle());
+    TEST_ASSERT_FALSE(rotary.isMoving());
+}
+
+void test_new_table_while_turning_keeps_the_speed()
+{
+    // The same turn with and without a table switch half way, the switch must not add a step
+    int64_t totals[2];
+    for (int run = 0; run < 2; run++)
+    {
+        publishCalibration(identityCalibration());
+        FakeAngleSensor sensor;
+        RotarySensor rotary(sensor);
+        int64_t reported = 0;
+        for (int i = 0; i < 600; i++)
+        {
+            sensor.angle = (1000 + (i > 100 && i < 500 ? (i - 100) * 2 : i >= 500 ? 800 : 0)) & (ENCODER_COUNTS - 1);
+            if (run == 1 && i == 300)
+            {
+                CalibrationTable table = identityCalibration();
+                for (int k = 0; k < CALIBRATION_POINTS; k++)
+                {
+                    table.offset[k] = -300 << CALIBRATION_Q;
+                }
+                TEST_ASSERT_TRUE(publishCalibration(table));
+            }
+            reported += rotary.getScrollValue(1);
+        }
+        totals[run] = reported;
+    }
+    TEST_ASSERT_TRUE(totals[0] != 0);
+    TEST_ASSERT_INT_WITHIN(1, totals[0], totals[1]);
+}
+
+void test_failed_read_is_flagged()
+{
+    FakeAngleSensor sensor;
+    sensor.angle = 1000;
+    RotarySensor rotary(sensor);
+    rotary.getScrollValue(1);
+    TEST_ASSERT_TRUE(rotary.isReadOk());
+
+    sensor.angle = -1;
+    TEST_ASSERT_EQUAL(0, rotary.getScrollValue(1));
+    TEST_ASSERT_FALSE(rotary.isReadOk());
+    TEST_ASSERT_EQUAL(1000, rotary.getRawAngle());
+    TEST_ASSERT_EQUAL(1, rotary.getReadErrors());
+
+    sensor.angle = 1001;
+    rotary.getScrollValue(1);
+    TEST_ASSERT_TRUE(rotary.isReadOk());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_identity_leaves_angles_alone);
+    RUN_TEST(test_invalid_tables_are_refused);
+    RUN_TEST(test_no_fit_before_enough_turns);
+    RUN_TEST(test_clean_sensor_gets_no_table);
+    RUN_TEST(test_distorted_sensor_is_corrected);
+    RUN_TEST(test_unsteady_turns_are_rejected);
+    RUN_TEST(test_new_table_at_rest_scrolls_nothing);
+    RUN_TEST(test_new_table_while_turning_keeps_the_speed);
+    RUN_TEST(test_failed_read_is_flagged);
+    return UNITY_END();
+}
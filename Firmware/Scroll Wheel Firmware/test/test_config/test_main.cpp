@@ -0,0 +1,272 @@
+#include <string.h>
+#include <thread>
+#include <unity.h>
+
+#include "config.h"
+#include "double-buffer.h"
+
+// Config layouts, migration of older blobs, field access and the double
+// buffer that hands snapshots to the sampler.
+
+// The layouts as earlier firmware stored them
+struct __attribute__((packed)) ConfigV1
+{
+    uint8_t version;
+    uint16_t scrollGain;
+    uint16_t maxRotation;
+    uint16_t noiseBandMin;
+    uint16_t noiseBandMax;
+    uint8_t noiseBandGain;
+    uint8_t accelCurve;
+    uint32_t idleTimeout;
+    uint32_t offTimeout;
+};
+
+struct __attribute__((packed)) ConfigV2
+{
+    ConfigV1 v1;
+    uint16_t flywheelDecay;
+    uint16_t flywheelMinSpeed;
+};
+
+struct __attribute__((packed)) ConfigV3
+{
+    ConfigV2 v2;
+    uint8_t wheelMode;
+    uint16_t modeStep; // Counts per step
+    uint16_t keyUp;
+    uint16_t keyDown;
+};
+
+static_assert(sizeof(ConfigV3) == sizeof(ScrollConfig), "Version 4 only changed the unit of modeSteps");
+
+static ConfigV1 tunedV1()
+{
+    ScrollConfig defaults = defaultConfig();
+    ConfigV1 v1;
+    memcpy(&v1, &defaults, sizeof(v1));
+    v1.version = 1;
+    v1.scrollGain = 500;
+    v1.noiseBandGain = 5;
+    v1.idleTimeout = 7000;
+    v1.offTimeout = 0;
+    return v1;
+}
+
+void setUp()
+{
+    publishConfig(defaultConfig());
+}
+
+void tearDown()
+{
+}
+
+void test_defaults_are_valid()
+{
+    ScrollConfig config = defaultConfig();
+    TEST_ASSERT_EQUAL(CONFIG_VERSION, config.version);
+    TEST_ASSERT_TRUE(isValidConfig(config));
+}
+
+void test_current_layout_loads_as_is()
+{
+    ScrollConfig stored = defaultConfig();
+    stored.scrollGain = 1234;
+    stored.wheelMode = 1;
+    ScrollConfig config;
+    TEST_ASSERT_TRUE(migrateConfig(&stored, sizeof(stored), config));
+    TEST_ASSERT_EQUAL_MEMORY(&stored, &config, sizeof(config));
+}
+
+void test_version_1_keeps_its_fields()
+{
+    ConfigV1 v1 = tunedV1();
+    ScrollConfig config;
+    TEST_ASSERT_TRUE(migrateConfig(&v1, sizeof(v1), config));
+    ScrollConfig defaults = defaultConfig();
+    TEST_ASSERT_EQUAL(CONFIG_VERSION, config.version);
+    TEST_ASSERT_EQUAL(500, config.scrollGain);
+    TEST_ASSERT_EQUAL(5, config.noiseBandGain);
+    TEST_ASSERT_EQUAL(7000, config.idleTimeout);
+    TEST_ASSERT_EQUAL(0, config.offTimeout);
+    TEST_ASSERT_EQUAL(defaults.flywheelDecay, config.flywheelDecay);
+    TEST_ASSERT_EQUAL(defaults.wheelMode, config.wheelMode);
+    TEST_ASSERT_EQUAL(defaults.modeSteps, config.modeSteps);
+    TEST_ASSERT_EQUAL(defaults.keyUp, config.keyUp);
+}
+
+void test_version_2_keeps_the_flywheel()
+{
+    ConfigV2 v2;
+    v2.v1 = tunedV1();
+    v2.v1.version = 2;
+    v2.flywheelDecay = 300;
+    v2.flywheelMinSpeed = 90;
+    ScrollConfig config;
+    TEST_ASSERT_TRUE(migrateConfig(&v2, sizeof(v2), config));
+    TEST_ASSERT_EQUAL(500, config.scrollGain);
+    TEST_ASSERT_EQUAL(300, config.flywheelDecay);
+    TEST_ASSERT_EQUAL(90, config.flywheelMinSpeed);
+    TEST_ASSERT_EQUAL(defaultConfig().modeSteps, config.modeSteps);
+}
+
+void test_version_3_converts_the_mode_step()
+{
+    ConfigV3 v3;
+    v3.v2.v1 = tunedV1();
+    v3.v2.v1.version = 3;
+    v3.v2.flywheelDecay = 300;
+    v3.v2.flywheelMinSpeed = 90;
+    v3.wheelMode = 1;
+    v3.modeStep = 171; // 15 degrees as version 3 stored them
+    v3.keyUp = 0xB5;
+    v3.keyDown = 0xB6;
+    ScrollConfig config;
+    TEST_ASSERT_TRUE(migrateConfig(&v3, sizeof(v3), config));
+    TEST_ASSERT_EQUAL(1, config.wheelMode);
+    TEST_ASSERT_EQUAL(24, config.modeSteps);
+    TEST_ASSERT_EQUAL(0xB5, config.keyUp);
+
+    v3.modeStep = 4096;
+    TEST_ASSERT_TRUE(migrateConfig(&v3, sizeof(v3), config));
+    TEST_ASSERT_EQUAL(1, config.modeSteps);
+
+    v3.modeStep = 0;
+    TEST_ASSERT_FALSE(migrateConfig(&v3, sizeof(v3), config));
+}
+
+void test_unknown_or_truncated_blobs_are_dropped()
+{
+    ScrollConfig config = defaultConfig();
+    ScrollConfig untouched = config;
+
+    ScrollConfig future = defaultConfig();
+    future.version = CONFIG_VERSION + 1;
+    TEST_ASSERT_FALSE(migrateConfig(&future, sizeof(future), config));
+
+    ScrollConfig zero = defaultConfig();
+    zero.version = 0;
+    TEST_ASSERT_FALSE(migrateConfig(&zero, sizeof(zero), config));
+
+    // A version 1 header on a longer blob, and a current one cut short
+    ConfigV1 v1 = tunedV1();
+    uint8_t padded[sizeof(v1) + 2] = {};
+    memcpy(padded, &v1, sizeof(v1));
+    TEST_ASSERT_FALSE(migrateConfig(padded, sizeof(padded), config));
+    ScrollConfig current = defaultConfig();
+    TEST_ASSERT_FALSE(migrateConfig(&current, sizeof(current) - 1, config));
+    TEST_ASSERT_FALSE(migrateConfig(&current, 0, config));
+
+    TEST_ASSERT_EQUAL_MEMORY(&untouched, &config, sizeof(config));
+}
+
+void test_invalid_values_are_dropped()
+{
+    ConfigV1 v1 = tunedV1();
+    v1.noiseBandMin = v1.noiseBandMax + 1;
+    ScrollConfig config = defaultConfig();
+    TEST_ASSERT_FALSE(migrateConfig(&v1, sizeof(v1), config));
+    TEST_ASSERT_EQUAL(defaultConfig().noiseBandMin, config.noiseBandMin);
+
+    ScrollConfig bad = defaultConfig();
+    bad.accelCurve = 200;
+    TEST_ASSERT_FALSE(isValidConfig(bad));
+    TEST_ASSERT_FALSE(publishConfig(bad));
+    TEST_ASSERT_EQUAL(defaultConfig().accelCurve, getConfig().accelCurve);
+}
+
+void test_fields_by_name()
+{
+    ScrollConfig config = defaultConfig();
+    TEST_ASSERT_TRUE(setConfigField(config, "gain", 700));
+    TEST_ASSERT_TRUE(setConfigField(config, "off_timeout", 100000));
+    TEST_ASSERT_FALSE(setConfigField(config, "band_gain", 256)); // One byte wide
+    TEST_ASSERT_FALSE(setConfigField(config, "no_such_field", 1));
+    TEST_ASSERT_EQUAL(700, config.scrollGain);
+    TEST_ASSERT_EQUAL(100000, config.offTimeout);
+    for (int i = 0; i < CONFIG_FIELD_COUNT; i++)
+    {
+        if (strcmp(CONFIG_FIELDS[i].name, "gain") == 0)
+        {
+            TEST_ASSERT_EQUAL(700, getConfigField(config, CONFIG_FIELDS[i]));
+        }
+    }
+}
+
+void test_double_buffer_backs_off_while_the_spare_is_held()
+{
+    DoubleBuffer<int> buffer(1);
+    TEST_ASSERT_EQUAL(1, buffer.acquire());
+    buffer.release();
+
+    TEST_ASSERT_TRUE(buffer.publish(2));
+    const int &held = buffer.acquire();
+    TEST_ASSERT_EQUAL(2, held);
+
+    // The next publish writes the other copy, the one after that would be the held one
+    TEST_ASSERT_TRUE(buffer.publish(3));
+    TEST_ASSERT_FALSE(buffer.publish(4));
+    TEST_ASSERT_EQUAL(2, held);
+    TEST_ASSERT_EQUAL(3, buffer.current());
+    buffer.release();
+
+    TEST_ASSERT_TRUE(buffer.publish(4));
+    TEST_ASSERT_EQUAL(4, buffer.acquire());
+    buffer.release();
+}
+
+struct Pair
+{
+    uint32_t a;
+    uint32_t b; // Always a + 1 in a published copy
+};
+
+void test_reader_never_sees_a_torn_copy()
+{
+    DoubleBuffer<Pair> buffer({0, 1});
+    std::atomic<bool> done{false};
+    std::thread writer([&]() {
+        for (uint32_t i = 1; i < 100000; i++)
+        {
+            while (!buffer.publish({i, i + 1}))
+            {
+                std::this_thread::yield();
+            }
+        }
+        done = true;
+    });
+
+    uint32_t torn = 0;
+    uint32_t before = 0;
+    bool backwards = false;
+    while (!done)
+    {
+        const Pair &pair = buffer.acquire();
+        uint32_t a = pair.a;
+        std::this_thread::yield(); // Hold it while the writer runs
+        torn += pair.b != a + 1 || pair.a != a;
+        backwards |= a < before;
+        before = a;
+        buffer.release();
+    }
+    writer.join();
+    TEST_ASSERT_EQUAL(0, torn);
+    TEST_ASSERT_FALSE(backwards);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_defaults_are_valid);
+    RUN_TEST(test_current_layout_loads_as_is);
+    RUN_TEST(test_version_1_keeps_its_fields);
+    RUN_TEST(test_version_2_keeps_the_flywheel);
+    RUN_TEST(test_version_3_converts_the_mode_step);
+    RUN_TEST(test_unknown_or_truncated_blobs_are_dropped);
+    RUN_TEST(test_invalid_values_are_dropped);
+    RUN_TEST(test_fields_by_name);
+    RUN_TEST(test_double_buffer_backs_off_while_the_spare_is_held);
+    RUN_TEST(test_reader_never_sees_a_torn_copy);
+    return UNITY_END();
+}
@@ -0,0 +1,191 @@
+#include <thread>
+#include <unity.h>
+
+#include "conn-params.h"
+#include "defaults.h"
+#include "fakes.h"
+
+// Connection parameter policy on a simulated ms clock, with a link that
+// accepts or rejects the requests.
+
+static FakeLinkControl link;
+
+// Runs update every CONN_UPDATE_INTERVAL from start up to end, as the reporter does
+static void run(ConnParamPolicy &policy, uint32_t start, uint32_t end)
+{
+    for (uint32_t now = start; now < end; now += CONN_UPDATE_INTERVAL)
+    {
+        policy.update(now);
+    }
+}
+
+static bool isFast(const ConnParams &params)
+{
+    return params.minInterval == CONN_FAST_MIN_INTERVAL && params.latency == 0;
+}
+
+void setUp()
+{
+    link = FakeLinkControl();
+}
+
+void tearDown()
+{
+}
+
+void test_waits_for_the_host_before_asking()
+{
+    ConnParamPolicy policy(link);
+    policy.onConnect(0);
+    run(policy, 0, CONN_SETUP_DELAY);
+    TEST_ASSERT_EQUAL(ConnParamPolicy::CONNECTED, policy.getState());
+    TEST_ASSERT_EQUAL(0, link.requests.size());
+
+    policy.update(CONN_SETUP_DELAY);
+    TEST_ASSERT_EQUAL(ConnParamPolicy::FAST, policy.getState());
+    TEST_ASSERT_EQUAL(1, link.requests.size());
+    TEST_ASSERT_TRUE(isFast(link.requests[0]));
+}
+
+void test_idles_and_wakes_on_motion()
+{
+    ConnParamPolicy policy(link);
+    policy.onConnect(0);
+    run(policy, 0, CONN_SETUP_DELAY + CONN_IDLE_TIMEOUT + CONN_UPDATE_INTERVAL);
+    TEST_ASSERT_EQUAL(ConnParamPolicy::IDLE, policy.getState());
+    TEST_ASSERT_EQUAL(2, link.requests.size());
+    TEST_ASSERT_EQUAL(CONN_IDLE_LATENCY, link.requests[1].latency);
+
+    // Motion asks right away, not with the next update
+    policy.onMotion(6000);
+    TEST_ASSERT_EQUAL(ConnParamPolicy::FAST, policy.getState());
+    TEST_ASSERT_EQUAL(3, link.requests.size());
+    TEST_ASSERT_TRUE(isFast(link.requests[2]));
+}
+
+void test_hold_fast_stays_fast()
+{
+    ConnParamPolicy policy(link);
+    policy.setHoldFast(true);
+    policy.onConnect(0);
+    run(policy, 0, 60000);
+    TEST_ASSERT_EQUAL(ConnParamPolicy::FAST, policy.getState());
+    TEST_ASSERT_EQUAL(1, link.requests.size());
+}
+
+void test_rejected_request_is_retried_with_back_off()
+{
+    ConnParamPolicy policy(link);
+    policy.setHoldFast(true);
+    link.accept = false;
+    policy.onConnect(0);
+    run(policy, 0, CONN_SETUP_DELAY + CONN_UPDATE_INTERVAL);
+    TEST_ASSERT_EQUAL(1, link.requests.size());
+
+    // The gap between requests doubles up to CONN_RETRY_MAX
+    uint32_t last = CONN_SETUP_DELAY;
+    uint32_t gap = CONN_RETRY_DELAY;
+    for (uint32_t now = CONN_SETUP_DELAY + CONN_UPDATE_INTERVAL; now < 120000; now += CONN_UPDATE_INTERVAL)
+    {
+        size_t requests = link.requests.size();
+        policy.update(now);
+        if (link.requests.size() != requests)
+        {
+            // The rejection is seen one update after the request
+            TEST_ASSERT_EQUAL(gap + CONN_UPDATE_INTERVAL, now - last);
+            TEST_ASSERT_TRUE(isFast(link.requests.back()));
+            last = now;
+            gap = gap * 2 > CONN_RETRY_MAX ? CONN_RETRY_MAX : gap * 2;
+        }
+    }
+    TEST_ASSERT_EQUAL(CONN_RETRY_MAX, gap);
+
+    // Accepted, no more requests
+    link.accept = true;
+    run(policy, 120000, 120000 + CONN_RETRY_MAX + 2 * CONN_UPDATE_INTERVAL);
+    size_t requests = link.requests.size();
+    run(policy, 120000 + CONN_RETRY_MAX + 2 * CONN_UPDATE_INTERVAL, 300000);
+    TEST_ASSERT_EQUAL(requests, link.requests.size());
+}
+
+void test_host_rejection_is_retried()
+{
+    ConnParamPolicy policy(link);
+    policy.setHoldFast(true);
+    policy.onConnect(0);
+    run(policy, 0, CONN_SETUP_DELAY + CONN_UPDATE_INTERVAL);
+    TEST_ASSERT_EQUAL(1, link.requests.size());
+
+    policy.onParamsUpdated(false, 0, 0, 0);
+    uint32_t rejected = CONN_SETUP_DELAY + CONN_UPDATE_INTERVAL;
+    run(policy, rejected, rejected + CONN_RETRY_DELAY);
+    TEST_ASSERT_EQUAL(1, link.requests.size());
+    policy.update(rejected + CONN_RETRY_DELAY);
+    TEST_ASSERT_EQUAL(2, link.requests.size());
+
+    policy.onParamsUpdated(true, CONN_FAST_MIN_INTERVAL, 0, CONN_FAST_TIMEOUT);
+    run(policy, rejected + CONN_RETRY_DELAY, 60000);
+    TEST_ASSERT_EQUAL(2, link.requests.size());
+    TEST_ASSERT_EQUAL(CONN_FAST_MIN_INTERVAL, policy.getInterval());
+    TEST_ASSERT_EQUAL(0, policy.getLatency());
+    TEST_ASSERT_EQUAL(CONN_FAST_TIMEOUT, policy.getTimeout());
+    TEST_ASSERT_EQUAL(1, policy.getRejected());
+}
+
+void test_disconnect_stops_retrying()
+{
+    ConnParamPolicy policy(link);
+    link.accept = false;
+    policy.onConnect(0);
+    run(policy, 0, CONN_SETUP_DELAY + CONN_UPDATE_INTERVAL);
+    policy.onDisconnect();
+    run(policy, CONN_SETUP_DELAY + CONN_UPDATE_INTERVAL, 60000);
+    TEST_ASSERT_EQUAL(ConnParamPolicy::DISCONNECTED, policy.getState());
+    TEST_ASSERT_EQUAL(1, link.requests.size());
+    TEST_ASSERT_EQUAL(0, policy.getInterval());
+}
+
+void test_stack_events_from_another_task()
+{
+    // The stack posts connects, parameter updates and disconnects while the
+    // reporter runs the policy, the last event wins
+    ConnParamPolicy policy(link);
+    std::thread stack([&policy]() {
+        for (int i = 0; i < 20000; i++)
+        {
+            policy.onConnect(0);
+            policy.onParamsUpdated(i % 3 != 0, CONN_FAST_MIN_INTERVAL, 0, CONN_FAST_TIMEOUT);
+            policy.onDisconnect();
+            if (i % 64 == 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+        policy.onConnect(0);
+        policy.onParamsUpdated(true, CONN_IDLE_MIN_INTERVAL, CONN_IDLE_LATENCY, CONN_IDLE_SUPERVISION);
+    });
+    for (int i = 0; i < 20000; i++)
+    {
+        policy.update(1);
+        policy.onMotion(1);
+    }
+    stack.join();
+    policy.update(1);
+    TEST_ASSERT_EQUAL(ConnParamPolicy::CONNECTED, policy.getState());
+    TEST_ASSERT_EQUAL(CONN_IDLE_MIN_INTERVAL, policy.getInterval());
+    TEST_ASSERT_EQUAL(CONN_IDLE_LATENCY, policy.getLatency());
+    TEST_ASSERT_EQUAL(CONN_IDLE_SUPERVISION, policy.getTimeout());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_waits_for_the_host_before_asking);
+    RUN_TEST(test_idles_and_wakes_on_motion);
+    RUN_TEST(test_hold_fast_stays_fast);
+    RUN_TEST(test_rejected_request_is_retried_with_back_off);
+    RUN_TEST(test_host_rejection_is_retried);
+    RUN_TEST(test_disconnect_stops_retrying);
+    RUN_TEST(test_stack_events_from_another_task);
+    return UNITY_END();
+}
@@ -0,0 +1,256 @@
+#include <math.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include "config.h"
+#include "defaults.h"
+#include "fakes.h"
+#include "rotary-sensor.h"
+#include "scroll-math.h"
+
+// Flywheel release and coasting on a simulated 1 ms sample clock: flicks that
+// run down, a hand grabbing the spinning wheel, touches and new motion.
+
+static const uint8_t HIRES_MULTIPLIER = 120; // WHEEL_HIRES_MULTIPLIER, BleMouse.h is ESP32 only
+static const uint32_t DECAY = 400;
+
+static FakeAngleSensor sensor;
+static double position;
+static int64_t reported; // Report units over all samples run
+
+static ScrollConfig flywheelConfig()
+{
+    ScrollConfig config = defaultConfig();
+    config.flywheelDecay = DECAY;
+    return config;
+}
+
+static int32_t sample(RotarySensor &rotary, uint8_t multiplier)
+{
+    sensor.angle = (int32_t)floor(position) & (ENCODER_COUNTS - 1);
+    int32_t value = rotary.getScrollValue(multiplier);
+    reported += value;
+    return value;
+}
+
+// Turns from startSpeed to endSpeed in deg/s over the given ms, linearly
+static void spin(RotarySensor &rotary, double startSpeed, double endSpeed, uint32_t ms, uint8_t multiplier = 1)
+{
+    for (uint32_t i = 0; i < ms; i++)
+    {
+        double speed = startSpeed + (endSpeed - startSpeed) * i / ms;
+        position += degreesToCounts(speed) / SAMPLE_RATE_HZ;
+        sample(rotary, multiplier);
+    }
+}
+
+// Holds the wheel still for the given ms, returns the units reported meanwhile
+static int64_t hold(RotarySensor &rotary, uint32_t ms, uint8_t multiplier = 1)
+{
+    int64_t before = reported;
+    for (uint32_t i = 0; i < ms; i++)
+    {
+        sample(rotary, multiplier);
+    }
+    return reported - before;
+}
+
+// Samples until coasting ends, returns its length in ms
+static uint32_t coast(RotarySensor &rotary, uint8_t multiplier = 1)
+{
+    uint32_t ms = 0;
+    while (rotary.getFlywheel().isCoasting() && ms < 60000)
+    {
+        sample(rotary, multiplier);
+        ms++;
+    }
+    return ms;
+}
+
+// A flick as a finger does it: up to speed in 40 ms, let go, friction stops it in 30 ms
+static void flick(RotarySensor &rotary, double speed, uint8_t multiplier = 1)
+{
+    spin(rotary, 0, speed, 40, multiplier);
+    spin(rotary, speed, 0, 30, multiplier);
+}
+
+void setUp()
+{
+    srand(1);
+    sensor = FakeAngleSensor();
+    position = ENCODER_COUNTS / 4;
+    reported = 0;
+    publishConfig(flywheelConfig());
+}
+
+void tearDown()
+{
+}
+
+void test_flick_that_runs_down_coasts()
+{
+    RotarySensor rotary(sensor);
+    hold(rotary, 500);
+    flick(rotary, 1440);
+    int64_t turned = reported;
+    TEST_ASSERT_EQUAL(0, hold(rotary, FLYWHEEL_RELEASE_TIME - 1));
+    TEST_ASSERT_FALSE(rotary.getFlywheel().isCoasting());
+    hold(rotary, 1);
+    TEST_ASSERT_TRUE(rotary.getFlywheel().isCoasting());
+
+    uint32_t ms = coast(rotary);
+    TEST_ASSERT_TRUE(ms > DECAY && ms < 6 * DECAY);
+    TEST_ASSERT_TRUE(reported - turned > 0);
+    TEST_ASSERT_EQUAL(0, hold(rotary, 2000));
+}
+
+void test_flick_down_coasts_down()
+{
+    RotarySensor rotary(sensor);
+    hold(rotary, 500);
+    flick(rotary, -1440);
+    int64_t turned = reported;
+    hold(rotary, FLYWHEEL_RELEASE_TIME);
+    TEST_ASSERT_TRUE(rotary.getFlywheel().isCoasting());
+    coast(rotary);
+    TEST_ASSERT_TRUE(reported - turned < 0);
+}
+
+void test_grabbed_wheel_does_not_coast()
+{
+    // Spinning at full speed, then a hand stops it dead
+    RotarySensor rotary(sensor);
+    hold(rotary, 500);
+    spin(rotary, 0, 1440, 40);
+    spin(rotary, 1440, 1440, 60);
+    TEST_ASSERT_EQUAL(0, hold(rotary, 2000));
+    TEST_ASSERT_FALSE(rotary.getFlywheel().isCoasting());
+}
+
+void test_grab_after_slowing_a_little_does_not_coast()
+{
+    // Braked over a few ms only, most of the speed is still there at the stop
+    RotarySensor rotary(sensor);
+    hold(rotary, 500);
+    spin(rotary, 0, 1440, 40);
+    spin(rotary, 1440, 1100, 5);
+    TEST_ASSERT_EQUAL(0, hold(rotary, 2000));
+}
+
+void test_slow_flick_does_not_coast()
+{
+    RotarySensor rotary(sensor);
+    hold(rotary, 500);
+    flick(rotary, 90);
+    TEST_ASSERT_EQUAL(0, hold(rotary, 2000));
+}
+
+void test_motion_stops_coasting()
+{
+    RotarySensor rotary(sensor);
+    hold(rotary, 500);
+    flick(rotary, 1440);
+    hold(rotary, FLYWHEEL_RELEASE_TIME + 50);
+    TEST_ASSERT_TRUE(rotary.getFlywheel().isCoasting());
+
+    // Turned back by hand, only that turn is reported
+    int64_t before = reported;
+    spin(rotary, -90, -90, 100);
+    TEST_ASSERT_FALSE(rotary.getFlywheel().isCoasting());
+    TEST_ASSERT_TRUE(reported - before < 0);
+}
+
+void test_touch_inside_the_band_stops_coasting()
+{
+    RotarySensor rotary(sensor);
+    hold(rotary, 500);
+    flick(rotary, 1440);
+    hold(rotary, FLYWHEEL_RELEASE_TIME + 50);
+    TEST_ASSERT_TRUE(rotary.getFlywheel().isCoasting());
+
+    // A finger lands on the wheel and moves it two counts, less than a notch
+    position += 2;
+    sample(rotary, 1);
+    TEST_ASSERT_FALSE(rotary.getFlywheel().isCoasting());
+    TEST_ASSERT_EQUAL(0, hold(rotary, 2000));
+}
+
+void test_touch_before_the_release_cancels_it()
+{
+    RotarySensor rotary(sensor);
+    hold(rotary, 500);
+    flick(rotary, 1440);
+    hold(rotary, FLYWHEEL_RELEASE_TIME / 2);
+    position -= 2;
+    TEST_ASSERT_EQUAL(0, hold(rotary, 2000));
+    TEST_ASSERT_FALSE(rotary.getFlywheel().isCoasting());
+}
+
+void test_count_jitter_keeps_coasting()
+{
+    // Stopped between two counts, the reading flips between them
+    RotarySensor rotary(sensor);
+    hold(rotary, 500);
+    flick(rotary, 1440);
+    double rest = floor(position);
+    hold(rotary, FLYWHEEL_RELEASE_TIME);
+    TEST_ASSERT_TRUE(rotary.getFlywheel().isCoasting());
+    for (int i = 0; i < 200; i++)
+    {
+        position = rest + rand() % 2;
+        sample(rotary, 1);
+    }
+    TEST_ASSERT_TRUE(rotary.getFlywheel().isCoasting());
+}
+
+void test_hires_coasts_the_same_distance()
+{
+    RotarySensor notches(sensor);
+    hold(notches, 500);
+    flick(notches, 1440);
+    int64_t turned = reported;
+    hold(notches, FLYWHEEL_RELEASE_TIME);
+    coast(notches);
+    int64_t coastedNotches = reported - turned;
+
+    position = ENCODER_COUNTS / 4;
+    reported = 0;
+    RotarySensor hires(sensor);
+    hold(hires, 500, HIRES_MULTIPLIER);
+    flick(hires, 1440, HIRES_MULTIPLIER);
+    turned = reported;
+    hold(hires, FLYWHEEL_RELEASE_TIME, HIRES_MULTIPLIER);
+    coast(hires, HIRES_MULTIPLIER);
+    int64_t coastedHires = reported - turned;
+
+    TEST_ASSERT_INT_WITHIN(HIRES_MULTIPLIER * 2, coastedNotches * HIRES_MULTIPLIER, coastedHires);
+}
+
+void test_zero_decay_turns_it_off()
+{
+    ScrollConfig config = flywheelConfig();
+    config.flywheelDecay = 0;
+    publishConfig(config);
+    RotarySensor rotary(sensor);
+    hold(rotary, 500);
+    flick(rotary, 1440);
+    TEST_ASSERT_EQUAL(0, hold(rotary, 2000));
+    TEST_ASSERT_FALSE(rotary.getFlywheel().isCoasting());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_flick_that_runs_down_coasts);
+    RUN_TEST(test_flick_down_coasts_down);
+    RUN_TEST(test_grabbed_wheel_does_not_coast);
+    RUN_TEST(test_grab_after_slowing_a_little_does_not_coast);
+    RUN_TEST(test_slow_flick_does_not_coast);
+    RUN_TEST(test_motion_stops_coasting);
+    RUN_TEST(test_touch_inside_the_band_stops_coasting);
+    RUN_TEST(test_touch_before_the_release_cancels_it);
+    RUN_TEST(test_count_jitter_keeps_coasting);
+    RUN_TEST(test_hires_coasts_the_same_distance);
+    RUN_TEST(test_zero_decay_turns_it_off);
+    return UNITY_END();
+}
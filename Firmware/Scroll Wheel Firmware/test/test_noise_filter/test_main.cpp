@@ -0,0 +1,202 @@
+#include <math.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include "config.h"
+#include "fakes.h"
+#include "rotary-sensor.h"
+#include "scroll-math.h"
+
+// Adaptive dead band, replayed with clean and noisy resting traces, slow
+// precise turns and a wheel that stops on a count boundary.
+
+static const uint8_t HIRES_MULTIPLIER = 120; // WHEEL_HIRES_MULTIPLIER, BleMouse.h is ESP32 only
+static const int32_t START_ANGLE = ENCODER_COUNTS / 4;
+
+static FakeAngleSensor sensor;
+
+// Runs the given samples with the angle at position plus uniform noise of +-noise counts,
+// returns the sum of the absolute values reported
+static int64_t rest(RotarySensor &rotary, double position, int noise, int samples, int64_t *net = nullptr)
+{
+    int64_t moved = 0;
+    for (int i = 0; i < samples; i++)
+    {
+        int32_t count = (int32_t)floor(position) + (noise > 0 ? rand() % (2 * noise + 1) - noise : 0);
+        sensor.angle = count & (ENCODER_COUNTS - 1);
+        int32_t value = rotary.getScrollValue(HIRES_MULTIPLIER);
+        moved += abs(value);
+        if (net != nullptr)
+        {
+            *net += value;
+        }
+    }
+    return moved;
+}
+
+void setUp()
+{
+    srand(1);
+    publishConfig(defaultConfig());
+    sensor = FakeAngleSensor();
+}
+
+void tearDown()
+{
+}
+
+void test_clean_rest_reports_nothing()
+{
+    RotarySensor rotary(sensor);
+    TEST_ASSERT_EQUAL(0, rest(rotary, START_ANGLE, 0, 5000));
+}
+
+void test_noisy_rest_reports_nothing()
+{
+    RotarySensor rotary(sensor);
+    TEST_ASSERT_EQUAL(0, rest(rotary, START_ANGLE, 1, 10000));
+}
+
+void test_weak_field_widens_the_band()
+{
+    // Two counts of noise on a weak magnet, the AGC margin has to cover it
+    sensor.quality = {true, false, 255, 600};
+    RotarySensor rotary(sensor);
+    TEST_ASSERT_EQUAL(0, rest(rotary, START_ANGLE, 2, 10000));
+    TEST_ASSERT_GREATER_THAN(4 << NoiseFilter::Q, rotary.getNoiseFilter().deadBand());
+}
+
+void test_clean_signal_follows_single_counts()
+{
+    RotarySensor rotary(sensor);
+    rest(rotary, START_ANGLE, 0, 2000); // Learns the clean noise floor
+
+    // One count every 10 samples, 9 degrees per second
+    int firstCount = -1;
+    int reports = 0;
+    for (int count = 1; count <= 40; count++)
+    {
+        for (int i = 0; i < 10; i++)
+        {
+            sensor.angle = START_ANGLE + count;
+            if (rotary.getScrollValue(HIRES_MULTIPLIER) != 0)
+            {
+                firstCount = firstCount < 0 ? count : firstCount;
+                reports++;
+            }
+        }
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(2, firstCount); // The clean band is the minimum band
+    TEST_ASSERT_GREATER_OR_EQUAL(40 - firstCount, reports); // Then every count on its own
+}
+
+// Turns at 30 deg/s for a second with the given noise, returns where it stopped
+static double turn(RotarySensor &rotary, int noise)
+{
+    double position = START_ANGLE;
+    for (int i = 0; i < 1000; i++)
+    {
+        position += degreesToCounts(30) / 1000;
+        int32_t count = (int32_t)position + (noise > 0 ? rand() % (2 * noise + 1) - noise : 0);
+        sensor.angle = count & (ENCODER_COUNTS - 1);
+        rotary.getScrollValue(HIRES_MULTIPLIER);
+    }
+    return floor(position);
+}
+
+void test_stopped_wheel_does_not_creep()
+{
+    RotarySensor rotary(sensor);
+    rest(rotary, START_ANGLE, 0, 2000);
+    double position = turn(rotary, 0);
+
+    // Stopped half way between two counts, the reading flips between both
+    int64_t moved = 0;
+    for (int i = 0; i < 5000; i++)
+    {
+        sensor.angle = ((int32_t)position + rand() % 2) & (ENCODER_COUNTS - 1);
+        moved += abs(rotary.getScrollValue(HIRES_MULTIPLIER));
+    }
+    int32_t perCount = SCROLL_GAIN_Q12 * HIRES_MULTIPLIER / SCROLL_ONE + 1;
+    TEST_ASSERT_LESS_OR_EQUAL(perCount, moved);
+    TEST_ASSERT_FALSE(rotary.getNoiseFilter().isMoving());
+}
+
+void test_noisy_wheel_settles_after_a_turn()
+{
+    // Two counts of jitter all along, the band learned at rest covers it
+    RotarySensor rotary(sensor);
+    rest(rotary, START_ANGLE, 1, 2000);
+    double position = turn(rotary, 1);
+
+    int64_t net = 0;
+    int64_t moved = rest(rotary, position, 1, 5000, &net);
+    TEST_ASSERT_LESS_OR_EQUAL(2 * (SCROLL_GAIN_Q12 * HIRES_MULTIPLIER / SCROLL_ONE + 1), moved);
+    TEST_ASSERT_FALSE(rotary.getNoiseFilter().isMoving());
+}
+
+void test_band_grows_over_jitter_that_started_after_rest()
+{
+    // Clean at rest, then the field gets noisy: the first flips pass the band,
+    // the noise floor learned from them stops them again
+    RotarySensor rotary(sensor);
+    rest(rotary, START_ANGLE, 0, 2000);
+    rest(rotary, START_ANGLE, 1, 1000);
+    TEST_ASSERT_EQUAL(0, rest(rotary, START_ANGLE, 1, 5000));
+}
+
+void test_reversal_needs_the_dead_band()
+{
+    NoiseFilter filter;
+    filter.setBand(32, 32, 1); // Two counts
+    TEST_ASSERT_FALSE(filter.isMotion(2));
+    TEST_ASSERT_TRUE(filter.isMotion(3));
+    TEST_ASSERT_TRUE(filter.isMotion(1));  // Same way, one count is enough
+    TEST_ASSERT_FALSE(filter.isMotion(-1)); // Back needs more than the band
+    TEST_ASSERT_FALSE(filter.isMotion(-2));
+    TEST_ASSERT_TRUE(filter.isMotion(-3));
+}
+
+void test_band_starts_at_the_jitter_threshold_for_any_gain()
+{
+    // The seed follows the runtime gain, not NOISE_BAND_GAIN
+    int32_t start = NoiseFilter().deadBand();
+    for (uint8_t gain = 1; gain <= 12; gain++)
+    {
+        NoiseFilter filter;
+        filter.setBand(0, 1 << 12, gain);
+        TEST_ASSERT_INT_WITHIN(gain, start, filter.deadBand());
+        filter.reset();
+        TEST_ASSERT_INT_WITHIN(gain, start, filter.deadBand());
+    }
+}
+
+void test_gain_change_keeps_a_learned_noise_floor()
+{
+    NoiseFilter filter;
+    int32_t seed = filter.noiseFloor();
+    for (int i = 0; i < 5000; i++)
+    {
+        filter.track(i % 2 ? 1 : -1);
+    }
+    int32_t learned = filter.noiseFloor();
+    TEST_ASSERT_NOT_EQUAL(seed, learned);
+    filter.setBand(0, 1 << 12, 6);
+    TEST_ASSERT_EQUAL(learned, filter.noiseFloor());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_clean_rest_reports_nothing);
+    RUN_TEST(test_noisy_rest_reports_nothing);
+    RUN_TEST(test_weak_field_widens_the_band);
+    RUN_TEST(test_clean_signal_follows_single_counts);
+    RUN_TEST(test_stopped_wheel_does_not_creep);
+    RUN_TEST(test_noisy_wheel_settles_after_a_turn);
+    RUN_TEST(test_band_grows_over_jitter_that_started_after_rest);
+    RUN_TEST(test_reversal_needs_the_dead_band);
+    RUN_TEST(test_band_starts_at_the_jitter_threshold_for_any_gain);
+    RUN_TEST(test_gain_change_keeps_a_learned_noise_floor);
+    return UNITY_END();
+}
@@ -0,0 +1,258 @@
+#include <stdlib.h>
+#include <unity.h>
+
+#include "config.h"
+#include "defaults.h"
+#include "fakes.h"
+#include "power-manager.h"
+#include "rotary-sensor.h"
+#include "scroll-accel.h"
+#include "scroll-math.h"
+
+// Power states and wake-up latency on a simulated ms clock, and the pipeline
+// at the idle sample rate keeping its times and speeds in ms and degrees.
+
+static const uint32_t IDLE_PERIOD = 1000 / POWER_IDLE_RATE_HZ;
+static const int32_t START_ANGLE = ENCODER_COUNTS / 4;
+
+static FakeAngleSensor sensor;
+
+// Samples without motion at the rate the state asks for, from now until end, returns the time it stopped
+static uint32_t rest(PowerManager &power, uint32_t now, uint32_t end)
+{
+    while (now < end)
+    {
+        power.update(now, false);
+        now += power.getState() == PowerManager::IDLE ? IDLE_PERIOD : 1;
+    }
+    return now;
+}
+
+void setUp()
+{
+    srand(1);
+    publishConfig(defaultConfig());
+    sensor = FakeAngleSensor();
+}
+
+void tearDown()
+{
+}
+
+void test_idles_then_powers_off()
+{
+    PowerManager power;
+    power.setIdleTimeout(2000);
+    power.setOffTimeout(10000);
+    power.reset(0);
+    rest(power, 0, 1999);
+    TEST_ASSERT_EQUAL(PowerManager::ACTIVE, power.getState());
+    TEST_ASSERT_TRUE(power.update(2000, false));
+    TEST_ASSERT_EQUAL(PowerManager::IDLE, power.getState());
+    rest(power, 2000, 9990);
+    TEST_ASSERT_EQUAL(PowerManager::IDLE, power.getState());
+    TEST_ASSERT_TRUE(power.update(10000, false));
+    TEST_ASSERT_EQUAL(PowerManager::OFF, power.getState());
+
+    // Nothing wakes it up from off, the power switch is released
+    TEST_ASSERT_FALSE(power.update(10001, true));
+    TEST_ASSERT_EQUAL(PowerManager::OFF, power.getState());
+}
+
+void test_zero_off_timeout_stays_idle()
+{
+    PowerManager power;
+    power.setIdleTimeout(2000);
+    power.setOffTimeout(0);
+    power.reset(0);
+    rest(power, 0, 3600000);
+    TEST_ASSERT_EQUAL(PowerManager::IDLE, power.getState());
+}
+
+void test_motion_keeps_it_active()
+{
+    PowerManager power;
+    power.setIdleTimeout(2000);
+    power.reset(0);
+    for (uint32_t now = 0; now < 10000; now++)
+    {
+        power.update(now, now % 1500 == 0);
+    }
+    TEST_ASSERT_EQUAL(PowerManager::ACTIVE, power.getState());
+    TEST_ASSERT_EQUAL(0, power.getWakeups());
+}
+
+void test_hold_active_skips_the_timeouts()
+{
+    PowerManager power;
+    power.setIdleTimeout(2000);
+    power.setOffTimeout(10000);
+    power.reset(0);
+    uint32_t now = rest(power, 0, 3000);
+    TEST_ASSERT_EQUAL(PowerManager::IDLE, power.getState());
+
+    // Leaving idle by the hold is no wake-up, the timeouts start over after it
+    power.setHoldActive(true);
+    TEST_ASSERT_TRUE(power.update(now, false));
+    TEST_ASSERT_EQUAL(PowerManager::ACTIVE, power.getState());
+    now = rest(power, now, now + 60000);
+    TEST_ASSERT_EQUAL(PowerManager::ACTIVE, power.getState());
+    power.setHoldActive(false);
+    now = rest(power, now, now + 1999);
+    TEST_ASSERT_EQUAL(PowerManager::ACTIVE, power.getState());
+    rest(power, now, now + 2);
+    TEST_ASSERT_EQUAL(PowerManager::IDLE, power.getState());
+    TEST_ASSERT_EQUAL(0, power.getWakeups());
+}
+
+void test_wake_latency_runs_to_the_first_full_rate_report()
+{
+    PowerManager power;
+    power.setIdleTimeout(2000);
+    power.reset(0);
+    uint32_t now = rest(power, 0, 3000);
+    TEST_ASSERT_EQUAL(PowerManager::IDLE, power.getState());
+
+    // The idle poll sees the motion and reports itself, that is still the slow rate
+    TEST_ASSERT_TRUE(power.update(now, true));
+    power.onReport(now);
+    TEST_ASSERT_EQUAL(0, power.getWakeLatency());
+
+    // The noise band holds back the first few samples at the full rate
+    for (int i = 1; i <= 4; i++)
+    {
+        power.update(now + i, true);
+    }
+    power.onReport(now + 4);
+    TEST_ASSERT_EQUAL(4, power.getWakeLatency());
+    TEST_ASSERT_EQUAL(1, power.getWakeups());
+
+    // Only the first report counts
+    power.update(now + 5, true);
+    power.onReport(now + 5);
+    TEST_ASSERT_EQUAL(4, power.getWakeLatency());
+
+    // A wake-up without any report leaves the last latency alone
+    now = rest(power, now + 5, now + 5000);
+    power.update(now, true);
+    now = rest(power, now + 1, now + 5000);
+    TEST_ASSERT_EQUAL(2, power.getWakeups());
+    TEST_ASSERT_EQUAL(4, power.getWakeLatency());
+
+    power.update(now, true);
+    power.update(now + 1, true);
+    power.onReport(now + 1);
+    TEST_ASSERT_EQUAL(1, power.getWakeLatency());
+    TEST_ASSERT_EQUAL(4, power.getMaxWakeLatency());
+}
+
+// Turns at degreesPerSecond for the given ms at the rate, returns the report units
+static int64_t turn(RotarySensor &rotary, double &position, double degreesPerSecond, uint32_t ms, uint32_t rate, const ScrollConfig &config)
+{
+    int64_t total = 0;
+    for (uint32_t i = 0; i < ms * rate / 1000; i++)
+    {
+        position += degreesToCounts(degreesPerSecond) / rate;
+        total += rotary.processAngle((int32_t)position & (ENCODER_COUNTS - 1), 1, config);
+    }
+    return total;
+}
+
+void test_accel_sees_the_same_speed_at_the_idle_rate()
+{
+    // A turn at a third of the top speed, the gain depends on degrees per second, not per sample
+    ScrollConfig config = defaultConfig();
+    config.accelCurve = ACCEL_LINEAR;
+    config.flywheelDecay = 0;
+    const double speed = ACCEL_MAX_SPEED / 3.0;
+
+    RotarySensor fast(sensor);
+    double position = START_ANGLE;
+    turn(fast, position, 0, 100, SAMPLE_RATE_HZ, config);
+    turn(fast, position, speed, 200, SAMPLE_RATE_HZ, config);
+    int64_t atFullRate = turn(fast, position, speed, 2000, SAMPLE_RATE_HZ, config);
+
+    RotarySensor slow(sensor);
+    slow.setSampleRate(POWER_IDLE_RATE_HZ);
+    position = START_ANGLE;
+    turn(slow, position, 0, 100, POWER_IDLE_RATE_HZ, config);
+    turn(slow, position, speed, 200, POWER_IDLE_RATE_HZ, config);
+    int64_t atIdleRate = turn(slow, position, speed, 2000, POWER_IDLE_RATE_HZ, config);
+
+    int64_t plain = (int64_t)degreesToCounts(speed * 2) * SCROLL_GAIN_Q12 / SCROLL_ONE;
+    TEST_ASSERT_TRUE(atFullRate > plain * 3 / 2);
+    TEST_ASSERT_INT_WITHIN(atFullRate / 25, atFullRate, atIdleRate);
+}
+
+void test_quality_reads_keep_their_interval()
+{
+    RotarySensor rotary(sensor);
+    rotary.setSampleRate(POWER_IDLE_RATE_HZ);
+    for (int i = 0; i < POWER_IDLE_RATE_HZ * 10; i++)
+    {
+        rotary.getScrollValue(1);
+    }
+    TEST_ASSERT_INT_WITHIN(1, POWER_IDLE_RATE_HZ * 10 / samplesFor(POWER_IDLE_RATE_HZ, NOISE_QUALITY_INTERVAL), sensor.qualityReads);
+}
+
+void test_noise_floor_is_learned_after_the_rest_time()
+{
+    // Reset to the full rate's start band, then noise at the idle rate for twice the rest time
+    NoiseFilter filter;
+    filter.setSampleRate(POWER_IDLE_RATE_HZ);
+    int32_t start = filter.noiseFloor();
+    int16_t before = 0;
+    for (uint32_t i = 0; i < samplesFor(POWER_IDLE_RATE_HZ, 2 * NOISE_REST_TIME) + 32; i++)
+    {
+        int16_t count = rand() % 3 - 1;
+        filter.track(count - before);
+        before = count;
+    }
+    TEST_ASSERT_TRUE(filter.noiseFloor() != start);
+}
+
+void test_flywheel_releases_after_its_time_at_the_idle_rate()
+{
+    // A flick at the idle rate: every sample is 20 ms, the release takes one quiet sample
+    ScrollConfig config = defaultConfig();
+    config.flywheelDecay = 400;
+    Flywheel flywheel;
+    flywheel.setSampleRate(POWER_IDLE_RATE_HZ);
+    // Running down from eight times the release speed, four times on average
+    int32_t peak = 8 * FLYWHEEL_MIN_SPEED * SCROLL_ONE / POWER_IDLE_RATE_HZ;
+    for (int i = 0; i < Flywheel::FLYWHEEL_WINDOW; i++)
+    {
+        flywheel.update(0, peak * (Flywheel::FLYWHEEL_WINDOW - i) / Flywheel::FLYWHEEL_WINDOW, true, 1, config);
+    }
+    for (uint32_t i = 0; i < samplesFor(POWER_IDLE_RATE_HZ, FLYWHEEL_RELEASE_TIME); i++)
+    {
+        flywheel.update(0, 0, false, 1, config);
+    }
+    TEST_ASSERT_TRUE(flywheel.isCoasting());
+
+    // Down to a sixteenth of the release threshold from four times it is ln(64) time constants,
+    // not twenty times as long
+    uint32_t samples = 0;
+    while (flywheel.isCoasting() && samples < 100000)
+    {
+        flywheel.update(0, 0, false, 1, config);
+        samples++;
+    }
+    uint32_t ms = samples * 1000 / POWER_IDLE_RATE_HZ;
+    TEST_ASSERT_INT_WITHIN(config.flywheelDecay / 2, 4.16 * config.flywheelDecay, ms);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_idles_then_powers_off);
+    RUN_TEST(test_zero_off_timeout_stays_idle);
+    RUN_TEST(test_motion_keeps_it_active);
+    RUN_TEST(test_hold_active_skips_the_timeouts);
+    RUN_TEST(test_wake_latency_runs_to_the_first_full_rate_report);
+    RUN_TEST(test_accel_sees_the_same_speed_at_the_idle_rate);
+    RUN_TEST(test_quality_reads_keep_their_interval);
+    RUN_TEST(test_noise_floor_is_learned_after_the_rest_time);
+    RUN_TEST(test_flywheel_releases_after_its_time_at_the_idle_rate);
+    return UNITY_END();
+}
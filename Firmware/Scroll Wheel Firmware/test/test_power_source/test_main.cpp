@@ -0,0 +1,123 @@
+#include <unity.h>
+
+#include "defaults.h"
+#include "power-source.h"
+
+// USB and charger sense debouncing and the profile they select, on a
+// simulated 1 ms clock: plugging in, a bouncing connector, glitches and the
+// floating charger status on battery.
+
+// Steps the clock 1 ms at a time with fixed levels, returns the profile changes seen
+static int run(PowerSource &source, uint32_t &now, uint32_t ms, bool usb, bool charging)
+{
+    int changes = 0;
+    for (uint32_t i = 0; i < ms; i++)
+    {
+        changes += source.update(++now, usb, charging);
+    }
+    return changes;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_boot_levels_apply_right_away()
+{
+    PowerSource source;
+    source.reset(100, true, true);
+    TEST_ASSERT_EQUAL(POWER_PROFILE_USB, source.getProfile());
+    TEST_ASSERT_TRUE(source.isCharging());
+    TEST_ASSERT_EQUAL(0, source.getSwitches());
+
+    source.reset(200, false, false);
+    TEST_ASSERT_EQUAL(POWER_PROFILE_BATTERY, source.getProfile());
+    TEST_ASSERT_FALSE(source.isCharging());
+}
+
+void test_plug_in_switches_after_the_debounce()
+{
+    PowerSource source;
+    uint32_t now = 1000;
+    source.reset(now, false, false);
+    // The first update sees the new level, it has to hold for the debounce from there
+    TEST_ASSERT_EQUAL(0, run(source, now, POWER_SENSE_DEBOUNCE, true, false));
+    TEST_ASSERT_EQUAL(POWER_PROFILE_BATTERY, source.getProfile());
+    TEST_ASSERT_EQUAL(1, run(source, now, 1, true, false));
+    TEST_ASSERT_EQUAL(POWER_PROFILE_USB, source.getProfile());
+    TEST_ASSERT_EQUAL(0, run(source, now, 1000, true, false));
+
+    TEST_ASSERT_EQUAL(1, run(source, now, POWER_SENSE_DEBOUNCE + 1, false, false));
+    TEST_ASSERT_EQUAL(POWER_PROFILE_BATTERY, source.getProfile());
+    TEST_ASSERT_EQUAL(2, source.getSwitches());
+}
+
+void test_bouncing_connector_switches_once()
+{
+    PowerSource source;
+    uint32_t now = 0;
+    source.reset(now, false, false);
+    int changes = 0;
+    for (int i = 0; i < 20; i++)
+    {
+        changes += run(source, now, 2 + i % 3, i % 2 == 0, false);
+    }
+    changes += run(source, now, 2 * POWER_SENSE_DEBOUNCE, true, false);
+    TEST_ASSERT_EQUAL(1, changes);
+    TEST_ASSERT_EQUAL(POWER_PROFILE_USB, source.getProfile());
+}
+
+void test_glitch_is_ignored()
+{
+    PowerSource source;
+    uint32_t now = 0;
+    source.reset(now, true, false);
+    TEST_ASSERT_EQUAL(0, run(source, now, POWER_SENSE_DEBOUNCE - 1, false, false));
+    TEST_ASSERT_EQUAL(0, run(source, now, 5 * POWER_SENSE_DEBOUNCE, true, false));
+    TEST_ASSERT_EQUAL(POWER_PROFILE_USB, source.getProfile());
+    TEST_ASSERT_EQUAL(0, source.getSwitches());
+}
+
+void test_charger_only_counts_on_usb()
+{
+    // The status pin floats on battery and may read as charging
+    PowerSource source;
+    uint32_t now = 0;
+    source.reset(now, false, true);
+    TEST_ASSERT_FALSE(source.isCharging());
+
+    run(source, now, POWER_SENSE_DEBOUNCE + 1, true, true);
+    TEST_ASSERT_TRUE(source.isCharging());
+
+    // Charge done, the pin releases
+    TEST_ASSERT_EQUAL(0, run(source, now, POWER_SENSE_DEBOUNCE, true, false));
+    TEST_ASSERT_TRUE(source.isCharging());
+    run(source, now, 1, true, false);
+    TEST_ASSERT_FALSE(source.isCharging());
+    TEST_ASSERT_EQUAL(POWER_PROFILE_USB, source.getProfile());
+}
+
+void test_debounce_across_the_millis_wrap()
+{
+    PowerSource source;
+    uint32_t now = UINT32_MAX - POWER_SENSE_DEBOUNCE / 2;
+    source.reset(now, false, false);
+    TEST_ASSERT_EQUAL(0, run(source, now, POWER_SENSE_DEBOUNCE, true, false));
+    TEST_ASSERT_EQUAL(1, run(source, now, 1, true, false));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_boot_levels_apply_right_away);
+    RUN_TEST(test_plug_in_switches_after_the_debounce);
+    RUN_TEST(test_bouncing_connector_switches_once);
+    RUN_TEST(test_glitch_is_ignored);
+    RUN_TEST(test_charger_only_counts_on_usb);
+    RUN_TEST(test_debounce_across_the_millis_wrap);
+    return UNITY_END();
+}
@@ -0,0 +1,162 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include "fakes.h"
+#include "report-coalescer.h"
+
+// Report coalescing against a sink with a few credits per connection event,
+// as a congested BLE link hands them out.
+
+static FakeReportSink sink;
+
+static int64_t sum(const std::vector<int16_t> &reports)
+{
+    int64_t total = 0;
+    for (int16_t report : reports)
+    {
+        total += report;
+    }
+    return total;
+}
+
+void setUp()
+{
+    srand(1);
+    sink = FakeReportSink();
+}
+
+void tearDown()
+{
+}
+
+void test_one_delta_is_one_report()
+{
+    ReportCoalescer coalescer(sink);
+    coalescer.add(5);
+    TEST_ASSERT_TRUE(coalescer.flush());
+    TEST_ASSERT_EQUAL(1, sink.reports.size());
+    TEST_ASSERT_EQUAL(5, sink.reports[0]);
+    TEST_ASSERT_EQUAL(0, coalescer.getCoalesced());
+    TEST_ASSERT_EQUAL(0, coalescer.getSplit());
+}
+
+void test_zero_sends_nothing()
+{
+    ReportCoalescer coalescer(sink);
+    coalescer.add(0);
+    TEST_ASSERT_TRUE(coalescer.flush());
+    TEST_ASSERT_EQUAL(0, sink.reports.size());
+}
+
+void test_burst_while_congested_merges_into_one()
+{
+    ReportCoalescer coalescer(sink);
+    sink.congested = true;
+    for (int i = 0; i < 10; i++)
+    {
+        coalescer.add(3);
+        TEST_ASSERT_FALSE(coalescer.flush());
+    }
+    TEST_ASSERT_EQUAL(0, sink.reports.size());
+    TEST_ASSERT_EQUAL(9, coalescer.getCoalesced());
+
+    sink.congested = false;
+    TEST_ASSERT_TRUE(coalescer.flush());
+    TEST_ASSERT_EQUAL(1, sink.reports.size());
+    TEST_ASSERT_EQUAL(30, sink.reports[0]);
+}
+
+void test_large_values_are_split_into_steps()
+{
+    ReportCoalescer coalescer(sink, 127);
+    sink.credits = 100;
+    coalescer.add(-300);
+    TEST_ASSERT_TRUE(coalescer.flush());
+    TEST_ASSERT_EQUAL(3, sink.reports.size());
+    TEST_ASSERT_EQUAL(-127, sink.reports[0]);
+    TEST_ASSERT_EQUAL(-127, sink.reports[1]);
+    TEST_ASSERT_EQUAL(-46, sink.reports[2]);
+    TEST_ASSERT_EQUAL(2, coalescer.getSplit());
+}
+
+void test_split_waits_for_credits()
+{
+    // Hi-res units with a 16-bit field, more than the connection event takes
+    ReportCoalescer coalescer(sink, INT16_MAX);
+    sink.credits = 2;
+    coalescer.add(4 * INT16_MAX + 1);
+    TEST_ASSERT_FALSE(coalescer.flush());
+    TEST_ASSERT_EQUAL(2, sink.reports.size());
+    TEST_ASSERT_EQUAL(2 * INT16_MAX + 1, coalescer.getPending());
+
+    sink.credits = 4;
+    TEST_ASSERT_TRUE(coalescer.flush());
+    TEST_ASSERT_EQUAL(5, sink.reports.size());
+    TEST_ASSERT_EQUAL(4 * INT16_MAX + 1, sum(sink.reports));
+}
+
+void test_nothing_is_lost_over_a_busy_link()
+{
+    // Random deltas both ways, credits come back at random connection events
+    ReportCoalescer coalescer(sink);
+    sink.credits = 0;
+    int64_t added = 0;
+    for (int i = 0; i < 100000; i++)
+    {
+        int32_t delta = rand() % 401 - 200;
+        coalescer.add(delta);
+        added += delta;
+        if (rand() % 8 == 0)
+        {
+            sink.credits = rand() % 5;
+        }
+        sink.congested = rand() % 16 == 0;
+        coalescer.flush();
+    }
+    sink.congested = false;
+    sink.credits = 1000;
+    TEST_ASSERT_TRUE(coalescer.flush());
+    TEST_ASSERT_EQUAL(added, sum(sink.reports));
+    TEST_ASSERT_EQUAL(coalescer.getReports(), sink.reports.size());
+    for (int16_t report : sink.reports)
+    {
+        TEST_ASSERT_TRUE(report != 0 && report >= -127 && report <= 127);
+    }
+}
+
+void test_pending_saturates_instead_of_wrapping()
+{
+    ReportCoalescer coalescer(sink);
+    sink.congested = true;
+    coalescer.add(INT32_MAX);
+    coalescer.add(INT32_MAX);
+    TEST_ASSERT_EQUAL(INT32_MAX, coalescer.getPending());
+    coalescer.add(INT32_MIN);
+    TEST_ASSERT_EQUAL(-1, coalescer.getPending());
+}
+
+void test_clear_drops_the_pending_value()
+{
+    ReportCoalescer coalescer(sink);
+    sink.congested = true;
+    coalescer.add(42);
+    coalescer.clear();
+    sink.congested = false;
+    TEST_ASSERT_TRUE(coalescer.flush());
+    TEST_ASSERT_EQUAL(0, sink.reports.size());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_one_delta_is_one_report);
+    RUN_TEST(test_zero_sends_nothing);
+    RUN_TEST(test_burst_while_congested_merges_into_one);
+    RUN_TEST(test_large_values_are_split_into_steps);
+    RUN_TEST(test_split_waits_for_credits);
+    RUN_TEST(test_nothing_is_lost_over_a_busy_link);
+    RUN_TEST(test_pending_saturates_instead_of_wrapping);
+    RUN_TEST(test_clear_drops_the_pending_value);
+    return UNITY_END();
+}
@@ -0,0 +1,159 @@
+#include <math.h>
+#include <stdlib.h>
+#include <unity.h>
+#include <vector>
+
+#include "config.h"
+#include "fakes.h"
+#include "rotary-sensor.h"
+#include "scroll-math.h"
+
+// Remainder carry and the host Resolution Multiplier, fed with recorded style
+// angle sequences: a start at rest, steady turns with +-1 count of noise.
+
+static const uint8_t HIRES_MULTIPLIER = 120; // WHEEL_HIRES_MULTIPLIER, BleMouse.h is ESP32 only
+static const int32_t START_ANGLE = ENCODER_COUNTS / 4;
+
+// Angles for a wheel at rest, then turning by countsPerSample for the given samples, then at rest again
+static std::vector<int16_t> makeTurn(double countsPerSample, int samples, bool noise)
+{
+    std::vector<int16_t> trace;
+    double position = START_ANGLE;
+    for (int i = 0; i < 1000 + samples + 1000; i++)
+    {
+        if (i >= 1000 && i < 1000 + samples)
+        {
+            position += countsPerSample;
+        }
+        int32_t count = (int32_t)llround(position) + (noise ? rand() % 3 - 1 : 0);
+        trace.push_back(count & (ENCODER_COUNTS - 1));
+    }
+    return trace;
+}
+
+static int64_t replay(const std::vector<int16_t> &trace, uint8_t multiplier)
+{
+    FakeAngleSensor sensor;
+    sensor.trace = &trace;
+    RotarySensor rotary(sensor);
+    int64_t total = 0;
+    for (size_t i = 0; i < trace.size(); i++)
+    {
+        total += rotary.getScrollValue(multiplier);
+    }
+    return total;
+}
+
+// Report units a turn of the given counts is worth at the default gain
+static int64_t expectedUnits(int64_t counts, uint8_t multiplier)
+{
+    return counts * SCROLL_GAIN_Q12 * multiplier / SCROLL_ONE;
+}
+
+void setUp()
+{
+    srand(1);
+    publishConfig(defaultConfig());
+}
+
+void tearDown()
+{
+}
+
+void test_notches_add_up_over_whole_turns()
+{
+    std::vector<int16_t> trace = makeTurn(4, ENCODER_COUNTS, true); // Four turns
+    TEST_ASSERT_INT_WITHIN(1, expectedUnits(4 * ENCODER_COUNTS, 1), replay(trace, 1));
+}
+
+void test_hires_is_the_multiplier_times_notches()
+{
+    std::vector<int16_t> trace = makeTurn(4, ENCODER_COUNTS, true);
+    TEST_ASSERT_INT_WITHIN(HIRES_MULTIPLIER, expectedUnits(4 * ENCODER_COUNTS, HIRES_MULTIPLIER), replay(trace, HIRES_MULTIPLIER));
+}
+
+void test_slow_turn_loses_no_motion()
+{
+    // A quarter count per sample, every single step is below one notch
+    std::vector<int16_t> trace = makeTurn(0.25, 4 * ENCODER_COUNTS, false);
+    TEST_ASSERT_INT_WITHIN(1, expectedUnits(ENCODER_COUNTS, 1), replay(trace, 1));
+    TEST_ASSERT_INT_WITHIN(HIRES_MULTIPLIER, expectedUnits(ENCODER_COUNTS, HIRES_MULTIPLIER), replay(trace, HIRES_MULTIPLIER));
+}
+
+void test_hires_steps_are_even()
+{
+    // Half a count per sample: every accepted count is worth the same 10 or 11 hi-res units
+    std::vector<int16_t> trace = makeTurn(0.5, 2 * ENCODER_COUNTS, false);
+    FakeAngleSensor sensor;
+    sensor.trace = &trace;
+    RotarySensor rotary(sensor);
+    int32_t smallest = INT32_MAX;
+    int32_t largest = 0;
+    for (size_t i = 0; i < trace.size(); i++)
+    {
+        int32_t value = rotary.getScrollValue(HIRES_MULTIPLIER);
+        if (value != 0 && i > 1100 && i < 1000 + 2 * ENCODER_COUNTS)
+        {
+            smallest = value < smallest ? value : smallest;
+            largest = value > largest ? value : largest;
+        }
+    }
+    int32_t perCount = SCROLL_GAIN_Q12 * HIRES_MULTIPLIER / SCROLL_ONE;
+    TEST_ASSERT_GREATER_OR_EQUAL(perCount, smallest);
+    TEST_ASSERT_LESS_OR_EQUAL(perCount + 1, largest);
+}
+
+void test_there_and_back_is_net_zero()
+{
+    std::vector<int16_t> trace = makeTurn(3, ENCODER_COUNTS / 3, true);
+    std::vector<int16_t> back = makeTurn(-3, ENCODER_COUNTS / 3, true);
+    for (size_t i = 0; i < back.size(); i++)
+    {
+        back[i] = (back[i] + ENCODER_COUNTS - START_ANGLE + trace.back()) & (ENCODER_COUNTS - 1);
+    }
+    trace.insert(trace.end(), back.begin(), back.end());
+    TEST_ASSERT_INT_WITHIN(1, 0, replay(trace, 1));
+    TEST_ASSERT_INT_WITHIN(HIRES_MULTIPLIER, 0, replay(trace, HIRES_MULTIPLIER));
+}
+
+void test_multiplier_switch_drops_the_old_remainder()
+{
+    FakeAngleSensor sensor;
+    sensor.angle = START_ANGLE;
+    RotarySensor rotary(sensor);
+    for (int i = 0; i < 1000; i++)
+    {
+        rotary.getScrollValue(1);
+    }
+
+    // Half a notch worth of counts at multiplier 1 stays behind as remainder
+    int32_t total = 0;
+    for (int i = 1; i <= 20; i++)
+    {
+        sensor.angle = START_ANGLE + i;
+        total += rotary.getScrollValue(1);
+    }
+    TEST_ASSERT_EQUAL(expectedUnits(20, 1), total);
+
+    // After the switch only the new counts count, scaled by the new multiplier.
+    // The carried 0.76 notch would add another unit.
+    total = 0;
+    for (int i = 21; i <= 40; i++)
+    {
+        sensor.angle = START_ANGLE + i;
+        total += rotary.getScrollValue(HIRES_MULTIPLIER);
+    }
+    TEST_ASSERT_EQUAL(expectedUnits(20, HIRES_MULTIPLIER), total);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_notches_add_up_over_whole_turns);
+    RUN_TEST(test_hires_is_the_multiplier_times_notches);
+    RUN_TEST(test_slow_turn_loses_no_motion);
+    RUN_TEST(test_hires_steps_are_even);
+    RUN_TEST(test_there_and_back_is_net_zero);
+    RUN_TEST(test_multiplier_switch_drops_the_old_remainder);
+    return UNITY_END();
+}
@@ -0,0 +1,141 @@
+#include <unity.h>
+
+#include "config.h"
+#include "fakes.h"
+#include "rotary-sensor.h"
+#include "scroll-accel.h"
+#include "scroll-math.h"
+
+// Gain curves, and the Q8 gain applied to the Q12 remainder in both directions
+
+static const uint8_t HIRES_MULTIPLIER = 120; // WHEEL_HIRES_MULTIPLIER, BleMouse.h is ESP32 only
+static const int32_t START_ANGLE = ENCODER_COUNTS / 4;
+
+static FakeAngleSensor sensor;
+static int32_t position; // Where the last turn stopped
+
+// Turns by countsPerSample for the given samples, returns the summed report units
+static int64_t turn(RotarySensor &rotary, int32_t countsPerSample, int samples, uint8_t multiplier, const ScrollConfig &config)
+{
+    int64_t total = 0;
+    for (int i = 0; i < samples; i++)
+    {
+        position += countsPerSample;
+        total += rotary.processAngle(position & (ENCODER_COUNTS - 1), multiplier, config);
+    }
+    return total;
+}
+
+static ScrollConfig accelConfig(uint8_t curve)
+{
+    ScrollConfig config = defaultConfig();
+    config.accelCurve = curve;
+    config.flywheelDecay = 0;
+    return config;
+}
+
+void setUp()
+{
+    position = START_ANGLE;
+    publishConfig(defaultConfig());
+}
+
+void tearDown()
+{
+}
+
+void test_every_curve_starts_at_one_and_never_falls()
+{
+    for (uint8_t curve = 0; curve < ACCEL_CURVE_COUNT; curve++)
+    {
+        TEST_ASSERT_EQUAL(1 << ACCEL_GAIN_BITS, getAccelGain(0, curve));
+        uint16_t before = 0;
+        for (int32_t velocity = 0; velocity < 16 * ENCODER_COUNTS; velocity++)
+        {
+            uint16_t gain = getAccelGain(velocity, curve);
+            TEST_ASSERT_GREATER_OR_EQUAL(before, gain);
+            TEST_ASSERT_EQUAL(gain, getAccelGain(-velocity, curve));
+            before = gain;
+        }
+        if (curve != ACCEL_OFF)
+        {
+            TEST_ASSERT_EQUAL((uint16_t)(ACCEL_MAX_GAIN * (1 << ACCEL_GAIN_BITS) + 0.5), before);
+        }
+    }
+}
+
+void test_off_curve_keeps_the_plain_gain()
+{
+    RotarySensor rotary(sensor);
+    ScrollConfig config = accelConfig(ACCEL_OFF);
+    turn(rotary, 0, 100, 1, config);
+    int64_t total = turn(rotary, 7, 1000, 1, config);
+    TEST_ASSERT_INT_WITHIN(1, (int64_t)7 * 1000 * SCROLL_GAIN_Q12 / SCROLL_ONE, total);
+}
+
+void test_accelerated_turns_are_symmetric()
+{
+    // The same turn in both directions from a fresh remainder, a floored
+    // shift loses a Q12 unit on most negative samples
+    for (uint8_t curve = 0; curve < ACCEL_CURVE_COUNT; curve++)
+    {
+        for (int32_t speed = 3; speed <= 40; speed += 37)
+        {
+            RotarySensor up(sensor), down(sensor);
+            ScrollConfig config = accelConfig(curve);
+            position = START_ANGLE;
+            turn(up, 0, 100, 1, config);
+            int64_t forward = turn(up, speed, 20000, 1, config);
+            position = START_ANGLE;
+            turn(down, 0, 100, 1, config);
+            int64_t backward = turn(down, -speed, 20000, 1, config);
+            TEST_ASSERT_TRUE(forward > 0);
+            TEST_ASSERT_EQUAL(forward, -backward);
+        }
+    }
+}
+
+void test_fast_hires_spin_at_full_gain_fits_the_remainder()
+{
+    // Largest config gain, the top accel gain and the largest multiplier: one
+    // sample is worth more than 2^31 Q12 units before the division
+    ScrollConfig config = accelConfig(ACCEL_LINEAR);
+    config.scrollGain = UINT16_MAX;
+    const int32_t speed = 500;
+    const uint8_t multiplier = UINT8_MAX;
+    int64_t perSample = (int64_t)speed * config.scrollGain * multiplier * getAccelGain(INT32_MAX, ACCEL_LINEAR) / (1 << ACCEL_GAIN_BITS) / SCROLL_ONE;
+    TEST_ASSERT_TRUE(perSample * SCROLL_ONE > INT32_MAX);
+
+    RotarySensor rotary(sensor);
+    turn(rotary, 0, 100, multiplier, config);
+    int32_t value = 0;
+    for (int i = 0; i < 200; i++)
+    {
+        position += speed;
+        value = rotary.processAngle(position & (ENCODER_COUNTS - 1), multiplier, config);
+        TEST_ASSERT_TRUE(value >= 0);
+    }
+    TEST_ASSERT_INT_WITHIN(1, perSample, value);
+}
+
+void test_hires_fast_spin_matches_the_gain()
+{
+    RotarySensor rotary(sensor);
+    ScrollConfig config = accelConfig(ACCEL_SIGMOID);
+    turn(rotary, 0, 100, HIRES_MULTIPLIER, config);
+    turn(rotary, 200, 100, HIRES_MULTIPLIER, config);
+    int64_t total = turn(rotary, 200, 1000, HIRES_MULTIPLIER, config);
+    int64_t expected = (int64_t)200 * 1000 * SCROLL_GAIN_Q12 * HIRES_MULTIPLIER * getAccelGain(INT32_MAX, ACCEL_SIGMOID) / (1 << ACCEL_GAIN_BITS) / SCROLL_ONE;
+    TEST_ASSERT_INT_WITHIN(1, expected, total);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_every_curve_starts_at_one_and_never_falls);
+    RUN_TEST(test_off_curve_keeps_the_plain_gain);
+    RUN_TEST(test_accelerated_turns_are_symmetric);
+    RUN_TEST(test_fast_hires_spin_at_full_gain_fits_the_remainder);
+    RUN_TEST(test_hires_fast_spin_matches_the_gain);
+    return UNITY_END();
+}
@@ -0,0 +1,82 @@
+#include <math.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include "legacy-pipeline.h"
+#include "scroll-math.h"
+
+// The count based thresholds against the float degree code they replaced
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_jitter_and_wrap_decide_like_the_degree_code()
+{
+    // Every difference between two raw angles, from a few starting angles
+    const int16_t starts[] = {0, 1, 2047, 2048, 4000, 4095};
+    for (int16_t before : starts)
+    {
+        for (int16_t raw = 0; raw < ENCODER_COUNTS; raw++)
+        {
+            LegacyFloatPipeline legacy;
+            legacy.scrollValue(before);
+            float degrees = (raw - before) * 360.0f / 4096.0f;
+            bool legacyIgnores = fabs(degrees) < JITTER_THRESHOLD;
+
+            int16_t countDiff = raw - before;
+            bool ignores = countDiff > -JITTER_COUNTS && countDiff < JITTER_COUNTS;
+            TEST_ASSERT_EQUAL(legacyIgnores, ignores);
+            if (ignores)
+            {
+                continue;
+            }
+
+            float wrapped = degrees > MAX_ROTATION_PER_READ ? degrees - 360 : degrees < -MAX_ROTATION_PER_READ ? degrees + 360 : degrees;
+            TEST_ASSERT_EQUAL(lroundf(wrapped * 4096.0f / 360.0f), wrapCounts(countDiff));
+            TEST_ASSERT_EQUAL(lroundf(wrapped), legacy.scrollValue(raw));
+        }
+    }
+}
+
+void test_derived_constants()
+{
+    TEST_ASSERT_EQUAL(ceil(degreesToCounts(JITTER_THRESHOLD)), JITTER_COUNTS);
+    TEST_ASSERT_EQUAL((int32_t)degreesToCounts(MAX_ROTATION_PER_READ), MAX_ROTATION_COUNTS);
+    TEST_ASSERT_EQUAL(lround(SCROLL_MULTIPLICATOR * 360.0 * SCROLL_ONE / ENCODER_COUNTS), SCROLL_GAIN_Q12);
+    TEST_ASSERT_EQUAL(-3, roundCounts(-2.5));
+    TEST_ASSERT_EQUAL(3, roundCounts(2.5));
+}
+
+void test_counts_match_the_degree_total_without_rounding_loss()
+{
+    // Steps of 7 counts, 0.6 degrees each: the float code rounds every step to
+    // one unit and scrolls 1.6 times too far, the counts keep the fraction
+    LegacyFloatPipeline legacy;
+    CountPipeline counts;
+    int64_t legacyTotal = 0;
+    int64_t total = 0;
+    int16_t angle = 100;
+    for (int i = 0; i <= 4096; i++)
+    {
+        angle = (angle + 7) & (ENCODER_COUNTS - 1);
+        legacyTotal += legacy.scrollValue(angle);
+        total += counts.scrollValue(angle, 1);
+    }
+    int64_t exact = 4096 * 7 * 360 / 4096;
+    TEST_ASSERT_INT_WITHIN(1, exact, total);
+    TEST_ASSERT_GREATER_THAN(exact, legacyTotal);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_jitter_and_wrap_decide_like_the_degree_code);
+    RUN_TEST(test_derived_constants);
+    RUN_TEST(test_counts_match_the_degree_total_without_rounding_loss);
+    return UNITY_END();
+}
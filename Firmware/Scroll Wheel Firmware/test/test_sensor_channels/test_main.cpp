@@ -0,0 +1,199 @@
+#include <stdlib.h>
+#include <unity.h>
+#include <vector>
+
+#include "calibration.h"
+#include "config.h"
+#include "defaults.h"
+#include "fakes.h"
+#include "sensor-channels.h"
+#include "wheel-mode.h"
+
+// Several encoders in one sampler tick: wheel and pan routing, the linearity
+// table on the primary wheel only, and read timing on a simulated bus where
+// every read takes time off the clock.
+
+static const uint32_t READ_COST_US = 110;
+static const uint32_t SAMPLE_PERIOD_US = 1000000 / SAMPLE_RATE_HZ;
+
+static FakeClock busClock;
+static FakeAngleSensor sensors[MAX_SENSOR_CHANNELS];
+static std::vector<RotarySensor> rotaries;
+
+// Channel 0 is a wheel, then pan and wheel take turns
+static void build(SensorChannels &channels, uint8_t count)
+{
+    rotaries.clear();
+    rotaries.reserve(count);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        sensors[i] = FakeAngleSensor();
+        sensors[i].clock = &busClock;
+        sensors[i].readCostUs = READ_COST_US;
+        sensors[i].angle = ENCODER_COUNTS / 4;
+        rotaries.emplace_back(sensors[i]);
+        TEST_ASSERT_TRUE(channels.add(rotaries[i], i % 2 == 0 ? CHANNEL_WHEEL : CHANNEL_PAN));
+    }
+}
+
+// One tick at the start of its sample period
+static void tick(SensorChannels &channels, uint32_t index, int32_t &wheel, int32_t &pan)
+{
+    busClock.us = (uint64_t)index * SAMPLE_PERIOD_US;
+    channels.sample(1, wheel, pan);
+}
+
+void setUp()
+{
+    srand(1);
+    busClock = FakeClock();
+    publishConfig(defaultConfig());
+    publishCalibration(identityCalibration());
+}
+
+void tearDown()
+{
+    publishCalibration(identityCalibration());
+}
+
+void test_add_rules()
+{
+    SensorChannels channels(busClock);
+    FakeAngleSensor sensor;
+    RotarySensor extra(sensor);
+    TEST_ASSERT_FALSE(channels.add(extra, CHANNEL_PAN)); // The first one has to be a wheel
+    build(channels, MAX_SENSOR_CHANNELS);
+    TEST_ASSERT_FALSE(channels.add(extra, CHANNEL_WHEEL));
+    TEST_ASSERT_EQUAL(MAX_SENSOR_CHANNELS, channels.getCount());
+}
+
+void test_pan_and_wheel_are_routed_apart()
+{
+    SensorChannels channels(busClock);
+    build(channels, 2);
+    int64_t wheelTotal = 0;
+    int64_t panTotal = 0;
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        sensors[1].angle = (ENCODER_COUNTS / 4 + i) & (ENCODER_COUNTS - 1);
+        int32_t wheel, pan;
+        tick(channels, i, wheel, pan);
+        wheelTotal += wheel;
+        panTotal += pan;
+    }
+    TEST_ASSERT_EQUAL(0, wheelTotal);
+    TEST_ASSERT_TRUE(panTotal > 0);
+    TEST_ASSERT_TRUE(channels.isMoving());
+}
+
+void test_extra_wheel_only_adds_while_scrolling()
+{
+    ScrollConfig config = defaultConfig();
+    config.wheelMode = WHEEL_MODE_JOG;
+    publishConfig(config);
+    SensorChannels channels(busClock);
+    build(channels, 3);
+    int64_t wheelTotal = 0;
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        sensors[2].angle = (ENCODER_COUNTS / 4 + i) & (ENCODER_COUNTS - 1);
+        int32_t wheel, pan;
+        tick(channels, i, wheel, pan);
+        wheelTotal += wheel;
+    }
+    TEST_ASSERT_EQUAL(0, wheelTotal);
+    TEST_ASSERT_EQUAL(WHEEL_MODE_JOG, rotaries[0].getMode());
+    TEST_ASSERT_EQUAL(WHEEL_MODE_SCROLL, rotaries[2].getMode());
+}
+
+void test_only_the_primary_wheel_is_calibrated()
+{
+    CalibrationTable table = identityCalibration();
+    for (int i = 0; i < CALIBRATION_POINTS; i++)
+    {
+        table.offset[i] = 50 << CALIBRATION_Q;
+    }
+    TEST_ASSERT_TRUE(publishCalibration(table));
+
+    SensorChannels channels(busClock);
+    build(channels, 3);
+    int32_t wheel, pan;
+    tick(channels, 0, wheel, pan);
+    TEST_ASSERT_EQUAL(ENCODER_COUNTS / 4 + 50, rotaries[0].getLastAngle());
+    TEST_ASSERT_EQUAL(ENCODER_COUNTS / 4, rotaries[1].getLastAngle());
+    TEST_ASSERT_EQUAL(ENCODER_COUNTS / 4, rotaries[2].getLastAngle());
+}
+
+void test_read_offsets_do_not_move()
+{
+    SensorChannels channels(busClock);
+    build(channels, MAX_SENSOR_CHANNELS);
+    for (uint32_t i = 0; i < 10 * SAMPLE_RATE_HZ * NOISE_QUALITY_INTERVAL / 1000; i++)
+    {
+        int32_t wheel, pan;
+        tick(channels, i, wheel, pan);
+    }
+    for (uint8_t c = 0; c < MAX_SENSOR_CHANNELS; c++)
+    {
+        TEST_ASSERT_EQUAL(0, channels.getOffsetJitter(c));
+    }
+    // Every angle and one AGC/magnitude read at most
+    TEST_ASSERT_EQUAL((MAX_SENSOR_CHANNELS + 1) * READ_COST_US, channels.getMaxTickTime());
+    TEST_ASSERT_TRUE(channels.getMaxTickTime() <= SAMPLE_PERIOD_US);
+}
+
+void test_quality_reads_are_staggered()
+{
+    SensorChannels channels(busClock);
+    build(channels, MAX_SENSOR_CHANNELS);
+    const uint32_t interval = samplesFor(SAMPLE_RATE_HZ, NOISE_QUALITY_INTERVAL);
+    const uint32_t ticks = 20 * interval;
+    uint32_t before = 0;
+    for (uint32_t i = 0; i < ticks; i++)
+    {
+        int32_t wheel, pan;
+        tick(channels, i, wheel, pan);
+        uint32_t reads = 0;
+        for (uint8_t c = 0; c < MAX_SENSOR_CHANNELS; c++)
+        {
+            reads += sensors[c].qualityReads;
+        }
+        TEST_ASSERT_TRUE(reads - before <= 1);
+        before = reads;
+    }
+    // Still once per interval for every channel
+    for (uint8_t c = 0; c < MAX_SENSOR_CHANNELS; c++)
+    {
+        TEST_ASSERT_INT_WITHIN(1, ticks / interval, sensors[c].qualityReads);
+    }
+}
+
+void test_single_sensor_reads_quality_first()
+{
+    // Without channels, getScrollValue() keeps reading AGC/magnitude before the angle
+    FakeAngleSensor sensor;
+    RotarySensor rotary(sensor);
+    const uint32_t interval = samplesFor(SAMPLE_RATE_HZ, NOISE_QUALITY_INTERVAL);
+    rotary.getScrollValue(1);
+    TEST_ASSERT_EQUAL(1, sensor.qualityReads);
+    for (uint32_t i = 1; i < interval; i++)
+    {
+        rotary.getScrollValue(1);
+    }
+    TEST_ASSERT_EQUAL(1, sensor.qualityReads);
+    rotary.getScrollValue(1);
+    TEST_ASSERT_EQUAL(2, sensor.qualityReads);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_add_rules);
+    RUN_TEST(test_pan_and_wheel_are_routed_apart);
+    RUN_TEST(test_extra_wheel_only_adds_while_scrolling);
+    RUN_TEST(test_only_the_primary_wheel_is_calibrated);
+    RUN_TEST(test_read_offsets_do_not_move);
+    RUN_TEST(test_quality_reads_are_staggered);
+    RUN_TEST(test_single_sensor_reads_quality_first);
+    return UNITY_END();
+}
@@ -0,0 +1,115 @@
+#include <stdint.h>
+#include <thread>
+#include <unity.h>
+
+#include "spsc-queue.h"
+
+// Sampler to reporter queue: ordering, the full and empty edges, wrap-around
+// and a producer and consumer on two threads.
+
+struct Sample
+{
+    uint32_t timestamp;
+    int32_t delta;
+};
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_empty_queue_pops_nothing()
+{
+    SpscQueue<Sample, 8> queue;
+    Sample sample;
+    TEST_ASSERT_TRUE(queue.empty());
+    TEST_ASSERT_FALSE(queue.pop(sample));
+}
+
+void test_full_queue_keeps_one_slot_free()
+{
+    SpscQueue<Sample, 8> queue;
+    TEST_ASSERT_EQUAL(7, queue.capacity());
+    for (uint32_t i = 0; i < 7; i++)
+    {
+        TEST_ASSERT_TRUE(queue.push({i, 0}));
+    }
+    TEST_ASSERT_FALSE(queue.push({7, 0}));
+
+    // One pop makes room for exactly one more
+    Sample sample;
+    TEST_ASSERT_TRUE(queue.pop(sample));
+    TEST_ASSERT_TRUE(queue.push({7, 0}));
+    TEST_ASSERT_FALSE(queue.push({8, 0}));
+}
+
+void test_order_survives_wrap_around()
+{
+    SpscQueue<Sample, 4> queue;
+    uint32_t next = 0;
+    uint32_t expected = 0;
+    for (int round = 0; round < 100; round++)
+    {
+        // Alternate between filling up and draining partly so the indices wrap at every offset
+        while (queue.push({next, (int32_t)next * 3}))
+        {
+            next++;
+        }
+        Sample sample;
+        for (int i = 0; i < 1 + round % 3 && queue.pop(sample); i++)
+        {
+            TEST_ASSERT_EQUAL_UINT32(expected, sample.timestamp);
+            TEST_ASSERT_EQUAL_INT32((int32_t)expected * 3, sample.delta);
+            expected++;
+        }
+    }
+}
+
+void test_two_threads_lose_and_reorder_nothing()
+{
+    static SpscQueue<Sample, 64> queue;
+    const uint32_t count = 200000;
+
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            while (!queue.push({i, (int32_t)(i ^ 0x5A5A)}))
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint32_t expected = 0;
+    bool inOrder = true;
+    Sample sample;
+    while (expected < count)
+    {
+        if (queue.pop(sample))
+        {
+            inOrder &= sample.timestamp == expected && sample.delta == (int32_t)(expected ^ 0x5A5A);
+            expected++;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    TEST_ASSERT_TRUE(inOrder);
+    TEST_ASSERT_TRUE(queue.empty());
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_queue_pops_nothing);
+    RUN_TEST(test_full_queue_keeps_one_slot_free);
+    RUN_TEST(test_order_survives_wrap_around);
+    RUN_TEST(test_two_threads_lose_and_reorder_nothing);
+    return UNITY_END();
+}
@@ -0,0 +1,187 @@
+#include <stdlib.h>
+#include <unity.h>
+
+#include "config.h"
+#include "defaults.h"
+#include "scroll-math.h"
+#include "wheel-mode.h"
+
+// Jog and key steps on the per-turn grid, reversals, jitter at a step
+// boundary and the shuttle levels.
+
+static ScrollConfig modeConfig(uint8_t mode, uint16_t steps = 24)
+{
+    ScrollConfig config = defaultConfig();
+    config.wheelMode = mode;
+    config.modeSteps = steps;
+    return config;
+}
+
+// Feeds counts one at a time, returns the steps and where the last one fired
+static int32_t turn(WheelModeEngine &modes, int32_t counts, const ScrollConfig &config, int32_t *lastStep = nullptr)
+{
+    int32_t steps = 0;
+    for (int32_t i = 1; i <= abs(counts); i++)
+    {
+        int32_t step = modes.update(counts > 0 ? 1 : -1, config);
+        steps += step;
+        if (step != 0 && lastStep != nullptr)
+        {
+            *lastStep = i;
+        }
+    }
+    return steps;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_scroll_mode_sends_nothing()
+{
+    WheelModeEngine modes;
+    ScrollConfig config = modeConfig(WHEEL_MODE_SCROLL);
+    TEST_ASSERT_EQUAL(0, turn(modes, ENCODER_COUNTS, config));
+    TEST_ASSERT_FALSE(modes.isActive());
+}
+
+void test_24_steps_per_turn()
+{
+    WheelModeEngine modes;
+    ScrollConfig config = modeConfig(WHEEL_MODE_JOG, 24);
+    turn(modes, 0, config);
+    for (int i = 1; i <= 10; i++)
+    {
+        TEST_ASSERT_EQUAL(24, turn(modes, ENCODER_COUNTS, config));
+    }
+    TEST_ASSERT_EQUAL(-240, turn(modes, -10 * ENCODER_COUNTS, config));
+}
+
+void test_other_step_counts_stay_on_the_grid()
+{
+    const uint16_t counts[] = {1, 7, 24, 100, 360, ENCODER_COUNTS};
+    for (uint16_t steps : counts)
+    {
+        WheelModeEngine modes;
+        ScrollConfig config = modeConfig(WHEEL_MODE_KEYS, steps);
+        TEST_ASSERT_EQUAL(3 * steps, turn(modes, 3 * ENCODER_COUNTS, config));
+    }
+}
+
+void test_first_step_and_reversal()
+{
+    // 4096 / 24 = 170.7 counts per step
+    WheelModeEngine modes;
+    ScrollConfig config = modeConfig(WHEEL_MODE_JOG, 24);
+    int32_t at = 0;
+    TEST_ASSERT_EQUAL(1, turn(modes, 128, config, &at));
+    TEST_ASSERT_EQUAL(128, at); // Three quarters of a step
+    TEST_ASSERT_EQUAL(2, turn(modes, 342, config, &at));
+    TEST_ASSERT_EQUAL(342, at); // Two steps on, the grid does not round each one to 171
+
+    // Turning back takes half a step, then full steps again
+    TEST_ASSERT_EQUAL(-1, turn(modes, -86, config, &at));
+    TEST_ASSERT_EQUAL(86, at);
+    TEST_ASSERT_EQUAL(-1, turn(modes, -171, config, &at));
+    TEST_ASSERT_EQUAL(171, at);
+
+    // And forward again the same way
+    TEST_ASSERT_EQUAL(1, turn(modes, 86, config, &at));
+    TEST_ASSERT_EQUAL(86, at);
+}
+
+void test_jitter_at_a_step_never_sends_pairs()
+{
+    WheelModeEngine modes;
+    ScrollConfig config = modeConfig(WHEEL_MODE_KEYS, 24);
+    TEST_ASSERT_EQUAL(1, turn(modes, 128, config));
+    int32_t total = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        int32_t step = modes.update(i % 2 == 0 ? -40 : 40, config);
+        TEST_ASSERT_EQUAL(0, step);
+        total += step;
+    }
+    TEST_ASSERT_EQUAL(0, total);
+}
+
+void test_fast_turn_sends_several_steps_at_once()
+{
+    WheelModeEngine modes;
+    ScrollConfig config = modeConfig(WHEEL_MODE_JOG, 24);
+    TEST_ASSERT_EQUAL(6, modes.update(ENCODER_COUNTS / 4, config)); // 6 steps and a quarter
+    TEST_ASSERT_EQUAL(-6, modes.update(-ENCODER_COUNTS / 4, config));
+    TEST_ASSERT_EQUAL(0, modes.update(0, config));
+}
+
+void test_step_change_starts_over()
+{
+    WheelModeEngine modes;
+    ScrollConfig config = modeConfig(WHEEL_MODE_JOG, 24);
+    turn(modes, 100, config);
+    config.modeSteps = 12;
+    TEST_ASSERT_EQUAL(0, turn(modes, 255, config)); // 3/4 of the new step is 256
+    TEST_ASSERT_EQUAL(1, turn(modes, 1, config));
+}
+
+void test_shuttle_levels_and_limit()
+{
+    WheelModeEngine modes;
+    modes.setSampleRate(SAMPLE_RATE_HZ);
+    ScrollConfig config = modeConfig(WHEEL_MODE_SHUTTLE, 24);
+    turn(modes, 0, config);
+    TEST_ASSERT_FALSE(modes.isActive());
+
+    turn(modes, 2 * 171, config);
+    TEST_ASSERT_EQUAL(2, modes.getShuttleLevel());
+    TEST_ASSERT_TRUE(modes.isActive());
+
+    // Far past the last level, turning back leaves it after half a step
+    turn(modes, ENCODER_COUNTS, config);
+    TEST_ASSERT_EQUAL(SHUTTLE_LEVELS, modes.getShuttleLevel());
+    turn(modes, -85, config);
+    TEST_ASSERT_EQUAL(SHUTTLE_LEVELS, modes.getShuttleLevel());
+    turn(modes, -1, config);
+    TEST_ASSERT_EQUAL(SHUTTLE_LEVELS - 1, modes.getShuttleLevel());
+
+    turn(modes, -2 * ENCODER_COUNTS, config);
+    TEST_ASSERT_EQUAL(-SHUTTLE_LEVELS, modes.getShuttleLevel());
+}
+
+void test_shuttle_reports_its_level_every_interval()
+{
+    WheelModeEngine modes;
+    modes.setSampleRate(SAMPLE_RATE_HZ);
+    ScrollConfig config = modeConfig(WHEEL_MODE_SHUTTLE, 24);
+    modes.update(-3 * 171, config);
+    int32_t reports = 0;
+    int32_t pan = 0;
+    uint32_t samples = samplesFor(SAMPLE_RATE_HZ, SHUTTLE_INTERVAL) * 10;
+    for (uint32_t i = 1; i < samples; i++)
+    {
+        int32_t value = modes.update(0, config);
+        reports += value != 0;
+        pan += value;
+    }
+    TEST_ASSERT_EQUAL(10, reports);
+    TEST_ASSERT_EQUAL(-30, pan);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_scroll_mode_sends_nothing);
+    RUN_TEST(test_24_steps_per_turn);
+    RUN_TEST(test_other_step_counts_stay_on_the_grid);
+    RUN_TEST(test_first_step_and_reversal);
+    RUN_TEST(test_jitter_at_a_step_never_sends_pairs);
+    RUN_TEST(test_fast_turn_sends_several_steps_at_once);
+    RUN_TEST(test_step_change_starts_over);
+    RUN_TEST(test_shuttle_levels_and_limit);
+    RUN_TEST(test_shuttle_reports_its_level_every_interval);
+    return UNITY_END();
+}